@@ -0,0 +1,481 @@
+/* times the layout math for 1 to 1000 toplevels over a range of gaps, borders
+ * and ratios, and checks that the resulting layouts are sane while at it, along
+ * with the order the tiled toplevels are kept in.
+ * run it with `meson test --benchmark -C build`; with --check it only checks,
+ * which is what `meson test -C build` does */
+
+#include "layout_math.h"
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <wayland-util.h>
+
+#define MAX_TOPLEVELS 1000
+#define ITERATIONS 200
+
+struct mwc_box boxes[MAX_TOPLEVELS];
+/* indices of boxes, sorted along the axis they are laid out on */
+uint32_t order[MAX_TOPLEVELS];
+uint32_t violations = 0;
+/* layouts where the toplevels do not fit with their gaps and borders */
+uint32_t degenerate = 0;
+
+uint32_t toplevel_counts[] = { 1, 2, 3, 5, 10, 50, 100, 500, 1000 };
+uint32_t outer_gaps[] = { 0, 4, 12, 30 };
+uint32_t inner_gaps[] = { 0, 2, 8, 20 };
+uint32_t border_widths[] = { 0, 1, 3 };
+uint32_t master_counts[] = { 1, 2, 3 };
+double ratios[] = { 0.2, 0.5, 0.65, 0.8 };
+struct mwc_box areas[] = {
+  { .x = 0, .y = 0, .width = 1920, .height = 1080 },
+  { .x = 1920, .y = 32, .width = 3840, .height = 2128 },
+};
+
+#define LENGTH(a) (sizeof(a) / sizeof((a)[0]))
+
+uint64_t
+now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void
+report(char *layout, struct mwc_layout_params *params, uint32_t count, char *what) {
+  if(violations < 20) {
+    fprintf(stderr, "%s layout, %u toplevels, outer %u, inner %u, border %u, ratio %.2f: %s\n",
+            layout, count, params->outer_gaps, params->inner_gaps, params->border_width,
+            params->master_ratio, what);
+  }
+  violations++;
+}
+
+/* the box with its border and half of the space between toplevels */
+struct mwc_box
+grow(struct mwc_box *box, uint32_t by) {
+  return (struct mwc_box){
+    .x = box->x - by,
+    .y = box->y - by,
+    .width = box->width + 2 * by,
+    .height = box->height + 2 * by,
+  };
+}
+
+bool
+overlap(struct mwc_box *a, struct mwc_box *b) {
+  return a->x < b->x + b->width && b->x < a->x + a->width
+    && a->y < b->y + b->height && b->y < a->y + a->height;
+}
+
+uint32_t
+master_arrange(struct mwc_layout_params *params, struct mwc_box *area,
+               uint32_t count, uint32_t master_count) {
+  uint32_t masters = count < master_count ? count : master_count;
+  uint32_t slaves = count - masters;
+
+  for(uint32_t i = 0; i < masters; i++) {
+    boxes[i] = layout_math_master_box(params, area, masters, slaves, i);
+  }
+  for(uint32_t i = 0; i < slaves; i++) {
+    boxes[masters + i] = layout_math_slave_box(params, area, slaves, i);
+  }
+
+  return masters;
+}
+
+void
+scrolling_arrange(struct mwc_layout_params *params, struct mwc_box *area,
+                  uint32_t count, int32_t scroll_offset) {
+  scroll_offset = layout_math_clamp_scroll_offset(params, area, count, scroll_offset);
+
+  for(uint32_t i = 0; i < count; i++) {
+    boxes[i] = layout_math_column_box(params, area, scroll_offset, i);
+  }
+}
+
+/* whether count toplevels along length keep their gaps and borders, see layout_math_split() */
+bool
+decorations_fit(struct mwc_layout_params *params, int64_t length, uint32_t count) {
+  return count == 0 || length - (count - 1) * 2 * (int64_t)params->inner_gaps
+    - count * 2 * (int64_t)params->border_width >= count;
+}
+
+bool
+layout_decorated(struct mwc_layout_params *params, struct mwc_box *area,
+                 uint32_t count, uint32_t masters, bool scrolling) {
+  int64_t outer_gaps = params->outer_gaps;
+  int64_t inner_gaps = params->inner_gaps;
+  int64_t height = area->height - 2 * outer_gaps;
+
+  if(scrolling) {
+    int64_t slot_width = layout_math_column_slot_width(params, area);
+    return decorations_fit(params, slot_width - 2 * inner_gaps, 1)
+      && decorations_fit(params, height, 1);
+  }
+
+  uint32_t slaves = count - masters;
+  int64_t masters_width = (int64_t)(area->width * params->master_ratio);
+  if(slaves == 0) {
+    return decorations_fit(params, area->width - 2 * outer_gaps, masters)
+      && decorations_fit(params, height, 1);
+  }
+  return decorations_fit(params, masters_width - outer_gaps - inner_gaps, masters)
+    && decorations_fit(params, height, 1)
+    && decorations_fit(params, area->width - masters_width - outer_gaps - inner_gaps, 1)
+    && decorations_fit(params, height, slaves);
+}
+
+bool sort_by_x;
+
+int
+compare_boxes(const void *a, const void *b) {
+  struct mwc_box *x = &boxes[*(const uint32_t *)a];
+  struct mwc_box *y = &boxes[*(const uint32_t *)b];
+  int32_t p = sort_by_x ? x->x : x->y;
+  int32_t q = sort_by_x ? y->x : y->y;
+  return (p > q) - (p < q);
+}
+
+/* masters is the number of masters for the master layout, ignored for scrolling */
+void
+check(char *layout, struct mwc_layout_params *params, struct mwc_box *area,
+      uint32_t count, uint32_t masters, bool scrolling) {
+  /* when the gaps and borders do not fit they are left out, and only what the
+   * toplevels show has to stay inside the area without overlapping */
+  bool decorated = layout_decorated(params, area, count, masters, scrolling);
+  if(!decorated) {
+    degenerate++;
+  }
+  uint32_t border_width = decorated ? params->border_width : 0;
+  uint32_t inner_gaps = decorated ? params->inner_gaps : 0;
+
+  bool check_x = !scrolling;
+
+  for(uint32_t i = 0; i < count; i++) {
+    struct mwc_box bordered = grow(&boxes[i], border_width);
+
+    if(boxes[i].width < 1 || boxes[i].height < 1) {
+      report(layout, params, count, "toplevel with no size");
+    }
+
+    if(bordered.y < area->y + (int32_t)params->outer_gaps
+       || bordered.y + bordered.height > area->y + area->height - (int32_t)params->outer_gaps) {
+      report(layout, params, count, "toplevel outside of the usable area vertically");
+    }
+
+    if(check_x && (bordered.x < area->x + (int32_t)params->outer_gaps
+       || bordered.x + bordered.width > area->x + area->width - (int32_t)params->outer_gaps)) {
+      report(layout, params, count, "toplevel outside of the usable area horizontally");
+    }
+  }
+
+  /* toplevels are 2 * inner_gaps apart, so grown by inner_gaps they must not overlap.
+   * sorted along the axis they are laid out on, only the ones that start before
+   * another ends on that axis have to be compared with it */
+  sort_by_x = scrolling;
+  for(uint32_t i = 0; i < count; i++) {
+    order[i] = i;
+  }
+  qsort(order, count, sizeof(*order), compare_boxes);
+
+  for(uint32_t i = 0; i < count; i++) {
+    struct mwc_box a = grow(&boxes[order[i]], border_width + inner_gaps);
+    for(uint32_t j = i + 1; j < count; j++) {
+      struct mwc_box b = grow(&boxes[order[j]], border_width + inner_gaps);
+      if(sort_by_x ? b.x >= a.x + a.width : b.y >= a.y + a.height) break;
+
+      if(overlap(&a, &b)) {
+        report(layout, params, count, "toplevels overlap or inner gaps are not respected");
+      }
+    }
+  }
+}
+
+#define LIST_TOPLEVELS 6
+
+/* toplevels of the list checks, with their link as in struct mwc_toplevel */
+struct list_toplevel {
+  uint32_t id;
+  struct wl_list link;
+};
+
+struct list_toplevel list_toplevels[LIST_TOPLEVELS + 1];
+struct wl_list masters, slaves;
+
+/* what the lists should look like, as ids */
+struct expected_list {
+  uint32_t ids[LIST_TOPLEVELS + 1];
+  uint32_t length;
+};
+
+void
+list_report(char *what, char *detail) {
+  if(violations < 20) {
+    fprintf(stderr, "%s: %s\n", what, detail);
+  }
+  violations++;
+}
+
+void
+lists_fill(uint32_t master_count, uint32_t slave_count) {
+  wl_list_init(&masters);
+  wl_list_init(&slaves);
+  for(uint32_t i = 0; i < master_count + slave_count; i++) {
+    list_toplevels[i].id = i;
+    wl_list_insert(i < master_count ? masters.prev : slaves.prev, &list_toplevels[i].link);
+  }
+}
+
+void
+expected_fill(struct expected_list *m, struct expected_list *s,
+              uint32_t master_count, uint32_t slave_count) {
+  m->length = 0;
+  s->length = 0;
+  for(uint32_t i = 0; i < master_count + slave_count; i++) {
+    if(i < master_count) {
+      m->ids[m->length++] = i;
+    } else {
+      s->ids[s->length++] = i;
+    }
+  }
+}
+
+void
+expected_insert(struct expected_list *list, uint32_t at, uint32_t id) {
+  memmove(&list->ids[at + 1], &list->ids[at], (list->length - at) * sizeof(*list->ids));
+  list->ids[at] = id;
+  list->length++;
+}
+
+uint32_t
+expected_remove(struct expected_list *list, uint32_t at) {
+  uint32_t id = list->ids[at];
+  list->length--;
+  memmove(&list->ids[at], &list->ids[at + 1], (list->length - at) * sizeof(*list->ids));
+  return id;
+}
+
+/* compares the list with what it should be, walking it both ways */
+bool
+list_matches(struct wl_list *list, struct expected_list *expected) {
+  uint32_t i = 0;
+  for(struct wl_list *l = list->next; l != list; l = l->next, i++) {
+    if(l->next->prev != l || i >= expected->length) return false;
+
+    struct list_toplevel *t = wl_container_of(l, t, link);
+    if(t->id != expected->ids[i]) return false;
+  }
+  if(i != expected->length) return false;
+
+  for(struct wl_list *l = list->prev; l != list; l = l->prev) {
+    if(l->prev->next != l) return false;
+    i--;
+  }
+  return i == 0;
+}
+
+void
+check_lists_match(char *what, char *detail, struct expected_list *m, struct expected_list *s) {
+  if(!list_matches(&masters, m) || !list_matches(&slaves, s)) {
+    list_report(what, detail);
+  }
+}
+
+/* every pair, in the same list or not, next to each other or not, in both orders */
+void
+check_swap(void) {
+  for(uint32_t master_count = 1; master_count < LIST_TOPLEVELS; master_count++)
+  for(uint32_t a = 0; a < LIST_TOPLEVELS; a++)
+  for(uint32_t b = 0; b < LIST_TOPLEVELS; b++) {
+    lists_fill(master_count, LIST_TOPLEVELS - master_count);
+    layout_math_swap(&list_toplevels[a].link, &list_toplevels[b].link);
+
+    struct expected_list m, s;
+    expected_fill(&m, &s, master_count, LIST_TOPLEVELS - master_count);
+    uint32_t *ia = a < master_count ? &m.ids[a] : &s.ids[a - master_count];
+    uint32_t *ib = b < master_count ? &m.ids[b] : &s.ids[b - master_count];
+    uint32_t t = *ia;
+    *ia = *ib;
+    *ib = t;
+
+    char detail[64];
+    snprintf(detail, sizeof(detail), "%u masters, %u and %u", master_count, a, b);
+    check_lists_match("swap", detail, &m, &s);
+  }
+}
+
+/* dropped on every toplevel, on both of its sides, and on none */
+void
+check_insert(void) {
+  /* they are stacked like the master layout would, the exact boxes do not matter */
+  struct mwc_box box = { .x = 100, .y = 100, .width = 100, .height = 100 };
+  uint32_t dropped = LIST_TOPLEVELS;
+
+  for(uint32_t master_count = 1; master_count <= LIST_TOPLEVELS; master_count++)
+  for(uint32_t masters_before = 0; masters_before <= master_count
+      && masters_before <= LIST_TOPLEVELS; masters_before++)
+  for(int32_t target = -1; target < LIST_TOPLEVELS; target++)
+  for(uint32_t side = 0; side < 2; side++) {
+    /* the masters are full unless there are no slaves */
+    uint32_t slave_count = masters_before < master_count ? 0 : LIST_TOPLEVELS - masters_before;
+    if(target >= (int32_t)(masters_before + slave_count)) continue;
+
+    lists_fill(masters_before, slave_count);
+    list_toplevels[dropped].id = dropped;
+
+    /* left and top of the middle of the box, or right and bottom of it */
+    int32_t position = side == 0 ? 120 : 180;
+    layout_math_insert_tiled(&masters, &slaves, master_count, &list_toplevels[dropped].link,
+                             target == -1 ? NULL : &list_toplevels[target].link, &box,
+                             position, position);
+
+    struct expected_list m, s;
+    expected_fill(&m, &s, masters_before, slave_count);
+    if(target == -1) {
+      if(masters_before < master_count) {
+        expected_insert(&m, m.length, dropped);
+      } else {
+        expected_insert(&s, s.length, dropped);
+      }
+    } else if((uint32_t)target < masters_before) {
+      bool last_with_slaves = (uint32_t)target == masters_before - 1 && slave_count > 0;
+      bool before = last_with_slaves || side == 0;
+      expected_insert(&m, target + (before ? 0 : 1), dropped);
+    } else {
+      expected_insert(&s, target - masters_before + (side == 0 ? 0 : 1), dropped);
+    }
+    if(m.length > master_count) {
+      expected_insert(&s, s.length, expected_remove(&m, m.length - 1));
+    }
+
+    char detail[64];
+    snprintf(detail, sizeof(detail), "%u wanted, %u masters, %u slaves, on %d, side %u",
+             master_count, masters_before, slave_count, target, side);
+    check_lists_match("insert", detail, &m, &s);
+  }
+}
+
+/* from any split of the toplevels to any master count, taking slaves from either end */
+void
+check_rebalance(void) {
+  for(uint32_t masters_before = 0; masters_before <= LIST_TOPLEVELS; masters_before++)
+  for(uint32_t master_count = 1; master_count <= LIST_TOPLEVELS + 1; master_count++)
+  for(uint32_t from_front = 0; from_front < 2; from_front++) {
+    uint32_t slave_count = LIST_TOPLEVELS - masters_before;
+    lists_fill(masters_before, slave_count);
+    layout_math_rebalance(&masters, &slaves, master_count, from_front);
+
+    struct expected_list m, s;
+    expected_fill(&m, &s, masters_before, slave_count);
+    while(m.length > master_count) {
+      expected_insert(&s, s.length, expected_remove(&m, m.length - 1));
+    }
+    while(m.length < master_count && s.length > 0) {
+      expected_insert(&m, m.length, expected_remove(&s, from_front ? 0 : s.length - 1));
+    }
+
+    char detail[64];
+    snprintf(detail, sizeof(detail), "%u masters, %u slaves, %u wanted, from %s",
+             masters_before, slave_count, master_count, from_front ? "front" : "back");
+    check_lists_match("rebalance", detail, &m, &s);
+  }
+
+  /* the master layout gets back the same order after changing the master count back */
+  for(uint32_t masters_before = 1; masters_before <= LIST_TOPLEVELS; masters_before++)
+  for(uint32_t master_count = 1; master_count <= LIST_TOPLEVELS; master_count++) {
+    uint32_t slave_count = LIST_TOPLEVELS - masters_before;
+    lists_fill(masters_before, slave_count);
+    layout_math_rebalance(&masters, &slaves, master_count, false);
+    layout_math_rebalance(&masters, &slaves, masters_before, false);
+
+    struct expected_list m, s;
+    expected_fill(&m, &s, masters_before, slave_count);
+
+    char detail[64];
+    snprintf(detail, sizeof(detail), "%u masters, %u slaves, through %u",
+             masters_before, slave_count, master_count);
+    check_lists_match("rebalance back", detail, &m, &s);
+  }
+}
+
+int
+main(int argc, char *argv[]) {
+  uint32_t configurations = 0;
+
+  check_swap();
+  check_insert();
+  check_rebalance();
+
+  for(size_t a = 0; a < LENGTH(areas); a++)
+  for(size_t o = 0; o < LENGTH(outer_gaps); o++)
+  for(size_t g = 0; g < LENGTH(inner_gaps); g++)
+  for(size_t b = 0; b < LENGTH(border_widths); b++)
+  for(size_t r = 0; r < LENGTH(ratios); r++) {
+    struct mwc_layout_params params = {
+      .outer_gaps = outer_gaps[o],
+      .inner_gaps = inner_gaps[g],
+      .border_width = border_widths[b],
+      .master_ratio = ratios[r],
+      .column_ratio = ratios[r],
+    };
+
+    for(size_t c = 0; c < LENGTH(toplevel_counts); c++) {
+      uint32_t count = toplevel_counts[c];
+
+      for(size_t m = 0; m < LENGTH(master_counts); m++) {
+        uint32_t masters = master_arrange(&params, &areas[a], count, master_counts[m]);
+        check("master", &params, &areas[a], count, masters, false);
+      }
+
+      /* scrolled to the start, the middle and past the end of the strip */
+      int32_t offsets[] = { 0, count * areas[a].width / 4, INT32_MAX / 2 };
+      for(size_t s = 0; s < LENGTH(offsets); s++) {
+        scrolling_arrange(&params, &areas[a], count, offsets[s]);
+        check("scrolling", &params, &areas[a], count, 0, true);
+      }
+
+      configurations++;
+    }
+  }
+
+  printf("checked %u configurations, %u violations, %u layouts without room for gaps and borders\n\n",
+         configurations, violations, degenerate);
+
+  if(argc > 1 && strcmp(argv[1], "--check") == 0) {
+    return violations == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  struct mwc_layout_params params = {
+    .outer_gaps = 12,
+    .inner_gaps = 6,
+    .border_width = 3,
+    .master_ratio = 0.5,
+    .column_ratio = 0.5,
+  };
+
+  printf("%10s %16s %16s\n", "toplevels", "master (ns)", "scrolling (ns)");
+  for(size_t c = 0; c < LENGTH(toplevel_counts); c++) {
+    uint32_t count = toplevel_counts[c];
+
+    uint64_t start = now_ns();
+    for(uint32_t i = 0; i < ITERATIONS; i++) {
+      master_arrange(&params, &areas[0], count, 1);
+    }
+    uint64_t master_ns = (now_ns() - start) / ITERATIONS;
+
+    start = now_ns();
+    for(uint32_t i = 0; i < ITERATIONS; i++) {
+      scrolling_arrange(&params, &areas[0], count, i);
+    }
+    uint64_t scrolling_ns = (now_ns() - start) / ITERATIONS;
+
+    printf("%10u %16" PRIu64 " %16" PRIu64 "\n", count, master_ns, scrolling_ns);
+  }
+
+  return violations == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
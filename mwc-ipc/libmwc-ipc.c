@@ -0,0 +1,276 @@
+#include "libmwc-ipc.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define READ_SIZE 65536
+
+struct mwc_ipc_connection *
+mwc_ipc_connect(const char *path) {
+  if(path == NULL) {
+    path = getenv(IPC_SOCKET_ENV);
+  }
+  if(path == NULL) {
+    path = IPC_PATH;
+  }
+
+  struct sockaddr_un address = {0};
+  if(strlen(path) >= sizeof(address.sun_path)) {
+    errno = ENAMETOOLONG;
+    return NULL;
+  }
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, path);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if(fd == -1) return NULL;
+
+  /* connecting to a local socket does not block for long, so only the rest is non blocking */
+  if(connect(fd, (struct sockaddr *)&address, sizeof(address)) == -1
+     || fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) == -1) {
+    int error = errno;
+    close(fd);
+    errno = error;
+    return NULL;
+  }
+
+  struct mwc_ipc_connection *connection = calloc(1, sizeof(*connection));
+  if(connection == NULL) {
+    close(fd);
+    return NULL;
+  }
+  connection->fd = fd;
+  connection->next_id = 1;
+
+  return connection;
+}
+
+void
+mwc_ipc_disconnect(struct mwc_ipc_connection *connection) {
+  for(size_t i = 0; i < connection->fd_count; i++) {
+    close(connection->fds[i]);
+  }
+  close(connection->fd);
+  free(connection->in);
+  free(connection->out);
+  free(connection);
+}
+
+short
+mwc_ipc_events(struct mwc_ipc_connection *connection) {
+  return connection->out_sent < connection->out_length ? POLLIN | POLLOUT : POLLIN;
+}
+
+/* makes room for length more bytes after length, false if there is no memory */
+bool
+mwc_ipc_reserve(char **data, size_t *cap, size_t length, size_t more) {
+  if(length + more <= *cap) return true;
+
+  size_t new_cap = *cap > 0 ? *cap : 4096;
+  while(new_cap < length + more) {
+    new_cap *= 2;
+  }
+
+  char *new_data = realloc(*data, new_cap);
+  if(new_data == NULL) return false;
+
+  *data = new_data;
+  *cap = new_cap;
+  return true;
+}
+
+uint32_t
+mwc_ipc_send(struct mwc_ipc_connection *connection, const char *request, enum ipc_encoding encoding) {
+  size_t length = strlen(request);
+  if(length > IPC_MAX_REQUEST_LENGTH) {
+    errno = EMSGSIZE;
+    return 0;
+  }
+
+  struct ipc_header header = {
+    .length = length,
+    .id = connection->next_id,
+    .version = IPC_PROTOCOL_VERSION,
+    .type = IPC_MESSAGE_REQUEST,
+    .encoding = encoding,
+  };
+
+  if(!mwc_ipc_reserve(&connection->out, &connection->out_cap, connection->out_length,
+                      sizeof(header) + length)) return 0;
+
+  memcpy(connection->out + connection->out_length, &header, sizeof(header));
+  memcpy(connection->out + connection->out_length + sizeof(header), request, length);
+  connection->out_length += sizeof(header) + length;
+
+  /* ids wrap around, but never to 0 */
+  connection->next_id = connection->next_id == UINT32_MAX ? 1 : connection->next_id + 1;
+
+  if(mwc_ipc_flush(connection) == -1) return 0;
+  return header.id;
+}
+
+int
+mwc_ipc_flush(struct mwc_ipc_connection *connection) {
+  while(connection->out_sent < connection->out_length) {
+    ssize_t n = send(connection->fd, connection->out + connection->out_sent,
+                     connection->out_length - connection->out_sent, MSG_NOSIGNAL);
+    if(n < 0) {
+      if(errno == EINTR) continue;
+      if(errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+      return -1;
+    }
+    connection->out_sent += n;
+  }
+
+  connection->out_sent = 0;
+  connection->out_length = 0;
+  return 1;
+}
+
+/* keeps the file descriptors that came with the data */
+void
+mwc_ipc_take_fds(struct mwc_ipc_connection *connection, struct msghdr *message) {
+  for(struct cmsghdr *cmsg = CMSG_FIRSTHDR(message); cmsg != NULL; cmsg = CMSG_NXTHDR(message, cmsg)) {
+    if(cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) continue;
+
+    size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    for(size_t i = 0; i < count; i++) {
+      int fd;
+      memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+      /* the compositor never sends this many, whatever it is does not belong to us */
+      if(connection->fd_count == MWC_IPC_MAX_FDS) {
+        close(fd);
+        continue;
+      }
+      connection->fds[connection->fd_count++] = fd;
+    }
+  }
+}
+
+int
+mwc_ipc_read(struct mwc_ipc_connection *connection) {
+  /* messages that were handed out are not needed anymore */
+  memmove(connection->in, connection->in + connection->in_start,
+          connection->in_length - connection->in_start);
+  connection->in_length -= connection->in_start;
+  connection->in_start = 0;
+
+  bool got_data = false;
+  while(true) {
+    if(!mwc_ipc_reserve(&connection->in, &connection->in_cap, connection->in_length, READ_SIZE)) {
+      return -1;
+    }
+
+    struct iovec iov = {
+      .iov_base = connection->in + connection->in_length,
+      .iov_len = connection->in_cap - connection->in_length,
+    };
+    char control[CMSG_SPACE(sizeof(int) * MWC_IPC_MAX_FDS)];
+    struct msghdr message = {
+      .msg_iov = &iov,
+      .msg_iovlen = 1,
+      .msg_control = control,
+      .msg_controllen = sizeof(control),
+    };
+
+    ssize_t n = recvmsg(connection->fd, &message, MSG_CMSG_CLOEXEC);
+    if(n < 0) {
+      if(errno == EINTR) continue;
+      if(errno == EAGAIN || errno == EWOULDBLOCK) return got_data ? 1 : 0;
+      return -1;
+    }
+    /* whatever came before the end is still handed out */
+    if(n == 0) return got_data ? 1 : -1;
+
+    mwc_ipc_take_fds(connection, &message);
+    connection->in_length += n;
+    got_data = true;
+  }
+}
+
+bool
+mwc_ipc_next_message(struct mwc_ipc_connection *connection, struct mwc_ipc_message *message) {
+  size_t available = connection->in_length - connection->in_start;
+  if(available < sizeof(struct ipc_header)) return false;
+
+  struct ipc_header header;
+  memcpy(&header, connection->in + connection->in_start, sizeof(header));
+  if(available < sizeof(header) + header.length) return false;
+
+  *message = (struct mwc_ipc_message){
+    .type = header.type,
+    .id = header.id,
+    .encoding = header.encoding,
+    .flags = header.flags,
+    .payload = connection->in + connection->in_start + sizeof(header),
+    .length = header.length,
+    .fd = -1,
+  };
+
+  /* they arrive in the order of their messages */
+  if((header.flags & IPC_MESSAGE_HAS_FD) && connection->fd_count > 0) {
+    message->fd = connection->fds[0];
+    connection->fd_count--;
+    memmove(connection->fds, connection->fds + 1, connection->fd_count * sizeof(int));
+  }
+
+  connection->in_start += sizeof(header) + header.length;
+  return true;
+}
+
+bool
+mwc_ipc_wait_message(struct mwc_ipc_connection *connection, struct mwc_ipc_message *message) {
+  while(!mwc_ipc_next_message(connection, message)) {
+    struct pollfd pollfd = {
+      .fd = connection->fd,
+      .events = mwc_ipc_events(connection),
+    };
+    if(poll(&pollfd, 1, -1) == -1) {
+      if(errno == EINTR) continue;
+      return false;
+    }
+
+    if((pollfd.revents & POLLOUT) && mwc_ipc_flush(connection) == -1) return false;
+    if((pollfd.revents & (POLLIN | POLLHUP | POLLERR)) && mwc_ipc_read(connection) == -1) {
+      /* the last messages may have come together with the end */
+      return mwc_ipc_next_message(connection, message);
+    }
+  }
+  return true;
+}
+
+const struct ipc_shm_state *
+mwc_ipc_shm_map(int fd) {
+  struct ipc_shm_state *shared = mmap(NULL, sizeof(*shared), PROT_READ, MAP_SHARED, fd, 0);
+  if(shared == MAP_FAILED) return NULL;
+
+  if(shared->version != IPC_SHM_VERSION) {
+    munmap(shared, sizeof(*shared));
+    errno = EPROTONOSUPPORT;
+    return NULL;
+  }
+  return shared;
+}
+
+void
+mwc_ipc_shm_unmap(const struct ipc_shm_state *shared) {
+  munmap((void *)shared, sizeof(*shared));
+}
+
+void
+mwc_ipc_shm_read(const struct ipc_shm_state *shared, struct ipc_shm_state *state) {
+  uint32_t sequence;
+  do {
+    sequence = __atomic_load_n(&shared->sequence, __ATOMIC_ACQUIRE);
+    memcpy(state, shared, sizeof(*state));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  } while((sequence & 1) || sequence != __atomic_load_n(&shared->sequence, __ATOMIC_RELAXED));
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+/* a client for the ipc of mwc that never blocks, unless asked to. it takes care of
+ * the framing, so requests can be pipelined and replies come out whole, however
+ * the socket splits them. the fd can be added to epoll or poll as is, waiting for
+ * mwc_ipc_events(); POLLIN and POLLOUT have the same values as EPOLLIN and EPOLLOUT.
+ *
+ *   struct mwc_ipc_connection *connection = mwc_ipc_connect(NULL);
+ *   mwc_ipc_send(connection, "toplevels", IPC_ENCODING_JSON);
+ *   then whenever poll says so:
+ *     mwc_ipc_flush(connection);
+ *     mwc_ipc_read(connection);
+ *     while(mwc_ipc_next_message(connection, &message)) ... */
+
+#include "ipc_shared.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* more than one is never in flight, see the shm request */
+#define MWC_IPC_MAX_FDS 4
+
+/* payload is not null terminated, and only valid until the next mwc_ipc_read() */
+struct mwc_ipc_message {
+  enum ipc_message_type type;
+  uint32_t id;
+  enum ipc_encoding encoding;
+  /* enum ipc_message_flags, IPC_MESSAGE_STATE tells events that repeat the state apart */
+  uint8_t flags;
+  const char *payload;
+  uint32_t length;
+  /* the file descriptor that came with it, or -1. it belongs to the caller */
+  int fd;
+};
+
+struct mwc_ipc_connection {
+  int fd;
+  uint32_t next_id;
+
+  /* received bytes, the messages before in_start are handed out already */
+  char *in;
+  size_t in_start;
+  size_t in_length;
+  size_t in_cap;
+
+  /* requests that the socket did not take yet */
+  char *out;
+  size_t out_sent;
+  size_t out_length;
+  size_t out_cap;
+
+  /* received, waiting for the message they belong to */
+  int fds[MWC_IPC_MAX_FDS];
+  size_t fd_count;
+};
+
+/* path is $MWC_IPC_SOCKET, or else IPC_PATH, if NULL. returns NULL with errno set on failure */
+struct mwc_ipc_connection *
+mwc_ipc_connect(const char *path);
+
+/* closes the connection, and file descriptors that were not handed out */
+void
+mwc_ipc_disconnect(struct mwc_ipc_connection *connection);
+
+/* what to wait for on connection->fd, POLLOUT only while requests are waiting */
+short
+mwc_ipc_events(struct mwc_ipc_connection *connection);
+
+/* queues the request, and writes it if the socket takes it. returns its id, which its
+ * reply carries too, or 0 if the request is too long or the connection is broken */
+uint32_t
+mwc_ipc_send(struct mwc_ipc_connection *connection, const char *request, enum ipc_encoding encoding);
+
+/* writes queued requests. returns 1 if everything is written, 0 if the rest has to
+ * wait for POLLOUT and -1 if the connection is broken */
+int
+mwc_ipc_flush(struct mwc_ipc_connection *connection);
+
+/* reads everything that is there. returns 1 if something was read, 0 if there was
+ * nothing and -1 on errors or once the compositor closed the connection */
+int
+mwc_ipc_read(struct mwc_ipc_connection *connection);
+
+/* takes the next whole message, false if there is none yet */
+bool
+mwc_ipc_next_message(struct mwc_ipc_connection *connection, struct mwc_ipc_message *message);
+
+/* blocks until the next message is there, false if the connection is broken */
+bool
+mwc_ipc_wait_message(struct mwc_ipc_connection *connection, struct mwc_ipc_message *message);
+
+/* maps the file descriptor of the reply to shm, NULL on failure */
+const struct ipc_shm_state *
+mwc_ipc_shm_map(int fd);
+
+void
+mwc_ipc_shm_unmap(const struct ipc_shm_state *shared);
+
+/* copies a consistent state, retrying while the compositor writes. no syscalls */
+void
+mwc_ipc_shm_read(const struct ipc_shm_state *shared, struct ipc_shm_state *state);
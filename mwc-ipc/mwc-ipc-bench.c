@@ -0,0 +1,819 @@
+/* puts mwc under ipc load and measures how it copes. it starts a headless mwc and
+ * test clients on it, which change their titles at a fixed rate once the load starts.
+ * subscribers, some of them deliberately slow, receive every event while a control
+ * client moves the focus between the test clients, churns the layout and queries the
+ * compositor. it reports how long events and queries take to arrive, how frame times
+ * change under the load and what was dropped:
+ *   mwc-ipc-bench -m build/mwc -t 8 -T 30 -f 30 -s 20 -S 2 -q 100 -c 60 -d 10
+ * with -a it attaches to the mwc at $MWC_IPC_SOCKET or /tmp/mwc/ipc instead, and only
+ * moves the focus between the toplevels already there.
+ * it is not built by default, build it with `ninja -C build mwc-ipc-bench` */
+
+#define _GNU_SOURCE
+
+#include "ipc_shared.h"
+#include "xdg-shell-client-protocol.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <wayland-client.h>
+
+#define MAX_SUBSCRIBERS 256
+#define MAX_TEST_CLIENTS 64
+/* focus is moved between at most this many toplevels */
+#define MAX_TOPLEVELS 256
+/* how long the compositor and the test clients get to show up */
+#define STARTUP_TIMEOUT_MS 5000
+/* test clients draw a buffer this big, whatever size they are configured to */
+#define TEST_CLIENT_SIZE 64
+/* replies are matched to their query by id, modulo this */
+#define QUERY_SLOTS 65536
+/* slow subscribers read at most this much at a time */
+#define SLOW_READ_SIZE 4096
+#define FAST_READ_SIZE 65536
+
+struct bench_samples {
+  uint32_t *data;
+  size_t length;
+  size_t cap;
+};
+
+struct bench_client {
+  int fd;
+  bool slow;
+  bool closed;
+  char *in;
+  size_t in_length;
+  size_t in_cap;
+  /* slow subscribers are not read before this */
+  uint64_t next_read_usec;
+  uint64_t events;
+};
+
+uint32_t subscriber_count = 20;
+uint32_t slow_count = 2;
+uint32_t slow_delay_ms = 100;
+uint32_t query_rate = 100;
+uint32_t churn_rate = 60;
+uint32_t duration_s = 10;
+uint32_t baseline_s = 2;
+uint32_t test_client_count = 4;
+uint32_t title_rate = 30;
+uint32_t focus_rate = 30;
+bool attach = false;
+const char *mwc_path = "mwc";
+
+char ipc_path[108];
+pid_t compositor_pid = 0;
+pid_t test_client_pids[MAX_TEST_CLIENTS];
+uint32_t test_clients_started = 0;
+
+struct bench_client subscribers[MAX_SUBSCRIBERS];
+struct bench_client control;
+/* 0 for requests that are not timed */
+uint64_t query_sent_usec[QUERY_SLOTS];
+
+struct bench_samples fast_latencies;
+struct bench_samples slow_latencies;
+struct bench_samples query_latencies;
+uint64_t requests_sent = 0;
+uint64_t errors = 0;
+
+uint64_t
+now_usec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000ull + ts.tv_nsec / 1000;
+}
+
+bool
+write_all(int fd, const void *data, size_t length) {
+  const char *p = data;
+  while(length > 0) {
+    ssize_t n = write(fd, p, length);
+    if(n <= 0) return false;
+    p += n;
+    length -= n;
+  }
+  return true;
+}
+
+bool
+read_all(int fd, void *data, size_t length) {
+  char *p = data;
+  while(length > 0) {
+    ssize_t n = read(fd, p, length);
+    if(n <= 0) return false;
+    p += n;
+    length -= n;
+  }
+  return true;
+}
+
+int
+ipc_connect(void) {
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if(fd == -1) return -1;
+
+  struct sockaddr_un address = {0};
+  address.sun_family = AF_UNIX;
+  snprintf(address.sun_path, sizeof(address.sun_path), "%s", ipc_path);
+
+  if(connect(fd, (struct sockaddr *)&address, sizeof(address)) == -1) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+bool
+ipc_send_request(int fd, uint32_t id, const char *request) {
+  struct ipc_header header = {
+    .length = strlen(request),
+    .id = id,
+    .version = IPC_PROTOCOL_VERSION,
+    .type = IPC_MESSAGE_REQUEST,
+    .encoding = IPC_ENCODING_JSON,
+  };
+
+  requests_sent++;
+  return write_all(fd, &header, sizeof(header)) && write_all(fd, request, header.length);
+}
+
+/* sends the request and waits for its reply, which is returned null terminated */
+char *
+ipc_query(int fd, const char *request) {
+  if(!ipc_send_request(fd, 1, request)) return NULL;
+
+  struct ipc_header header;
+  if(!read_all(fd, &header, sizeof(header))) return NULL;
+
+  char *payload = malloc(header.length + 1);
+  if(!read_all(fd, payload, header.length) || header.type != IPC_MESSAGE_REPLY) {
+    free(payload);
+    return NULL;
+  }
+  payload[header.length] = 0;
+  return payload;
+}
+
+/* adds up the numbers after every occurrence of "key": in the json */
+uint64_t
+json_sum(const char *json, const char *key) {
+  char pattern[64];
+  snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+
+  uint64_t sum = 0;
+  const char *p = json;
+  while((p = strstr(p, pattern)) != NULL) {
+    p += strlen(pattern);
+    sum += strtoull(p, NULL, 10);
+  }
+  return sum;
+}
+
+uint64_t
+json_max(const char *json, const char *key) {
+  char pattern[64];
+  snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+
+  uint64_t result = 0;
+  const char *p = json;
+  while((p = strstr(p, pattern)) != NULL) {
+    p += strlen(pattern);
+    uint64_t value = strtoull(p, NULL, 10);
+    if(value > result) result = value;
+  }
+  return result;
+}
+
+struct frame_times {
+  uint64_t count;
+  uint64_t total_usec;
+  /* since the previous call */
+  uint64_t max_usec;
+};
+
+/* every call starts a new window for the max */
+bool
+get_frame_times(int fd, struct frame_times *frame_times) {
+  char *reply = ipc_query(fd, "frame-times reset");
+  if(reply == NULL) return false;
+
+  *frame_times = (struct frame_times){
+    .count = json_sum(reply, "count"),
+    .total_usec = json_sum(reply, "total_usec"),
+    .max_usec = json_max(reply, "window_max_usec"),
+  };
+  free(reply);
+  return true;
+}
+
+void
+samples_add(struct bench_samples *samples, uint32_t value) {
+  if(samples->length == samples->cap) {
+    samples->cap = samples->cap > 0 ? samples->cap * 2 : 1024;
+    samples->data = realloc(samples->data, samples->cap * sizeof(*samples->data));
+  }
+  samples->data[samples->length++] = value;
+}
+
+int
+compare_u32(const void *a, const void *b) {
+  uint32_t x = *(const uint32_t *)a;
+  uint32_t y = *(const uint32_t *)b;
+  return (x > y) - (x < y);
+}
+
+double
+percentile_ms(struct bench_samples *samples, double p) {
+  size_t i = (size_t)(p / 100 * (samples->length - 1) + 0.5);
+  return samples->data[i] / 1000.0;
+}
+
+void
+samples_print(const char *name, struct bench_samples *samples) {
+  if(samples->length == 0) {
+    printf("%-20s no samples\n", name);
+    return;
+  }
+
+  qsort(samples->data, samples->length, sizeof(*samples->data), compare_u32);
+  printf("%-20s %8zu  p50 %8.3f  p90 %8.3f  p99 %8.3f  p99.9 %8.3f  max %8.3f ms\n",
+         name, samples->length, percentile_ms(samples, 50), percentile_ms(samples, 90),
+         percentile_ms(samples, 99), percentile_ms(samples, 99.9),
+         samples->data[samples->length - 1] / 1000.0);
+}
+
+/* handles the whole messages in the buffer of the client */
+void
+client_handle_messages(struct bench_client *client, uint64_t now) {
+  size_t start = 0;
+  while(client->in_length - start >= sizeof(struct ipc_header)) {
+    struct ipc_header header;
+    memcpy(&header, client->in + start, sizeof(header));
+    if(client->in_length - start < sizeof(header) + header.length) break;
+
+    const char *payload = client->in + start + sizeof(header);
+    if(header.type == IPC_MESSAGE_EVENT) {
+      client->events++;
+      const char *time = memmem(payload, header.length, "\"time_usec\":", 12);
+      if(time != NULL) {
+        uint64_t sent = strtoull(time + 12, NULL, 10);
+        samples_add(client->slow ? &slow_latencies : &fast_latencies, now - sent);
+      }
+    } else {
+      if(header.type == IPC_MESSAGE_ERROR) errors++;
+
+      uint64_t *sent = &query_sent_usec[header.id % QUERY_SLOTS];
+      if(client == &control && *sent != 0) {
+        samples_add(&query_latencies, now - *sent);
+        *sent = 0;
+      }
+    }
+
+    start += sizeof(header) + header.length;
+  }
+
+  memmove(client->in, client->in + start, client->in_length - start);
+  client->in_length -= start;
+}
+
+/* reads at most limit bytes, returns false once the compositor closed the connection */
+bool
+client_read(struct bench_client *client, size_t limit) {
+  if(client->in_length + limit > client->in_cap) {
+    client->in_cap = client->in_length + limit;
+    client->in = realloc(client->in, client->in_cap);
+  }
+
+  ssize_t n = read(client->fd, client->in + client->in_length, limit);
+  if(n <= 0) return false;
+
+  client->in_length += n;
+  return true;
+}
+
+/* a test client is a forked process with a single toplevel. it changes its title
+ * title_rate times a second after it gets SIGUSR1, and is killed with SIGTERM */
+struct test_client {
+  struct wl_compositor *compositor;
+  struct wl_shm *shm;
+  struct xdg_wm_base *wm_base;
+  struct wl_surface *surface;
+  struct wl_buffer *buffer;
+  bool closed;
+};
+
+volatile sig_atomic_t test_client_churning = 0;
+
+void
+test_client_handle_usr1(int signum) {
+  test_client_churning = 1;
+}
+
+void
+wm_base_handle_ping(void *data, struct xdg_wm_base *wm_base, uint32_t serial) {
+  xdg_wm_base_pong(wm_base, serial);
+}
+
+const struct xdg_wm_base_listener wm_base_listener = {
+  .ping = wm_base_handle_ping,
+};
+
+void
+registry_handle_global(void *data, struct wl_registry *registry, uint32_t name,
+                       const char *interface, uint32_t version) {
+  struct test_client *client = data;
+  if(strcmp(interface, wl_compositor_interface.name) == 0) {
+    client->compositor = wl_registry_bind(registry, name, &wl_compositor_interface, 1);
+  } else if(strcmp(interface, wl_shm_interface.name) == 0) {
+    client->shm = wl_registry_bind(registry, name, &wl_shm_interface, 1);
+  } else if(strcmp(interface, xdg_wm_base_interface.name) == 0) {
+    client->wm_base = wl_registry_bind(registry, name, &xdg_wm_base_interface, 1);
+    xdg_wm_base_add_listener(client->wm_base, &wm_base_listener, client);
+  }
+}
+
+void
+registry_handle_global_remove(void *data, struct wl_registry *registry, uint32_t name) {
+  /* do nothing */
+}
+
+const struct wl_registry_listener registry_listener = {
+  .global = registry_handle_global,
+  .global_remove = registry_handle_global_remove,
+};
+
+void
+xdg_surface_handle_configure(void *data, struct xdg_surface *xdg_surface, uint32_t serial) {
+  struct test_client *client = data;
+  xdg_surface_ack_configure(xdg_surface, serial);
+  wl_surface_attach(client->surface, client->buffer, 0, 0);
+  wl_surface_damage(client->surface, 0, 0, TEST_CLIENT_SIZE, TEST_CLIENT_SIZE);
+  wl_surface_commit(client->surface);
+}
+
+const struct xdg_surface_listener xdg_surface_listener = {
+  .configure = xdg_surface_handle_configure,
+};
+
+void
+xdg_toplevel_handle_configure(void *data, struct xdg_toplevel *xdg_toplevel,
+                              int32_t width, int32_t height, struct wl_array *states) {
+  /* do nothing, the buffer stays the same size */
+}
+
+void
+xdg_toplevel_handle_close(void *data, struct xdg_toplevel *xdg_toplevel) {
+  struct test_client *client = data;
+  client->closed = true;
+}
+
+const struct xdg_toplevel_listener xdg_toplevel_listener = {
+  .configure = xdg_toplevel_handle_configure,
+  .close = xdg_toplevel_handle_close,
+};
+
+/* a black buffer, the memory of a fresh memfd is zeroed already */
+struct wl_buffer *
+test_client_create_buffer(struct wl_shm *shm) {
+  int32_t stride = TEST_CLIENT_SIZE * 4;
+  int32_t size = stride * TEST_CLIENT_SIZE;
+
+  int fd = memfd_create("mwc-ipc-bench", MFD_CLOEXEC);
+  if(fd == -1) return NULL;
+  if(ftruncate(fd, size) == -1) {
+    close(fd);
+    return NULL;
+  }
+
+  struct wl_shm_pool *pool = wl_shm_create_pool(shm, fd, size);
+  struct wl_buffer *buffer = wl_shm_pool_create_buffer(pool, 0, TEST_CLIENT_SIZE, TEST_CLIENT_SIZE,
+                                                       stride, WL_SHM_FORMAT_XRGB8888);
+  wl_shm_pool_destroy(pool);
+  close(fd);
+  return buffer;
+}
+
+int
+test_client_run(const char *socket_name, uint32_t index) {
+  struct sigaction sa = { .sa_handler = test_client_handle_usr1 };
+  sigemptyset(&sa.sa_mask);
+  /* no SA_RESTART, so the signal wakes up the poll below */
+  sigaction(SIGUSR1, &sa, NULL);
+
+  struct wl_display *display = wl_display_connect(socket_name);
+  if(display == NULL) {
+    fprintf(stderr, "test client %u could not connect to %s\n", index, socket_name);
+    return 1;
+  }
+
+  struct test_client client = {0};
+  struct wl_registry *registry = wl_display_get_registry(display);
+  wl_registry_add_listener(registry, &registry_listener, &client);
+  wl_display_roundtrip(display);
+  if(client.compositor == NULL || client.shm == NULL || client.wm_base == NULL) {
+    fprintf(stderr, "test client %u is missing globals\n", index);
+    return 1;
+  }
+
+  client.buffer = test_client_create_buffer(client.shm);
+  if(client.buffer == NULL) {
+    perror("buffer");
+    return 1;
+  }
+
+  char title[64];
+  snprintf(title, sizeof(title), "mwc-ipc-bench %u", index);
+
+  client.surface = wl_compositor_create_surface(client.compositor);
+  struct xdg_surface *xdg_surface = xdg_wm_base_get_xdg_surface(client.wm_base, client.surface);
+  xdg_surface_add_listener(xdg_surface, &xdg_surface_listener, &client);
+  struct xdg_toplevel *xdg_toplevel = xdg_surface_get_toplevel(xdg_surface);
+  xdg_toplevel_add_listener(xdg_toplevel, &xdg_toplevel_listener, &client);
+  xdg_toplevel_set_app_id(xdg_toplevel, "mwc-ipc-bench");
+  xdg_toplevel_set_title(xdg_toplevel, title);
+  /* the first commit has no buffer, the compositor answers it with a configure */
+  wl_surface_commit(client.surface);
+
+  uint64_t next_title = 0;
+  uint64_t titles = 0;
+  struct pollfd fd = { .fd = wl_display_get_fd(display), .events = POLLIN };
+  while(!client.closed) {
+    uint64_t now = now_usec();
+    if(test_client_churning && title_rate > 0) {
+      if(next_title == 0) next_title = now;
+      for(; next_title <= now; next_title += 1000000 / title_rate) {
+        snprintf(title, sizeof(title), "mwc-ipc-bench %u %" PRIu64, index, titles++);
+        xdg_toplevel_set_title(xdg_toplevel, title);
+      }
+    }
+
+    if(wl_display_flush(display) == -1 && errno != EAGAIN) break;
+
+    int timeout = -1;
+    if(test_client_churning && title_rate > 0) {
+      timeout = next_title > now ? (next_title - now + 999) / 1000 : 0;
+    }
+    int n = poll(&fd, 1, timeout);
+    if(n == -1 && errno != EINTR) break;
+
+    if(n > 0 && wl_display_dispatch(display) == -1) break;
+  }
+
+  wl_display_disconnect(display);
+  return 0;
+}
+
+void
+test_clients_signal(int signum) {
+  for(uint32_t i = 0; i < test_clients_started; i++) {
+    kill(test_client_pids[i], signum);
+  }
+}
+
+/* runs at exit, so nothing started is left behind however the bench ends */
+void
+cleanup(void) {
+  test_clients_signal(SIGTERM);
+  for(uint32_t i = 0; i < test_clients_started; i++) {
+    waitpid(test_client_pids[i], NULL, 0);
+  }
+  test_clients_started = 0;
+
+  if(compositor_pid > 0) {
+    int fd = ipc_connect();
+    if(fd == -1 || !ipc_send_request(fd, 1, "exit")) {
+      kill(compositor_pid, SIGTERM);
+    }
+    waitpid(compositor_pid, NULL, 0);
+    if(fd != -1) close(fd);
+    compositor_pid = 0;
+  }
+}
+
+void
+sleep_ms(uint32_t ms) {
+  struct timespec ts = { .tv_sec = ms / 1000, .tv_nsec = (ms % 1000) * 1000000l };
+  nanosleep(&ts, NULL);
+}
+
+/* starts mwc --headless, its ipc socket is named after its pid */
+bool
+compositor_start(const char *socket_name) {
+  compositor_pid = fork();
+  if(compositor_pid == -1) {
+    perror("fork");
+    compositor_pid = 0;
+    return false;
+  }
+  if(compositor_pid == 0) {
+    execlp(mwc_path, mwc_path, "--headless", "--socket", socket_name, (char *)NULL);
+    perror(mwc_path);
+    _exit(127);
+  }
+
+  snprintf(ipc_path, sizeof(ipc_path), "%s-headless-%d", IPC_PATH, compositor_pid);
+  for(uint32_t waited = 0; waited < STARTUP_TIMEOUT_MS; waited += 10) {
+    int fd = ipc_connect();
+    if(fd != -1) {
+      close(fd);
+      return true;
+    }
+    if(waitpid(compositor_pid, NULL, WNOHANG) == compositor_pid) {
+      compositor_pid = 0;
+      fprintf(stderr, "%s exited before its ipc was ready\n", mwc_path);
+      return false;
+    }
+    sleep_ms(10);
+  }
+
+  fprintf(stderr, "the ipc of %s was not ready in %u ms\n", mwc_path, STARTUP_TIMEOUT_MS);
+  return false;
+}
+
+bool
+test_clients_start(const char *socket_name) {
+  for(uint32_t i = 0; i < test_client_count; i++) {
+    pid_t pid = fork();
+    if(pid == -1) {
+      perror("fork");
+      return false;
+    }
+    if(pid == 0) {
+      _exit(test_client_run(socket_name, i));
+    }
+    test_client_pids[test_clients_started++] = pid;
+  }
+  return true;
+}
+
+/* reads the ids of all the toplevels, returns how many there are */
+uint32_t
+get_toplevel_ids(int fd, uint64_t *ids) {
+  char *reply = ipc_query(fd, "toplevels");
+  if(reply == NULL) return 0;
+
+  uint32_t count = 0;
+  const char *p = reply;
+  while(count < MAX_TOPLEVELS && (p = strstr(p, "\"id\":")) != NULL) {
+    p += strlen("\"id\":");
+    ids[count++] = strtoull(p, NULL, 10);
+  }
+  free(reply);
+  return count;
+}
+
+void
+usage(void) {
+  fprintf(stderr,
+          "usage: mwc-ipc-bench [options]\n"
+          "  -m <path> mwc to start headless (default %s)\n"
+          "  -a       attach to the running mwc instead, without test clients\n"
+          "  -t <n>   test clients (default %u)\n"
+          "  -T <n>   title changes per second, per test client (default %u)\n"
+          "  -f <n>   focus changes per second (default %u)\n"
+          "  -s <n>   subscribers to all events (default %u)\n"
+          "  -S <n>   how many of them are slow (default %u)\n"
+          "  -w <ms>  slow subscribers read %u bytes at most this often (default %u)\n"
+          "  -q <n>   toplevels queries per second (default %u)\n"
+          "  -c <n>   master ratio changes per second (default %u)\n"
+          "  -d <s>   how long the load runs (default %u)\n"
+          "  -b <s>   how long frame times are measured before the load (default %u)\n",
+          mwc_path, test_client_count, title_rate, focus_rate,
+          subscriber_count, slow_count, SLOW_READ_SIZE, slow_delay_ms, query_rate,
+          churn_rate, duration_s, baseline_s);
+}
+
+int
+main(int argc, char *argv[]) {
+  int opt;
+  while((opt = getopt(argc, argv, "m:at:T:f:s:S:w:q:c:d:b:h")) != -1) {
+    uint32_t value = optarg != NULL ? strtoul(optarg, NULL, 10) : 0;
+    switch(opt) {
+      case 'm': mwc_path = optarg; break;
+      case 'a': attach = true; break;
+      case 't': test_client_count = value; break;
+      case 'T': title_rate = value; break;
+      case 'f': focus_rate = value; break;
+      case 's': subscriber_count = value; break;
+      case 'S': slow_count = value; break;
+      case 'w': slow_delay_ms = value; break;
+      case 'q': query_rate = value; break;
+      case 'c': churn_rate = value; break;
+      case 'd': duration_s = value; break;
+      case 'b': baseline_s = value; break;
+      default: usage(); return opt == 'h' ? 0 : 1;
+    }
+  }
+
+  if(subscriber_count > MAX_SUBSCRIBERS || slow_count > subscriber_count) {
+    fprintf(stderr, "at most %u subscribers, and no more slow ones than that\n", MAX_SUBSCRIBERS);
+    return 1;
+  }
+  if(test_client_count > MAX_TEST_CLIENTS) {
+    fprintf(stderr, "at most %u test clients\n", MAX_TEST_CLIENTS);
+    return 1;
+  }
+
+  if(attach) {
+    const char *path = getenv(IPC_SOCKET_ENV);
+    snprintf(ipc_path, sizeof(ipc_path), "%s", path != NULL ? path : IPC_PATH);
+    test_client_count = 0;
+  } else {
+    char socket_name[64];
+    snprintf(socket_name, sizeof(socket_name), "mwc-ipc-bench-%d", getpid());
+    atexit(cleanup);
+    if(!compositor_start(socket_name) || !test_clients_start(socket_name)) return 1;
+  }
+
+  /* used only for measuring, so its replies never wait behind the load */
+  int measure_fd = ipc_connect();
+  if(measure_fd == -1) {
+    perror("connect");
+    return 1;
+  }
+
+  /* the test clients are there once they are all mapped */
+  uint64_t toplevel_ids[MAX_TOPLEVELS];
+  uint32_t toplevel_count = get_toplevel_ids(measure_fd, toplevel_ids);
+  for(uint32_t waited = 0; toplevel_count < test_client_count; waited += 10) {
+    if(waited >= STARTUP_TIMEOUT_MS) {
+      fprintf(stderr, "only %u of %u test clients were mapped in %u ms\n",
+              toplevel_count, test_client_count, STARTUP_TIMEOUT_MS);
+      return 1;
+    }
+    sleep_ms(10);
+    toplevel_count = get_toplevel_ids(measure_fd, toplevel_ids);
+  }
+  if(toplevel_count < 2) {
+    fprintf(stderr, "less than two toplevels, the focus is not moved\n");
+  }
+
+  struct frame_times before, after_baseline, after_load;
+  if(!get_frame_times(measure_fd, &before)) goto frame_times_error;
+  sleep(baseline_s);
+  if(!get_frame_times(measure_fd, &after_baseline)) goto frame_times_error;
+
+  for(uint32_t i = 0; i < subscriber_count; i++) {
+    struct bench_client *subscriber = &subscribers[i];
+    subscriber->fd = ipc_connect();
+    subscriber->slow = i < slow_count;
+    if(subscriber->fd == -1 || !ipc_send_request(subscriber->fd, 1, "subscribe")) {
+      perror("subscribe");
+      return 1;
+    }
+  }
+
+  control.fd = ipc_connect();
+  if(control.fd == -1) {
+    perror("connect");
+    return 1;
+  }
+
+  /* only the load counts, not what was sent to get here */
+  requests_sent = 0;
+  errors = 0;
+  test_clients_signal(SIGUSR1);
+
+  uint64_t start = now_usec();
+  uint64_t end = start + duration_s * 1000000ull;
+  uint64_t next_query = start;
+  uint64_t next_churn = start;
+  uint64_t next_focus = start;
+  uint32_t focused = 0;
+  uint32_t next_id = 1;
+  uint32_t disconnected = 0;
+
+  struct pollfd fds[MAX_SUBSCRIBERS + 1];
+  struct bench_client *polled[MAX_SUBSCRIBERS + 1];
+
+  uint64_t now = start;
+  while(now < end) {
+    /* requests that are due, a late one is sent right away and does not move the others */
+    for(; query_rate > 0 && next_query <= now; next_query += 1000000 / query_rate) {
+      query_sent_usec[next_id % QUERY_SLOTS] = now;
+      ipc_send_request(control.fd, next_id++, "toplevels");
+    }
+    for(; churn_rate > 0 && next_churn <= now; next_churn += 1000000 / churn_rate) {
+      query_sent_usec[next_id % QUERY_SLOTS] = 0;
+      ipc_send_request(control.fd, next_id, next_id % 2 ? "master-ratio +0.05" : "master-ratio -0.05");
+      next_id++;
+    }
+    bool focusing = focus_rate > 0 && toplevel_count >= 2;
+    for(; focusing && next_focus <= now; next_focus += 1000000 / focus_rate) {
+      char request[64];
+      snprintf(request, sizeof(request), "focus %" PRIu64, toplevel_ids[focused++ % toplevel_count]);
+      query_sent_usec[next_id % QUERY_SLOTS] = 0;
+      ipc_send_request(control.fd, next_id++, request);
+    }
+
+    uint64_t wake = end;
+    if(query_rate > 0 && next_query < wake) wake = next_query;
+    if(churn_rate > 0 && next_churn < wake) wake = next_churn;
+    if(focusing && next_focus < wake) wake = next_focus;
+
+    size_t count = 0;
+    fds[count] = (struct pollfd){ .fd = control.fd, .events = POLLIN };
+    polled[count++] = &control;
+    for(uint32_t i = 0; i < subscriber_count; i++) {
+      struct bench_client *subscriber = &subscribers[i];
+      if(subscriber->closed) continue;
+
+      /* a slow subscriber lets the compositor queue up everything until its next read */
+      if(subscriber->slow && subscriber->next_read_usec > now) {
+        if(subscriber->next_read_usec < wake) wake = subscriber->next_read_usec;
+        continue;
+      }
+      fds[count] = (struct pollfd){ .fd = subscriber->fd, .events = POLLIN };
+      polled[count++] = subscriber;
+    }
+
+    int timeout = wake > now ? (wake - now + 999) / 1000 : 0;
+    if(poll(fds, count, timeout) == -1) continue;
+
+    now = now_usec();
+    for(size_t i = 0; i < count; i++) {
+      if(fds[i].revents == 0) continue;
+
+      struct bench_client *client = polled[i];
+      if(!client_read(client, client->slow ? SLOW_READ_SIZE : FAST_READ_SIZE)) {
+        if(client == &control) {
+          fprintf(stderr, "the compositor closed the control connection\n");
+          return 1;
+        }
+        /* with ipc_backpressure disconnect, that is what happens to slow subscribers */
+        client->closed = true;
+        disconnected++;
+        continue;
+      }
+      /* later than the poll, events may have come in meanwhile */
+      client_handle_messages(client, now_usec());
+      if(client->slow) {
+        client->next_read_usec = now + slow_delay_ms * 1000ull;
+      }
+    }
+  }
+
+  if(!get_frame_times(measure_fd, &after_load)) goto frame_times_error;
+  char *stats = ipc_query(measure_fd, "stats");
+  if(stats == NULL) {
+    fprintf(stderr, "could not get the stats\n");
+    return 1;
+  }
+
+  uint64_t fast_events = 0, slow_events = 0;
+  for(uint32_t i = 0; i < subscriber_count; i++) {
+    if(subscribers[i].slow) {
+      slow_events += subscribers[i].events;
+    } else {
+      fast_events += subscribers[i].events;
+    }
+  }
+
+  printf("%u toplevels, %u of them test clients changing their title %u times a second\n",
+         toplevel_count, test_client_count, title_rate);
+  printf("%u subscribers, %u of them slow, %u disconnected by the compositor\n",
+         subscriber_count, slow_count, disconnected);
+  printf("%" PRIu64 " requests sent, %" PRIu64 " errors\n", requests_sent, errors);
+  printf("%" PRIu64 " events received by fast subscribers, %" PRIu64 " by slow ones\n",
+         fast_events, slow_events);
+  samples_print("event latency, fast", &fast_latencies);
+  samples_print("event latency, slow", &slow_latencies);
+  samples_print("query latency", &query_latencies);
+
+  printf("events dropped %" PRIu64 ", coalesced in client queues %" PRIu64
+         ", coalesced before queueing %" PRIu64 "\n",
+         json_sum(stats, "dropped"), json_sum(stats, "coalesced"),
+         json_sum(stats, "coalesced_pending"));
+  free(stats);
+
+  uint64_t baseline_frames = after_baseline.count - before.count;
+  uint64_t load_frames = after_load.count - after_baseline.count;
+  printf("frame time without load %.1f us over %" PRIu64 " frames, with load %.1f us over %"
+         PRIu64 " frames, max %" PRIu64 " us (%" PRIu64 " us without the load)\n",
+         baseline_frames > 0 ? (double)(after_baseline.total_usec - before.total_usec) / baseline_frames : 0,
+         baseline_frames,
+         load_frames > 0 ? (double)(after_load.total_usec - after_baseline.total_usec) / load_frames : 0,
+         load_frames, after_load.max_usec, after_baseline.max_usec);
+
+  return 0;
+
+frame_times_error:
+  fprintf(stderr, "could not get the frame times, is the server running?\n");
+  return 1;
+}
@@ -1,44 +1,158 @@
-#include "ipc_shared.h"
+#include "libmwc-ipc.h"
 
+#include <errno.h>
+#include <poll.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
-#include <sys/socket.h>
-#include <sys/un.h>
 #include <unistd.h>
 
+/* prints the payload on a line, stdout for replies and events, stderr for errors */
 void
-ipc_subscribe(int fd) {
-  if(write(fd, "subscribe", strlen("subscribe")) < 0) {
-    printf("failed to write the message, is the server running?\n");
-    return;
-  };
-
-  char buffer[1024];
-  while(1) {
-    ssize_t len = read(fd, buffer, sizeof(buffer) - 1);
-    if(len <= 0) return;
-
-    buffer[len] = 0;
-    printf("%s", buffer);
-    fflush(stdout);
+print_message(struct mwc_ipc_message *message) {
+  FILE *stream = message->type == IPC_MESSAGE_ERROR ? stderr : stdout;
+  fwrite(message->payload, 1, message->length, stream);
+  fputc('\n', stream);
+  fflush(stream);
+}
+
+/* reads the shared state once and prints it */
+bool
+print_shm_state(int fd) {
+  const struct ipc_shm_state *shared = mwc_ipc_shm_map(fd);
+  if(shared == NULL) {
+    perror("shm");
+    return false;
+  }
+
+  static struct ipc_shm_state state;
+  mwc_ipc_shm_read(shared, &state);
+  mwc_ipc_shm_unmap(shared);
+
+  printf("generation %llu, active workspace %u, focused toplevel %llu%s\n",
+         (unsigned long long)state.generation, state.active_workspace,
+         (unsigned long long)state.focused_toplevel, state.truncated ? ", truncated" : "");
+  for(uint32_t i = 0; i < state.output_count; i++) {
+    struct ipc_shm_output *o = &state.outputs[i];
+    printf("output %s %dx%d+%d+%d scale %g, workspace %u\n",
+           o->name, o->width, o->height, o->x, o->y, o->scale, o->active_workspace);
+  }
+  for(uint32_t i = 0; i < state.workspace_count; i++) {
+    struct ipc_shm_workspace *w = &state.workspaces[i];
+    printf("workspace %u on %s, %s, master count %u, ratio %g\n",
+           w->index, state.outputs[w->output].name, w->layout == 1 ? "scrolling" : "master",
+           w->master_count, w->master_ratio);
   }
+  for(uint32_t i = 0; i < state.toplevel_count; i++) {
+    struct ipc_shm_toplevel *t = &state.toplevels[i];
+    printf("toplevel %llu '%s' '%s' on workspace %u %dx%d+%d+%d%s%s%s\n",
+           (unsigned long long)t->id, t->app_id, t->title, t->workspace,
+           t->width, t->height, t->x, t->y,
+           t->flags & IPC_SHM_FLOATING ? " floating" : "",
+           t->flags & IPC_SHM_FULLSCREEN ? " fullscreen" : "",
+           t->flags & IPC_SHM_FOCUSED ? " focused" : "");
+  }
+
+  return true;
 }
 
-void
-ipc_simple(int fd, char *message) {
-  if(write(fd, message, strlen(message)) < 0) {
-    printf("failed to write the message, is the server running?\n");
-    return;
-  };
-
-  char buffer[1024];
-  ssize_t len = read(fd, buffer, sizeof(buffer) - 1);
-  if(len <= 0) return;
-
-  buffer[len] = 0;
-  printf("%s", buffer);
-  fflush(stdout);
+/* sends every line of stdin as a request over the one connection, without waiting
+ * for replies in between. returns once stdin ends and every request has its reply */
+int
+run_batch(struct mwc_ipc_connection *connection) {
+  char input[2 * IPC_MAX_REQUEST_LENGTH];
+  size_t input_length = 0;
+  /* the rest of a line that was too long is thrown away */
+  bool skipping = false;
+  bool eof = false;
+  bool failed = false;
+  uint32_t waiting = 0;
+
+  while(!eof || waiting > 0) {
+    struct pollfd fds[2] = {
+      { .fd = connection->fd, .events = mwc_ipc_events(connection) },
+      { .fd = eof ? -1 : STDIN_FILENO, .events = POLLIN },
+    };
+    if(poll(fds, 2, -1) == -1) {
+      if(errno == EINTR) continue;
+      perror("poll");
+      return 1;
+    }
+
+    if((fds[0].revents & POLLOUT) && mwc_ipc_flush(connection) == -1) {
+      fprintf(stderr, "failed to write to the compositor\n");
+      return 1;
+    }
+
+    if(fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+      int result = mwc_ipc_read(connection);
+
+      struct mwc_ipc_message message;
+      while(mwc_ipc_next_message(connection, &message)) {
+        print_message(&message);
+        if(message.fd != -1) {
+          close(message.fd);
+        }
+        if(message.type == IPC_MESSAGE_REPLY || message.type == IPC_MESSAGE_ERROR) {
+          waiting--;
+          if(message.type == IPC_MESSAGE_ERROR) failed = true;
+        }
+      }
+
+      if(result == -1) {
+        fprintf(stderr, "the compositor closed the connection\n");
+        return 1;
+      }
+    }
+
+    if(fds[1].revents & (POLLIN | POLLHUP | POLLERR)) {
+      ssize_t n = read(STDIN_FILENO, input + input_length, sizeof(input) - input_length);
+      if(n < 0 && errno == EINTR) continue;
+      if(n <= 0) {
+        eof = true;
+        /* the last line does not need a newline */
+        if(input_length > 0 && !skipping) {
+          input[input_length++] = '\n';
+        }
+      } else {
+        input_length += n;
+      }
+
+      size_t start = 0;
+      char *newline;
+      while((newline = memchr(input + start, '\n', input_length - start)) != NULL) {
+        *newline = 0;
+        char *line = input + start;
+        start = newline - input + 1;
+
+        if(skipping) {
+          skipping = false;
+          continue;
+        }
+        if(line[0] == 0) continue;
+
+        if(mwc_ipc_send(connection, line, IPC_ENCODING_JSON) == 0) {
+          fprintf(stderr, "failed to send '%.64s': %s\n", line, strerror(errno));
+          failed = true;
+          continue;
+        }
+        waiting++;
+      }
+
+      memmove(input, input + start, input_length - start);
+      input_length -= start;
+
+      if(input_length == sizeof(input)) {
+        fprintf(stderr, "a line is longer than %d bytes, skipping it\n", IPC_MAX_REQUEST_LENGTH);
+        failed = true;
+        skipping = true;
+        input_length = 0;
+      }
+    }
+  }
+
+  return failed ? 1 : 0;
 }
 
 int
@@ -46,37 +160,81 @@ main(int argc, char *argv[]) {
   if(argc < 2 || strcmp(argv[1], "-h") == 0) {
     fprintf(stderr,
             "usage: mwc-ipc message\n"
+            "       mwc-ipc -b\n"
             "where message is one of\n"
-            "  subscribe - receive all the events from the compositor\n"
-            "  toplevels - list app_ids and titles of all the toplevels\n"
+            "  subscribe [event...] - receive events from the compositor, all of them if none are given\n"
+            "    events are active-workspace, active-toplevel, toplevel-map, toplevel-unmap,\n"
+            "    toplevel-title, toplevel-app-id, toplevel-workspace, toplevel-floating,\n"
+            "    toplevel-fullscreen, toplevel-geometry, output-add, output-remove and config-reload\n"
+            "  version - show the version of the ipc protocol\n"
+            "  toplevels - list all the toplevels\n"
             "  layers - list namespaces of all the layers\n"
-            "  outputs - list names of all the outputs\n");
+            "  outputs - list all the outputs\n"
+            "  changed-since <generation> - list outputs, workspaces and toplevels changed after\n"
+            "    the generation, and what was removed; 0 lists everything\n"
+            "  shm - map the state the compositor shares and print it\n"
+            "  stats - show how many events were coalesced or dropped, per client\n"
+            "  latency - show input to photon latency histograms of all the outputs\n"
+            "  frame-times [reset] - show how long drawing frames takes on all the outputs,\n"
+            "    reset starts a new window for window_max_usec\n"
+            "  save-layout - save the current layout, it is restored on the next start\n"
+            "  master-count [+|-]<n> - set or change the master count of the active workspace\n"
+            "  master-ratio [+|-]<ratio> - set or change the master ratio of the active workspace\n"
+            "  focus <id> - focus the toplevel with the id, switching to its workspace\n"
+            "  exit - stop the compositor\n"
+            "with -b, messages are read from stdin, one per line, and all sent over one connection\n"
+            "replies and events are printed as json, one per line\n");
     return 0;
   }
 
-  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
-  if(fd == -1) {
-    perror("socket");
+  struct mwc_ipc_connection *connection = mwc_ipc_connect(NULL);
+  if(connection == NULL) {
+    perror("connect");
     return 1;
   }
 
-  struct sockaddr_un address = {0};
-  address.sun_family = AF_UNIX;
-  strcpy(address.sun_path, IPC_PATH);
+  if(strcmp(argv[1], "-b") == 0) {
+    int result = run_batch(connection);
+    mwc_ipc_disconnect(connection);
+    return result;
+  }
 
-  if(connect(fd, (struct sockaddr *)&address, sizeof(address)) == -1) {
-    perror("connect");
-    close(fd);
+  /* arguments of the request are sent together with it, separated by spaces */
+  char request[IPC_MAX_REQUEST_LENGTH + 1] = {0};
+  for(int i = 1; i < argc; i++) {
+    if(i > 1) {
+      strncat(request, " ", sizeof(request) - strlen(request) - 1);
+    }
+    strncat(request, argv[i], sizeof(request) - strlen(request) - 1);
+  }
+
+  uint32_t id = mwc_ipc_send(connection, request, IPC_ENCODING_JSON);
+  if(id == 0) {
+    fprintf(stderr, "failed to write the message, is the server running?\n");
+    mwc_ipc_disconnect(connection);
     return 1;
   }
 
-  if(strcmp(argv[1], "subscribe") == 0) {
-    ipc_subscribe(fd);
-  } else {
-    ipc_simple(fd, argv[1]);
+  int type = -1;
+  struct mwc_ipc_message message;
+  while(mwc_ipc_wait_message(connection, &message)) {
+    print_message(&message);
+
+    if(message.fd != -1) {
+      if(strcmp(argv[1], "shm") == 0 && !print_shm_state(message.fd)) {
+        message.type = IPC_MESSAGE_ERROR;
+      }
+      close(message.fd);
+    }
+
+    if(message.id == id && message.type != IPC_MESSAGE_EVENT) {
+      type = message.type;
+      /* after the reply to subscribe, events keep coming until one of us quits */
+      if(type != IPC_MESSAGE_REPLY || strcmp(argv[1], "subscribe") != 0) break;
+    }
   }
 
-  close(fd);
+  mwc_ipc_disconnect(connection);
 
-  return 0;
+  return type == IPC_MESSAGE_REPLY ? 0 : 1;
 }
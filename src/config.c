@@ -12,6 +12,7 @@
 #include "workspace.h"
 #include "toplevel.h"
 #include "layout.h"
+#include "ipc.h"
 
 #include <sys/inotify.h>
 #include <assert.h>
@@ -27,7 +28,6 @@
 #include <wlr/types/wlr_xcursor_manager.h>
 #include <wlr/util/log.h>
 
-#define clamp(v, a, b) (max((a), min((v), (b))))
 
 /* assumes valid hex */
 uint32_t
@@ -452,6 +452,27 @@ config_add_keybind(struct mwc_config *c, char *modifiers, char *key,
     k->action = keybind_focused_toplevel_toggle_fullscreen;
   } else if(strcmp(action, "reload_config") == 0) {
     k->action = keybind_reload_config;
+  } else if(strcmp(action, "toggle_layout") == 0) {
+    k->action = keybind_toggle_layout;
+  } else if(strcmp(action, "increase_master_count") == 0) {
+    k->action = keybind_adjust_master_count;
+    k->args = (void*)1;
+  } else if(strcmp(action, "decrease_master_count") == 0) {
+    k->action = keybind_adjust_master_count;
+    k->args = (void*)-1;
+  } else if(strcmp(action, "increase_master_ratio") == 0
+            || strcmp(action, "decrease_master_ratio") == 0) {
+    double step = arg_count > 0 ? atof(args[0]) : MASTER_RATIO_STEP;
+    if(step <= 0 || step >= 1) {
+      wlr_log(WLR_ERROR, "invalid args to %s", action);
+      free(k);
+      return false;
+    }
+
+    k->action = keybind_adjust_master_ratio;
+    double *delta = malloc(sizeof(*delta));
+    *delta = strcmp(action, "increase_master_ratio") == 0 ? step : -step;
+    k->args = delta;
   } else {
     wlr_log(WLR_ERROR, "invalid keybind action %s", action);
     free(k);
@@ -489,6 +510,10 @@ config_handle_value(struct mwc_config *c, char *keyword, char **args, size_t arg
     if(arg_count < 1) goto invalid;
 
     c->keyboard_delay = clamp(atoi(args[0]), 0, INT_MAX);
+  } else if(strcmp(keyword, "pointer_focus_rate") == 0) {
+    if(arg_count < 1) goto invalid;
+
+    c->pointer_focus_rate = clamp(atoi(args[0]), 0, 1000);
   } else if(strcmp(keyword, "pointer_sensitivity") == 0) {
     if(arg_count < 1) goto invalid;
 
@@ -549,6 +574,10 @@ config_handle_value(struct mwc_config *c, char *keyword, char **args, size_t arg
     } else {
       goto invalid;
     }
+  } else if(strcmp(keyword, "trackpad_swipe_fingers") == 0) {
+    if(arg_count < 1) goto invalid;
+
+    c->trackpad_swipe_fingers = clamp(atoi(args[0]), 0, 5);
   } else if(strcmp(keyword, "border_width") == 0) {
     if(arg_count < 1) goto invalid;
 
@@ -569,6 +598,10 @@ config_handle_value(struct mwc_config *c, char *keyword, char **args, size_t arg
     if(arg_count < 1) goto invalid;
 
     c->master_count = clamp(atoi(args[0]), 1, INT_MAX);
+  } else if(strcmp(keyword, "scrolling_column_ratio") == 0) {
+    if(arg_count < 1) goto invalid;
+
+    c->scrolling_column_ratio = clamp(atof(args[0]), 0.1, 1);
   } else if(strcmp(keyword, "cursor_theme") == 0) {
     if(arg_count < 1) goto invalid;
 
@@ -604,10 +637,21 @@ config_handle_value(struct mwc_config *c, char *keyword, char **args, size_t arg
   } else if(strcmp(keyword, "workspace") == 0) {
     if(arg_count < 2) goto invalid;
 
+    /* layout is optional, defaults to master */
+    enum mwc_layout_type layout = MWC_LAYOUT_MASTER;
+    if(arg_count > 2) {
+      if(strcmp(args[2], "scrolling") == 0) {
+        layout = MWC_LAYOUT_SCROLLING;
+      } else if(strcmp(args[2], "master") != 0) {
+        goto invalid;
+      }
+    }
+
     struct workspace_config *w = calloc(1, sizeof(*w));
     *w = (struct workspace_config){
       .index = atoi(args[0]),
       .output = strdup(args[1]),
+      .layout = layout,
     };
 
     wl_list_insert(&c->workspaces, &w->link);
@@ -651,6 +695,26 @@ config_handle_value(struct mwc_config *c, char *keyword, char **args, size_t arg
   } else if(strcmp(keyword, "placeholder_color") == 0) {
     wlr_log(WLR_ERROR, "placeholder_color has been depricated, and should not be used anymore");
     goto depricated;
+  } else if(strcmp(keyword, "ipc_buffer_size") == 0) {
+    if(arg_count < 1) goto invalid;
+
+    c->ipc_buffer_size = clamp(atoi(args[0]), 1024, INT_MAX);
+  } else if(strcmp(keyword, "ipc_coalesce_ms") == 0) {
+    if(arg_count < 1) goto invalid;
+
+    c->ipc_coalesce_ms = clamp(atoi(args[0]), 0, 1000);
+  } else if(strcmp(keyword, "ipc_backpressure") == 0) {
+    if(arg_count < 1) goto invalid;
+
+    if(strcmp(args[0], "coalesce") == 0) {
+      c->ipc_backpressure = MWC_IPC_COALESCE;
+    } else if(strcmp(args[0], "drop_oldest") == 0) {
+      c->ipc_backpressure = MWC_IPC_DROP_OLDEST;
+    } else if(strcmp(args[0], "disconnect") == 0) {
+      c->ipc_backpressure = MWC_IPC_DISCONNECT;
+    } else {
+      goto invalid;
+    }
   } else if(strcmp(keyword, "client_side_decorations") == 0) {
     if(arg_count < 1) goto invalid;
 
@@ -955,6 +1019,16 @@ config_set_default_needed_params(struct mwc_config *c) {
     wlr_log(WLR_INFO,
             "master_ratio not specified. using default %lf", c->master_ratio);
   }
+  if(c->ipc_buffer_size == 0) {
+    c->ipc_buffer_size = 65536;
+    wlr_log(WLR_INFO,
+            "ipc_buffer_size not specified. using default %u", c->ipc_buffer_size);
+  }
+  if(c->scrolling_column_ratio == 0) {
+    c->scrolling_column_ratio = 0.5;
+    wlr_log(WLR_INFO,
+            "scrolling_column_ratio not specified. using default %lf", c->scrolling_column_ratio);
+  }
   if(c->animations && c->animation_duration == 0) {
     c->animation_duration = 500;
     wlr_log(WLR_INFO,
@@ -1047,6 +1121,9 @@ config_load() {
   fclose(config_file);
   config_set_default_needed_params(c);
 
+  keybind_table_init(&c->keybind_table, &c->keybinds);
+  keybind_table_init(&c->pointer_keybind_table, &c->pointer_keybinds);
+
   return c;
 }
 
@@ -1062,14 +1139,20 @@ config_destroy(struct mwc_config *c) {
     free(o);
   }
 
+  keybind_table_finish(&c->keybind_table);
+  keybind_table_finish(&c->pointer_keybind_table);
+
   struct keybind *k, *k_temp;
   wl_list_for_each_safe(k, k_temp, &c->keybinds, link) {
-    if(k->action == keybind_run) {
+    if(k->action == keybind_run || k->action == keybind_adjust_master_ratio) {
       free(k->args);
     }
     free(k);
   }
   wl_list_for_each_safe(k, k_temp, &c->pointer_keybinds, link) {
+    if(k->action == keybind_run || k->action == keybind_adjust_master_ratio) {
+      free(k->args);
+    }
     free(k);
   }
 
@@ -1149,33 +1232,6 @@ toplevel_reapply_effects_etc(struct mwc_toplevel *toplevel) {
   }
 }
 
-void
-layout_reorganize(struct mwc_workspace *workspace) {
-  uint32_t master_count = wl_list_length(&workspace->masters);
-  
-  if(master_count > server.config->master_count) {
-    while(master_count > server.config->master_count) {
-      struct wl_list *last = workspace->masters.prev;
-      wl_list_remove(last);
-      wl_list_insert(workspace->slaves.prev, last);
-      master_count--;
-    }
-
-    return;
-  }
-
-  uint32_t slave_count = wl_list_length(&workspace->slaves);
-  if(master_count < server.config->master_count && slave_count > 0) {
-    while(master_count < server.config->master_count && slave_count > 0) {
-      struct wl_list *last = workspace->slaves.prev;
-      wl_list_remove(last);
-      wl_list_insert(workspace->masters.prev, last);
-      master_count++;
-      slave_count--;
-    }
-  }
-}
-
 void
 config_reload() {
   struct mwc_config *c = config_load();
@@ -1290,9 +1346,14 @@ config_reload() {
         }
       }
 
+      /* runtime changes are kept, unless the option itself was changed */
       if(c->master_count != old_config->master_count) {
+        w->master_count = c->master_count;
         layout_reorganize(w);
       }
+      if(c->master_ratio != old_config->master_ratio) {
+        w->master_ratio = c->master_ratio;
+      }
 
       struct mwc_toplevel *t;
       wl_list_for_each(t, &w->floating_toplevels, link) {
@@ -1337,7 +1398,16 @@ config_reload() {
                                                  ? WLR_SERVER_DECORATION_MANAGER_MODE_CLIENT
                                                  : WLR_SERVER_DECORATION_MANAGER_MODE_SERVER);
 
+  /* the shown image belongs to the manager, so it is forgotten together with it. the
+   * new manager can end up at the same address, which is why it is not compared */
+  bool xcursor_shown = server.cursor_image.type == MWC_CURSOR_IMAGE_XCURSOR;
+  char xcursor_name[sizeof(server.cursor_image.xcursor_name)];
+  strcpy(xcursor_name, server.cursor_image.xcursor_name);
+
   wlr_xcursor_manager_destroy(server.cursor_mgr);
+  if(xcursor_shown) {
+    server.cursor_image.type = MWC_CURSOR_IMAGE_UNKNOWN;
+  }
 
   server.cursor_mgr = wlr_xcursor_manager_create(server.config->cursor_theme,
                                                  server.config->cursor_size);
@@ -1350,7 +1420,13 @@ config_reload() {
   }
   setenv("XCURSOR_SIZE", cursor_size, true);
 
+  cursor_preload_scales();
+  if(xcursor_shown) {
+    cursor_set_xcursor(xcursor_name);
+  }
+
   config_destroy(old_config);
+  ipc_broadcast_message(IPC_CONFIG_RELOAD);
 }
 
 void
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "helpers.h"
+#include "keybinds.h"
 
 #include <scenefx/types/fx/blur_data.h>
 #include <scenefx/types/fx/corner_location.h>
@@ -14,6 +15,8 @@
 #include <wayland-server-protocol.h>
 
 #define BAKED_POINTS_COUNT 256
+/* default step of the increase/decrease_master_ratio keybinds */
+#define MASTER_RATIO_STEP 0.05
 
 struct window_rule_regex {
   bool has_app_id_regex;
@@ -64,9 +67,23 @@ struct output_config {
   double scale;
 };
 
+enum mwc_layout_type {
+  MWC_LAYOUT_MASTER,
+  MWC_LAYOUT_SCROLLING,
+};
+
+/* what happens when a subscriber does not read events fast enough */
+enum mwc_ipc_backpressure {
+  /* queued events are replaced with the current state */
+  MWC_IPC_COALESCE,
+  MWC_IPC_DROP_OLDEST,
+  MWC_IPC_DISCONNECT,
+};
+
 struct workspace_config {
   uint32_t index;
   char *output;
+  enum mwc_layout_type layout;
   struct wl_list link;
 };
 
@@ -91,6 +108,9 @@ struct mwc_config {
   struct wl_list outputs;
   struct wl_list keybinds;
   struct wl_list pointer_keybinds;
+  /* built from the lists above once the whole config is loaded */
+  struct keybind_table keybind_table;
+  struct keybind_table pointer_keybind_table;
   struct wl_list workspaces;
   struct {
     struct wl_list floating;
@@ -114,12 +134,16 @@ struct mwc_config {
   bool pointer_acceleration;
   struct wl_list pointers;
   bool pointer_left_handed;
+  /* how many times per second pointer focus is updated; 0 means once per output frame */
+  uint32_t pointer_focus_rate;
 
   /* trackpad stuff */
   bool trackpad_disable_while_typing;
   bool trackpad_natural_scroll;
   bool trackpad_tap_to_click;
   enum libinput_config_scroll_method trackpad_scroll_method;
+  /* how many fingers swipe between workspaces; 0 disables it */
+  uint32_t trackpad_swipe_fingers;
 
   /* cursor theme and size */
   char *cursor_theme;
@@ -152,6 +176,8 @@ struct mwc_config {
 
   uint32_t master_count;
   double master_ratio;
+  /* width of a column in the scrolling layout, relative to the usable area */
+  double scrolling_column_ratio;
   bool client_side_decorations;
 
   /* animations stuff */
@@ -160,6 +186,13 @@ struct mwc_config {
   double animation_curve[4];
   struct vec2 *baked_points;
 
+  /* ipc stuff */
+  uint32_t ipc_buffer_size;
+  enum mwc_ipc_backpressure ipc_backpressure;
+  /* events about the same thing within this window are sent once; 0 means
+   * once per event loop iteration */
+  uint32_t ipc_coalesce_ms;
+
   /* run on startup */
   char *run[64];
   size_t run_count;
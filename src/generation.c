@@ -0,0 +1,65 @@
+#include "generation.h"
+
+#include "mwc.h"
+#include "output.h"
+#include "toplevel.h"
+#include "workspace.h"
+
+#include <string.h>
+#include <wlr/types/wlr_output.h>
+
+extern struct mwc_server server;
+
+void
+generation_toplevel_changed(struct mwc_toplevel *toplevel) {
+  toplevel->generation = ++server.generations.current;
+  shm_state_schedule();
+}
+
+void
+generation_workspace_changed(struct mwc_workspace *workspace) {
+  workspace->generation = ++server.generations.current;
+  shm_state_schedule();
+}
+
+void
+generation_output_changed(struct mwc_output *output) {
+  output->generation = ++server.generations.current;
+  shm_state_schedule();
+}
+
+struct mwc_removed *
+generation_add_removed(enum mwc_removed_type type) {
+  struct mwc_generations *g = &server.generations;
+  struct mwc_removed *removed = &g->removed[g->removed_next];
+  g->removed_next = (g->removed_next + 1) % GENERATION_REMOVED_COUNT;
+
+  /* the slot is reused, so whatever it had is forgotten */
+  if(removed->generation > g->forgotten) {
+    g->forgotten = removed->generation;
+  }
+
+  *removed = (struct mwc_removed){
+    .type = type,
+    .generation = ++g->current,
+  };
+  shm_state_schedule();
+  return removed;
+}
+
+void
+generation_toplevel_removed(struct mwc_toplevel *toplevel) {
+  struct mwc_removed *removed = generation_add_removed(MWC_REMOVED_TOPLEVEL);
+  removed->toplevel_id = toplevel->id;
+}
+
+void
+generation_output_removed(struct mwc_output *output) {
+  struct mwc_removed *removed = generation_add_removed(MWC_REMOVED_OUTPUT);
+  strncpy(removed->output_name, output->wlr_output->name, GENERATION_NAME_LENGTH - 1);
+}
+
+bool
+generation_removals_known(uint64_t since) {
+  return since >= server.generations.forgotten;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* how many removed toplevels and outputs are remembered, for clients asking
+ * what changed since some generation */
+#define GENERATION_REMOVED_COUNT 256
+#define GENERATION_NAME_LENGTH 32
+
+struct mwc_output;
+struct mwc_toplevel;
+struct mwc_workspace;
+
+enum mwc_removed_type {
+  MWC_REMOVED_TOPLEVEL,
+  MWC_REMOVED_OUTPUT,
+};
+
+struct mwc_removed {
+  enum mwc_removed_type type;
+  uint64_t generation;
+  uint64_t toplevel_id;
+  char output_name[GENERATION_NAME_LENGTH];
+};
+
+/* every change to a toplevel, workspace or output takes the next generation of
+ * the server and stores it in the changed object, so anything newer than what a
+ * client has seen can be found */
+struct mwc_generations {
+  uint64_t current;
+
+  /* a ring buffer, next is where the next removal goes */
+  struct mwc_removed removed[GENERATION_REMOVED_COUNT];
+  size_t removed_next;
+  /* removals up to this generation may have been overwritten already */
+  uint64_t forgotten;
+};
+
+void
+generation_toplevel_changed(struct mwc_toplevel *toplevel);
+
+void
+generation_workspace_changed(struct mwc_workspace *workspace);
+
+void
+generation_output_changed(struct mwc_output *output);
+
+void
+generation_toplevel_removed(struct mwc_toplevel *toplevel);
+
+void
+generation_output_removed(struct mwc_output *output);
+
+/* if false, some removals after since are not known anymore and the client
+ * has to get everything again */
+bool
+generation_removals_known(uint64_t since);
@@ -0,0 +1,194 @@
+#include "gesture.h"
+
+#include "mwc.h"
+#include "config.h"
+#include "output.h"
+#include "replay.h"
+#include "workspace.h"
+
+#include <math.h>
+#include <wayland-util.h>
+#include <wlr/types/wlr_output_layout.h>
+#include <wlr/types/wlr_pointer.h>
+
+extern struct mwc_server server;
+
+int32_t
+swipe_output_width(void) {
+  struct wlr_box box;
+  wlr_output_layout_get_box(server.output_layout, server.swipe.output->wlr_output, &box);
+  return max(box.width, 1);
+}
+
+void
+swipe_set_offset(double offset) {
+  struct mwc_swipe *swipe = &server.swipe;
+  struct mwc_workspace *from = swipe->from;
+  int32_t width = swipe_output_width();
+
+  /* moving the fingers to the left brings in the next workspace from the right */
+  struct mwc_workspace *to = NULL;
+  if(offset != 0) {
+    struct wl_list *link = offset < 0 ? from->link.next : from->link.prev;
+    if(link != &swipe->output->workspaces) {
+      to = wl_container_of(link, to, link);
+    }
+  }
+
+  /* there is nothing in that direction, so nothing moves */
+  if(to == NULL) {
+    offset = 0;
+  }
+  offset = clamp(offset, -width, width);
+
+  if(to != swipe->to) {
+    if(swipe->to != NULL) {
+      swipe->to->offset_x = 0;
+      workspace_set_toplevels_enabled(swipe->to, false);
+    }
+    if(to != NULL) {
+      workspace_set_toplevels_enabled(to, true);
+    }
+    swipe->to = to;
+  }
+
+  swipe->offset = offset;
+  from->offset_x = round(offset);
+  if(to != NULL) {
+    to->offset_x = round(offset < 0 ? offset + width : offset - width);
+  }
+
+  /* toplevels are moving under the pointer */
+  server.scene_generation++;
+  wlr_output_schedule_frame(swipe->output->wlr_output);
+}
+
+void
+server_handle_cursor_swipe_begin(struct wl_listener *listener, void *data) {
+  struct wlr_pointer_swipe_begin_event *event = data;
+  struct mwc_swipe *swipe = &server.swipe;
+
+  record_event(MWC_RECORD_SWIPE_BEGIN, event->time_msec, &(struct mwc_record_swipe){
+    .fingers = event->fingers,
+  }, sizeof(struct mwc_record_swipe));
+
+  if(server.config->trackpad_swipe_fingers == 0
+     || event->fingers != server.config->trackpad_swipe_fingers
+     || server.cursor_mode != MWC_CURSOR_PASSTHROUGH
+     || server.lock != NULL) {
+    return;
+  }
+
+  swipe->active = true;
+  swipe->velocity = 0;
+  swipe->last_time = event->time_msec;
+
+  /* fingers put down during the animation catch the workspaces where they are */
+  if(swipe->animating) {
+    swipe->animating = false;
+    return;
+  }
+
+  swipe->output = server.active_workspace->output;
+  swipe->from = swipe->output->active_workspace;
+  swipe->to = NULL;
+  swipe->offset = 0;
+}
+
+void
+server_handle_cursor_swipe_update(struct wl_listener *listener, void *data) {
+  struct wlr_pointer_swipe_update_event *event = data;
+  struct mwc_swipe *swipe = &server.swipe;
+
+  record_event(MWC_RECORD_SWIPE_UPDATE, event->time_msec, &(struct mwc_record_swipe){
+    .fingers = event->fingers, .dx = event->dx, .dy = event->dy,
+  }, sizeof(struct mwc_record_swipe));
+
+  if(!swipe->active) return;
+
+  uint32_t dt = event->time_msec - swipe->last_time;
+  if(dt > 0) {
+    swipe->velocity = event->dx / dt;
+    swipe->last_time = event->time_msec;
+  }
+
+  swipe_set_offset(swipe->offset + event->dx);
+}
+
+void
+server_handle_cursor_swipe_end(struct wl_listener *listener, void *data) {
+  struct wlr_pointer_swipe_end_event *event = data;
+  struct mwc_swipe *swipe = &server.swipe;
+
+  record_event(MWC_RECORD_SWIPE_END, event->time_msec, &(struct mwc_record_swipe){
+    .cancelled = event->cancelled,
+  }, sizeof(struct mwc_record_swipe));
+
+  if(!swipe->active) return;
+  swipe->active = false;
+
+  int32_t width = swipe_output_width();
+
+  /* a flick decides by its direction, a slow release by how far it got */
+  bool switch_workspace;
+  if(event->cancelled || swipe->to == NULL) {
+    switch_workspace = false;
+  } else if(fabs(swipe->velocity) > SWIPE_FLICK_VELOCITY) {
+    switch_workspace = swipe->velocity * swipe->offset > 0;
+  } else {
+    switch_workspace = fabs(swipe->offset) > width / 2.0;
+  }
+
+  swipe->target = switch_workspace ? copysign(width, swipe->offset) : 0;
+  swipe->animating = true;
+  wlr_output_schedule_frame(swipe->output->wlr_output);
+}
+
+void
+swipe_animation_tick(struct mwc_output *output) {
+  struct mwc_swipe *swipe = &server.swipe;
+  if(!swipe->animating || swipe->output != output) return;
+
+  if(!server.config->animations) {
+    swipe_finish();
+    return;
+  }
+
+  /* keep the speed the fingers had, but never take longer than an animation */
+  double speed = max(fabs(swipe->velocity),
+                     (double)swipe_output_width() / max(server.config->animation_duration, 1));
+  double step = speed * output_frame_duration_ms(output);
+  double remaining = swipe->target - swipe->offset;
+
+  if(fabs(remaining) <= step) {
+    swipe_finish();
+  } else {
+    swipe_set_offset(swipe->offset + copysign(step, remaining));
+  }
+}
+
+void
+swipe_finish(void) {
+  struct mwc_swipe *swipe = &server.swipe;
+  if(swipe->output == NULL) return;
+
+  struct mwc_workspace *to = swipe->to;
+  bool switch_workspace = to != NULL && swipe->target != 0;
+
+  swipe->from->offset_x = 0;
+  if(to != NULL) {
+    to->offset_x = 0;
+  }
+
+  struct mwc_output *output = swipe->output;
+  *swipe = (struct mwc_swipe){0};
+
+  if(switch_workspace) {
+    change_workspace(to, false);
+  } else if(to != NULL) {
+    workspace_set_toplevels_enabled(to, false);
+  }
+
+  server.scene_generation++;
+  wlr_output_schedule_frame(output->wlr_output);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <wayland-server-core.h>
+
+/* below this speed in pixels per millisecond lifting the fingers is not a flick,
+ * so the swipe finishes based on how far it got */
+#define SWIPE_FLICK_VELOCITY 0.5
+
+struct mwc_output;
+struct mwc_workspace;
+
+struct mwc_swipe {
+  /* fingers are on the trackpad */
+  bool active;
+  /* fingers are lifted and the workspaces are moving to their final place */
+  bool animating;
+
+  struct mwc_output *output;
+  struct mwc_workspace *from;
+  /* the neighbour of from that is being swiped into view, if any */
+  struct mwc_workspace *to;
+
+  /* horizontal offset of from, in layout pixels */
+  double offset;
+  double target;
+  /* pixels per millisecond of the last update */
+  double velocity;
+  uint32_t last_time;
+};
+
+void
+server_handle_cursor_swipe_begin(struct wl_listener *listener, void *data);
+
+void
+server_handle_cursor_swipe_update(struct wl_listener *listener, void *data);
+
+void
+server_handle_cursor_swipe_end(struct wl_listener *listener, void *data);
+
+/* moves the workspaces towards their final place after the fingers are lifted */
+void
+swipe_animation_tick(struct mwc_output *output);
+
+/* stops the swipe and switches to the target workspace if it got there */
+void
+swipe_finish(void);
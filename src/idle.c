@@ -0,0 +1,102 @@
+#include "idle.h"
+
+#include "mwc.h"
+#include "output.h"
+#include "something.h"
+#include "toplevel.h"
+#include "workspace.h"
+
+#include <stdlib.h>
+#include <wayland-util.h>
+#include <wlr/types/wlr_content_type_v1.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_xdg_shell.h>
+#include <wlr/util/log.h>
+
+extern struct mwc_server server;
+
+void
+idle_notify_activity(void) {
+  wlr_idle_notifier_v1_notify_activity(server.idle_notifier, server.seat);
+}
+
+void
+idle_update_inhibited(void) {
+  bool inhibited = false;
+
+  /* an inhibitor only counts while its surface is visible */
+  struct mwc_idle_inhibitor *inhibitor;
+  wl_list_for_each(inhibitor, &server.idle_inhibitors, link) {
+    if(surface_is_visible(inhibitor->wlr_inhibitor->surface)) {
+      inhibited = true;
+      break;
+    }
+  }
+
+  /* players often do not ask for it, but they do say that they show a video. a fullscreen
+   * terminal or game menu does not keep the screens on */
+  struct mwc_output *output;
+  wl_list_for_each(output, &server.outputs, link) {
+    if(inhibited) break;
+    if(output->active_workspace == NULL
+       || output->active_workspace->fullscreen_toplevel == NULL) continue;
+
+    struct wlr_surface *surface =
+      output->active_workspace->fullscreen_toplevel->xdg_toplevel->base->surface;
+    if(wlr_surface_get_content_type_v1(server.content_type_manager, surface)
+       == WP_CONTENT_TYPE_V1_TYPE_VIDEO) {
+      inhibited = true;
+    }
+  }
+
+  wlr_idle_notifier_v1_set_inhibited(server.idle_notifier, inhibited);
+}
+
+void
+server_handle_new_idle_inhibitor(struct wl_listener *listener, void *data) {
+  struct wlr_idle_inhibitor_v1 *wlr_inhibitor = data;
+
+  struct mwc_idle_inhibitor *inhibitor = calloc(1, sizeof(*inhibitor));
+  inhibitor->wlr_inhibitor = wlr_inhibitor;
+
+  inhibitor->destroy.notify = idle_inhibitor_handle_destroy;
+  wl_signal_add(&wlr_inhibitor->events.destroy, &inhibitor->destroy);
+
+  wl_list_insert(&server.idle_inhibitors, &inhibitor->link);
+  idle_update_inhibited();
+}
+
+void
+idle_inhibitor_handle_destroy(struct wl_listener *listener, void *data) {
+  struct mwc_idle_inhibitor *inhibitor = wl_container_of(listener, inhibitor, destroy);
+
+  wl_list_remove(&inhibitor->destroy.link);
+  wl_list_remove(&inhibitor->link);
+  free(inhibitor);
+
+  idle_update_inhibited();
+}
+
+void
+output_power_manager_handle_set_mode(struct wl_listener *listener, void *data) {
+  struct wlr_output_power_v1_set_mode_event *event = data;
+  bool enabled = event->mode == ZWLR_OUTPUT_POWER_V1_MODE_ON;
+
+  if(event->output->enabled == enabled) return;
+
+  struct wlr_output_state state;
+  wlr_output_state_init(&state);
+  wlr_output_state_set_enabled(&state, enabled);
+
+  if(!wlr_output_commit_state(event->output, &state)) {
+    wlr_log(WLR_ERROR, "failed to turn output '%s' %s",
+            event->output->name, enabled ? "on" : "off");
+  }
+
+  wlr_output_state_finish(&state);
+
+  /* nothing was drawn while it was off */
+  if(enabled) {
+    wlr_output_schedule_frame(event->output);
+  }
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <wayland-server-core.h>
+#include <wlr/types/wlr_idle_inhibit_v1.h>
+#include <wlr/types/wlr_idle_notify_v1.h>
+#include <wlr/types/wlr_output_power_management_v1.h>
+
+struct mwc_idle_inhibitor {
+  struct wlr_idle_inhibitor_v1 *wlr_inhibitor;
+  struct wl_list link;
+
+  struct wl_listener destroy;
+};
+
+/* called on every input event, restarts the idle timers of clients */
+void
+idle_notify_activity(void);
+
+/* idle is inhibited while an inhibitor is on a visible surface, or a fullscreen toplevel
+ * on some output shows a video (content type); call this when any of those changes */
+void
+idle_update_inhibited(void);
+
+void
+server_handle_new_idle_inhibitor(struct wl_listener *listener, void *data);
+
+void
+idle_inhibitor_handle_destroy(struct wl_listener *listener, void *data);
+
+void
+output_power_manager_handle_set_mode(struct wl_listener *listener, void *data);
@@ -1,335 +1,1413 @@
 #include "ipc.h"
 
 #include "mwc.h"
-#include "array.h"
 #include "output.h"
+#include "toplevel.h"
 #include "workspace.h"
 #include "layer_surface.h"
+#include "layout.h"
+#include "snapshot.h"
+#include "config.h"
+#include "shm_state.h"
+#include "keybinds.h"
 
 #include <stdio.h>
-#include <signal.h>
+#include <errno.h>
+#include <inttypes.h>
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/un.h>
+#include <time.h>
 #include <unistd.h>
 #include <stdbool.h>
 #include <wayland-util.h>
+#include <wlr/types/wlr_output_layout.h>
 #include <wlr/util/log.h>
 
 extern struct mwc_server server;
 
+char *ipc_error_names[] = {
+  [IPC_ERROR_INVALID_REQUEST] = "invalid-request",
+  [IPC_ERROR_INVALID_ARGUMENT] = "invalid-argument",
+  [IPC_ERROR_UNSUPPORTED_VERSION] = "unsupported-version",
+  [IPC_ERROR_UNSUPPORTED_ENCODING] = "unsupported-encoding",
+  [IPC_ERROR_TOO_LONG] = "too-long",
+  [IPC_ERROR_INTERNAL] = "internal",
+};
+
+/* also what clients pass to subscribe */
+char *ipc_event_names[] = {
+  [IPC_ACTIVE_WORKSPACE] = "active-workspace",
+  [IPC_ACTIVE_TOPLEVEL] = "active-toplevel",
+  [IPC_TOPLEVEL_MAP] = "toplevel-map",
+  [IPC_TOPLEVEL_UNMAP] = "toplevel-unmap",
+  [IPC_TOPLEVEL_TITLE] = "toplevel-title",
+  [IPC_TOPLEVEL_APP_ID] = "toplevel-app-id",
+  [IPC_TOPLEVEL_WORKSPACE] = "toplevel-workspace",
+  [IPC_TOPLEVEL_FLOATING] = "toplevel-floating",
+  [IPC_TOPLEVEL_FULLSCREEN] = "toplevel-fullscreen",
+  [IPC_TOPLEVEL_GEOMETRY] = "toplevel-geometry",
+  [IPC_OUTPUT_ADD] = "output-add",
+  [IPC_OUTPUT_REMOVE] = "output-remove",
+  [IPC_CONFIG_RELOAD] = "config-reload",
+};
+
+/* writes the keys describing a toplevel into an object that is already open */
+void
+ipc_write_toplevel(struct ipc_writer *writer, struct mwc_toplevel *toplevel) {
+  ipc_writer_key(writer, "id");
+  ipc_writer_int(writer, toplevel->id);
+  ipc_writer_key(writer, "generation");
+  ipc_writer_int(writer, toplevel->generation);
+  ipc_writer_key(writer, "app_id");
+  ipc_writer_string(writer, toplevel->xdg_toplevel->app_id);
+  ipc_writer_key(writer, "title");
+  ipc_writer_string(writer, toplevel->xdg_toplevel->title);
+  ipc_writer_key(writer, "workspace");
+  ipc_writer_int(writer, toplevel->workspace->index);
+  ipc_writer_key(writer, "output");
+  ipc_writer_string(writer, toplevel->workspace->output->wlr_output->name);
+  ipc_writer_key(writer, "floating");
+  ipc_writer_bool(writer, toplevel->floating);
+  ipc_writer_key(writer, "fullscreen");
+  ipc_writer_bool(writer, toplevel->fullscreen);
+  ipc_writer_key(writer, "x");
+  ipc_writer_int(writer, toplevel->current.x);
+  ipc_writer_key(writer, "y");
+  ipc_writer_int(writer, toplevel->current.y);
+  ipc_writer_key(writer, "width");
+  ipc_writer_int(writer, toplevel->current.width);
+  ipc_writer_key(writer, "height");
+  ipc_writer_int(writer, toplevel->current.height);
+}
+
+void
+ipc_write_output(struct ipc_writer *writer, struct mwc_output *output) {
+  struct wlr_box box;
+  wlr_output_layout_get_box(server.output_layout, output->wlr_output, &box);
+
+  ipc_writer_key(writer, "name");
+  ipc_writer_string(writer, output->wlr_output->name);
+  ipc_writer_key(writer, "generation");
+  ipc_writer_int(writer, output->generation);
+  ipc_writer_key(writer, "active_workspace");
+  ipc_writer_int(writer, output->active_workspace->index);
+  ipc_writer_key(writer, "x");
+  ipc_writer_int(writer, box.x);
+  ipc_writer_key(writer, "y");
+  ipc_writer_int(writer, box.y);
+  ipc_writer_key(writer, "width");
+  ipc_writer_int(writer, box.width);
+  ipc_writer_key(writer, "height");
+  ipc_writer_int(writer, box.height);
+  ipc_writer_key(writer, "scale");
+  ipc_writer_double(writer, output->wlr_output->scale);
+}
+
 void
-sigpipe_handler(int signum) {
-  /* do nothing */
+ipc_write_workspace(struct ipc_writer *writer, struct mwc_workspace *workspace) {
+  ipc_writer_key(writer, "index");
+  ipc_writer_int(writer, workspace->index);
+  ipc_writer_key(writer, "generation");
+  ipc_writer_int(writer, workspace->generation);
+  ipc_writer_key(writer, "output");
+  ipc_writer_string(writer, workspace->output->wlr_output->name);
+  ipc_writer_key(writer, "layout");
+  ipc_writer_string(writer, workspace->layout == MWC_LAYOUT_SCROLLING ? "scrolling" : "master");
+  ipc_writer_key(writer, "master_count");
+  ipc_writer_int(writer, workspace->master_count);
+  ipc_writer_key(writer, "master_ratio");
+  ipc_writer_double(writer, workspace->master_ratio);
+  ipc_writer_key(writer, "toplevels");
+  ipc_writer_int(writer, wl_list_length(&workspace->floating_toplevels)
+                 + wl_list_length(&workspace->masters) + wl_list_length(&workspace->slaves));
+  ipc_writer_key(writer, "fullscreen");
+  if(workspace->fullscreen_toplevel == NULL) {
+    ipc_writer_null(writer);
+  } else {
+    ipc_writer_int(writer, workspace->fullscreen_toplevel->id);
+  }
+}
+
+uint64_t
+ipc_now_usec(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
 }
 
+/* object is the toplevel or the output the event is about, if it is about one.
+ * time_usec is when the change happened, so clients can tell how long it took to reach
+ * them. it is the first key, so ipc_message_time_usec() can read it back */
 void
-ipc_create_message(enum ipc_event event, char *buffer, uint32_t length) {
+ipc_create_message(enum ipc_event event, void *object, uint64_t time_usec,
+                   struct ipc_writer *writer) {
+  ipc_writer_object_begin(writer);
+  ipc_writer_key(writer, "time_usec");
+  ipc_writer_int(writer, time_usec);
+  ipc_writer_key(writer, "event");
+  ipc_writer_string(writer, ipc_event_names[event]);
+
   switch(event) {
     case IPC_ACTIVE_WORKSPACE: {
-      snprintf(buffer, length, "active-workspace" SEPARATOR "%u" SEPARATOR "%s" SEPARATOR "\n",
-               server.active_workspace->index, server.active_workspace->output->wlr_output->name);
+      ipc_writer_key(writer, "workspace");
+      ipc_writer_int(writer, server.active_workspace->index);
+      ipc_writer_key(writer, "output");
+      ipc_writer_string(writer, server.active_workspace->output->wlr_output->name);
       break;
     }
     case IPC_ACTIVE_TOPLEVEL: {
-      if(server.focused_toplevel == NULL) {
-        snprintf(buffer, length,
-                 "active-toplevel" SEPARATOR "" SEPARATOR "" SEPARATOR "\n");
+      struct mwc_toplevel *toplevel = server.focused_toplevel;
+      ipc_writer_key(writer, "id");
+      if(toplevel == NULL) {
+        ipc_writer_null(writer);
       } else {
-        snprintf(buffer, length,
-                 "active-toplevel" SEPARATOR "%s" SEPARATOR "%s" SEPARATOR "\n",
-                 server.focused_toplevel->xdg_toplevel->app_id,
-                 server.focused_toplevel->xdg_toplevel->title);
+        ipc_writer_int(writer, toplevel->id);
       }
+      ipc_writer_key(writer, "app_id");
+      ipc_writer_string(writer, toplevel == NULL ? NULL : toplevel->xdg_toplevel->app_id);
+      ipc_writer_key(writer, "title");
+      ipc_writer_string(writer, toplevel == NULL ? NULL : toplevel->xdg_toplevel->title);
+      break;
+    }
+    case IPC_TOPLEVEL_MAP:
+    case IPC_TOPLEVEL_UNMAP:
+    case IPC_TOPLEVEL_TITLE:
+    case IPC_TOPLEVEL_APP_ID:
+    case IPC_TOPLEVEL_WORKSPACE:
+    case IPC_TOPLEVEL_FLOATING:
+    case IPC_TOPLEVEL_FULLSCREEN:
+    case IPC_TOPLEVEL_GEOMETRY: {
+      ipc_write_toplevel(writer, object);
+      break;
+    }
+    case IPC_OUTPUT_ADD:
+    case IPC_OUTPUT_REMOVE: {
+      ipc_write_output(writer, object);
+      break;
+    }
+    case IPC_CONFIG_RELOAD: {
       break;
     }
     case IPC_EVENT_COUNT: {
       assert(false && "you should not have done this");
     }
   }
+  ipc_writer_object_end(writer);
+}
+
+void
+ipc_broadcast(enum ipc_event event, void *object, uint64_t time_usec) {
+  if(!server.ipc_running) return;
+
+  /* the event is serialized at most once per encoding, and only if someone wants it */
+  bool created[IPC_ENCODING_COUNT] = {0};
+
+  struct mwc_ipc_subscription *subscription, *tmp;
+  wl_list_for_each_safe(subscription, tmp, &server.ipc_subscribers[event], link) {
+    struct mwc_ipc_client *client = subscription->client;
+    struct ipc_writer *writer = &server.ipc_event_writers[client->encoding];
+    if(!created[client->encoding]) {
+      ipc_writer_reset(writer, client->encoding);
+      ipc_create_message(event, object, time_usec, writer);
+      created[client->encoding] = true;
+    }
+
+    ipc_client_queue_event(client, event, writer->data, writer->length);
+    ipc_client_flush(client);
+  }
+}
+
+/* these only carry the current state, so a newer one makes the older one useless */
+bool
+ipc_event_coalesces(enum ipc_event event) {
+  switch(event) {
+    case IPC_ACTIVE_WORKSPACE:
+    case IPC_ACTIVE_TOPLEVEL:
+    case IPC_TOPLEVEL_TITLE:
+    case IPC_TOPLEVEL_APP_ID:
+    case IPC_TOPLEVEL_WORKSPACE:
+    case IPC_TOPLEVEL_FLOATING:
+    case IPC_TOPLEVEL_FULLSCREEN:
+    case IPC_TOPLEVEL_GEOMETRY:
+      return true;
+    default:
+      return false;
+  }
+}
+
+void
+ipc_schedule_pending(void) {
+  if(server.ipc_pending_idle != NULL) return;
+
+  if(server.config->ipc_coalesce_ms == 0) {
+    server.ipc_pending_idle = wl_event_loop_add_idle(server.wl_event_loop,
+                                                     ipc_handle_pending_idle, NULL);
+  } else if(server.ipc_pending == 0 && wl_list_empty(&server.ipc_pending_toplevels)) {
+    /* the window starts with the first event, later ones do not push it back */
+    wl_event_source_timer_update(server.ipc_pending_timer, server.ipc_coalesce_ms);
+  }
+}
+
+void
+ipc_send_pending(void) {
+  if(server.ipc_pending == 0 && wl_list_empty(&server.ipc_pending_toplevels)) return;
+
+  if(server.ipc_pending_idle != NULL) {
+    wl_event_source_remove(server.ipc_pending_idle);
+    server.ipc_pending_idle = NULL;
+  }
+  wl_event_source_timer_update(server.ipc_pending_timer, 0);
+
+  uint32_t pending = server.ipc_pending;
+  server.ipc_pending = 0;
+  for(size_t i = 0; i < IPC_EVENT_COUNT; i++) {
+    if(pending & (1u << i)) {
+      ipc_broadcast(i, NULL, server.ipc_pending_usec);
+    }
+  }
+
+  struct mwc_toplevel *toplevel, *tmp;
+  wl_list_for_each_safe(toplevel, tmp, &server.ipc_pending_toplevels, ipc_pending_link) {
+    pending = toplevel->ipc_pending;
+    toplevel->ipc_pending = 0;
+    wl_list_remove(&toplevel->ipc_pending_link);
+
+    for(size_t i = 0; i < IPC_EVENT_COUNT; i++) {
+      if(pending & (1u << i)) {
+        ipc_broadcast(i, toplevel, toplevel->ipc_pending_usec);
+      }
+    }
+  }
+}
+
+int
+ipc_handle_pending_idle(void *data) {
+  /* idle sources are removed once they run */
+  server.ipc_pending_idle = NULL;
+  ipc_send_pending();
+  return 0;
+}
+
+int
+ipc_handle_pending_timer(void *data) {
+  ipc_send_pending();
+  return 0;
+}
+
+/* object is NULL for events about the compositor as a whole, otherwise a toplevel */
+void
+ipc_queue_or_broadcast(enum ipc_event event, struct mwc_toplevel *toplevel) {
+  if(!server.ipc_running) return;
+
+  if(!ipc_event_coalesces(event)) {
+    /* whatever waits happened before this, and may be about a toplevel that goes away now */
+    ipc_send_pending();
+    ipc_broadcast(event, toplevel, ipc_now_usec());
+    return;
+  }
+
+  if(wl_list_empty(&server.ipc_subscribers[event])) return;
+
+  uint32_t *pending = toplevel == NULL ? &server.ipc_pending : &toplevel->ipc_pending;
+  if(*pending & (1u << event)) {
+    server.ipc_coalesced++;
+    return;
+  }
+
+  ipc_schedule_pending();
+  if(toplevel != NULL && toplevel->ipc_pending == 0) {
+    wl_list_insert(server.ipc_pending_toplevels.prev, &toplevel->ipc_pending_link);
+  }
+  /* the events that wait are stamped with the oldest change, so the wait is measured too */
+  if(*pending == 0) {
+    *(toplevel == NULL ? &server.ipc_pending_usec : &toplevel->ipc_pending_usec) = ipc_now_usec();
+  }
+  *pending |= 1u << event;
 }
 
 void
 ipc_broadcast_message(enum ipc_event event) {
+  /* these are about focus, which has no generation */
+  shm_state_schedule();
+  ipc_queue_or_broadcast(event, NULL);
+}
+
+void
+ipc_broadcast_toplevel(enum ipc_event event, struct mwc_toplevel *toplevel) {
+  /* nobody has heard of it before it is mapped */
+  if(!toplevel->ipc_mapped && event != IPC_TOPLEVEL_UNMAP) return;
+
+  ipc_queue_or_broadcast(event, toplevel);
+}
+
+void
+ipc_broadcast_output(enum ipc_event event, struct mwc_output *output) {
   if(!server.ipc_running) return;
 
-  char message[512];
-  ipc_create_message(event, message, sizeof(message));
+  ipc_send_pending();
+  ipc_broadcast(event, output, ipc_now_usec());
+}
+
+/* starts {"id": <id>, "result": in the reply writer, the caller writes the result */
+struct ipc_writer *
+ipc_reply_begin(struct ipc_header *request) {
+  struct ipc_writer *writer = &server.ipc_reply_writer;
+  ipc_writer_reset(writer, request->encoding);
+  ipc_writer_object_begin(writer);
+  ipc_writer_key(writer, "id");
+  ipc_writer_int(writer, request->id);
+  ipc_writer_key(writer, "result");
+  return writer;
+}
+
+void
+ipc_reply_end(struct mwc_ipc_client *client, struct ipc_header *request) {
+  struct ipc_writer *writer = &server.ipc_reply_writer;
+  ipc_writer_object_end(writer);
+  ipc_client_write_message(client, IPC_MESSAGE_REPLY, request->id, request->encoding,
+                           writer->data, writer->length);
+}
+
+void
+ipc_reply_error(struct mwc_ipc_client *client, struct ipc_header *request,
+                enum ipc_error error, const char *message) {
+  /* we cannot answer in an encoding we do not know */
+  enum ipc_encoding encoding = request->encoding < IPC_ENCODING_COUNT
+    ? request->encoding : IPC_ENCODING_JSON;
+
+  struct ipc_writer *writer = &server.ipc_reply_writer;
+  ipc_writer_reset(writer, encoding);
+  ipc_writer_object_begin(writer);
+  ipc_writer_key(writer, "id");
+  ipc_writer_int(writer, request->id);
+  ipc_writer_key(writer, "error");
+  ipc_writer_object_begin(writer);
+  ipc_writer_key(writer, "code");
+  ipc_writer_int(writer, error);
+  ipc_writer_key(writer, "name");
+  ipc_writer_string(writer, ipc_error_names[error]);
+  ipc_writer_key(writer, "message");
+  ipc_writer_string(writer, message);
+  ipc_writer_object_end(writer);
+  ipc_writer_object_end(writer);
+
+  ipc_client_write_message(client, IPC_MESSAGE_ERROR, request->id, encoding,
+                           writer->data, writer->length);
+}
+
+void
+ipc_client_send_event(struct mwc_ipc_client *client, enum ipc_event event, void *object,
+                      uint64_t time_usec) {
+  /* coalescing also uses this writer, but then it does not need our message anymore */
+  struct ipc_writer *writer = &server.ipc_state_writer;
+  ipc_writer_reset(writer, client->encoding);
+  ipc_create_message(event, object, time_usec, writer);
+  ipc_client_queue_event(client, event, writer->data, writer->length);
+}
+
+void
+ipc_client_send_toplevels(struct mwc_ipc_client *client, enum ipc_event event,
+                          struct wl_list *toplevels, uint64_t time_usec) {
+  struct mwc_toplevel *toplevel;
+  wl_list_for_each(toplevel, toplevels, link) {
+    ipc_client_send_event(client, event, toplevel, time_usec);
+  }
+}
 
-  for(size_t i = 0; i < array_len(server.ipc_clients); i++) {
-    if(write(server.ipc_clients[i], message, strlen(message)) < 0) {
-      wlr_log(WLR_INFO, "could not write to client %d, assuming closed", server.ipc_clients[i]);
-      close(server.ipc_clients[i]);
-      array_remove(&server.ipc_clients, i);
-      i--;
+/* if not, the event is about something going away, or just something happening */
+bool
+ipc_event_has_state(enum ipc_event event) {
+  return event != IPC_TOPLEVEL_UNMAP && event != IPC_OUTPUT_REMOVE
+    && event != IPC_CONFIG_RELOAD;
+}
+
+/* sends the current state of an event type to just this client, so it does not have to
+ * ask for it. that is the event for every toplevel or output it can be about, and
+ * nothing for events that are only about something going away */
+void
+ipc_client_send_state(struct mwc_ipc_client *client, enum ipc_event event, uint64_t time_usec) {
+  /* coalescing while subscribing sends the state from within here */
+  bool sending_state = client->sending_state;
+  client->sending_state = true;
+
+  switch(event) {
+    case IPC_ACTIVE_WORKSPACE:
+    case IPC_ACTIVE_TOPLEVEL: {
+      ipc_client_send_event(client, event, NULL, time_usec);
+      break;
+    }
+    case IPC_TOPLEVEL_MAP:
+    case IPC_TOPLEVEL_TITLE:
+    case IPC_TOPLEVEL_APP_ID:
+    case IPC_TOPLEVEL_WORKSPACE:
+    case IPC_TOPLEVEL_FLOATING:
+    case IPC_TOPLEVEL_FULLSCREEN:
+    case IPC_TOPLEVEL_GEOMETRY: {
+      struct mwc_output *output;
+      wl_list_for_each(output, &server.outputs, link) {
+        struct mwc_workspace *workspace;
+        wl_list_for_each(workspace, &output->workspaces, link) {
+          ipc_client_send_toplevels(client, event, &workspace->floating_toplevels, time_usec);
+          ipc_client_send_toplevels(client, event, &workspace->masters, time_usec);
+          ipc_client_send_toplevels(client, event, &workspace->slaves, time_usec);
+        }
+      }
+      break;
+    }
+    case IPC_OUTPUT_ADD: {
+      struct mwc_output *output;
+      wl_list_for_each(output, &server.outputs, link) {
+        ipc_client_send_event(client, event, output, time_usec);
+      }
+      break;
+    }
+    case IPC_TOPLEVEL_UNMAP:
+    case IPC_OUTPUT_REMOVE:
+    case IPC_CONFIG_RELOAD: {
+      break;
+    }
+    case IPC_EVENT_COUNT: {
+      assert(false && "you should not have done this");
     }
   }
+
+  client->sending_state = sending_state;
 }
 
+/* arg is a space separated list of event names, or NULL for all of them */
 void
-ipc_add_client(int fd) {
-  array_push(&server.ipc_clients, fd);
+ipc_subscribe(struct mwc_ipc_client *client, struct ipc_header *request, char *arg) {
+  bool wanted[IPC_EVENT_COUNT] = {0};
+  if(arg == NULL) {
+    for(size_t i = 0; i < IPC_EVENT_COUNT; i++) {
+      wanted[i] = true;
+    }
+  } else {
+    char *saveptr;
+    for(char *name = strtok_r(arg, " ", &saveptr); name != NULL;
+        name = strtok_r(NULL, " ", &saveptr)) {
+      size_t i = 0;
+      while(i < IPC_EVENT_COUNT && strcmp(name, ipc_event_names[i]) != 0) {
+        i++;
+      }
+
+      if(i == IPC_EVENT_COUNT) {
+        char message[128];
+        snprintf(message, sizeof(message), "unknown event '%.64s'", name);
+        ipc_reply_error(client, request, IPC_ERROR_INVALID_ARGUMENT, message);
+        return;
+      }
+      wanted[i] = true;
+    }
+  }
+
+  client->subscribed = true;
+  client->subscribe_id = request->id;
+  client->encoding = request->encoding;
+
+  /* events never grow the buffer, so it is allocated once here */
+  if(client->out_cap < server.config->ipc_buffer_size) {
+    char *out = realloc(client->out, server.config->ipc_buffer_size);
+    if(out == NULL) {
+      ipc_client_abandon(client, "out of memory");
+      return;
+    }
+    client->out = out;
+    client->out_cap = server.config->ipc_buffer_size;
+  }
+
+  /* subscribing again adds to the events the client already gets */
   for(size_t i = 0; i < IPC_EVENT_COUNT; i++) {
-    ipc_broadcast_message(i);
+    if(!wanted[i] || client->subscriptions[i].client != NULL) continue;
+
+    client->subscriptions[i].client = client;
+    wl_list_insert(server.ipc_subscribers[i].prev, &client->subscriptions[i].link);
+  }
+
+  /* the reply lists everything the client is subscribed to now */
+  struct ipc_writer *writer = ipc_reply_begin(request);
+  ipc_writer_array_begin(writer);
+  for(size_t i = 0; i < IPC_EVENT_COUNT; i++) {
+    if(client->subscriptions[i].client != NULL) {
+      ipc_writer_string(writer, ipc_event_names[i]);
+    }
+  }
+  ipc_writer_array_end(writer);
+  ipc_reply_end(client, request);
+
+  uint64_t now = ipc_now_usec();
+  for(size_t i = 0; i < IPC_EVENT_COUNT; i++) {
+    if(wanted[i]) {
+      ipc_client_send_state(client, i, now);
+    }
   }
 }
 
-/* this is horrendous, but i dont care, never going to touch it again */
+/* only toplevels changed after since are written */
 void
-ipc_handle_simple(char *request, int fd) {
-  size_t len = 0;
-  size_t cap = STRING_INITIAL_LENGTH;
-  char *message = calloc(cap, sizeof(char));
-  char *p = message;
-  if(strcmp(request, "toplevels") == 0) {
-    struct mwc_output *output;
-    wl_list_for_each(output, &server.outputs, link) {
-      struct mwc_workspace *workspace;
-      wl_list_for_each(workspace, &output->workspaces, link) {
+ipc_write_toplevels(struct ipc_writer *writer, struct wl_list *toplevels, uint64_t since) {
+  struct mwc_toplevel *toplevel;
+  wl_list_for_each(toplevel, toplevels, link) {
+    if(toplevel->generation <= since) continue;
+
+    ipc_writer_object_begin(writer);
+    ipc_write_toplevel(writer, toplevel);
+    ipc_writer_object_end(writer);
+  }
+}
+
+struct mwc_toplevel *
+ipc_find_toplevel(uint64_t id) {
+  struct mwc_output *output;
+  wl_list_for_each(output, &server.outputs, link) {
+    struct mwc_workspace *workspace;
+    wl_list_for_each(workspace, &output->workspaces, link) {
+      struct wl_list *lists[] = { &workspace->floating_toplevels, &workspace->masters, &workspace->slaves };
+      for(size_t i = 0; i < sizeof(lists) / sizeof(*lists); i++) {
         struct mwc_toplevel *toplevel;
-        wl_list_for_each(toplevel, &workspace->floating_toplevels, link) {
-          char *q = toplevel->xdg_toplevel->app_id;
-          while(*q != 0) {
-            if(len >= cap) {
-              cap *= 2;
-              message = realloc(message, cap);
-              p = message + len;
-            }
-            *p = *q;
-            p++;
-            q++;
-            len++;
-          }
-          
-          if(len >= cap) {
-            cap *= 2;
-            message = realloc(message, cap);
-            p = message + len;
-          }
-
-          *p = ',';
-          p++;
-          len++;
-
-          q = toplevel->xdg_toplevel->title;
-          while(*q != 0) {
-            if(len >= cap) {
-              cap *= 2;
-              message = realloc(message, cap);
-              p = message + len;
-            }
-            *p = *q;
-            p++;
-            q++;
-            len++;
-          }
-          
-          *p = '\n';
-          p++;
-          len++;
+        wl_list_for_each(toplevel, lists[i], link) {
+          if(toplevel->id == id) return toplevel;
         }
+      }
+    }
+  }
+  return NULL;
+}
 
-        wl_list_for_each(toplevel, &workspace->masters, link) {
-          char *q = toplevel->xdg_toplevel->app_id;
-          while(*q != 0) {
-            if(len >= cap) {
-              cap *= 2;
-              message = realloc(message, cap);
-              p = message + len;
-            }
-            *p = *q;
-            p++;
-            q++;
-            len++;
-          }
-          
-          if(len >= cap) {
-            cap *= 2;
-            message = realloc(message, cap);
-            p = message + len;
-          }
-
-          *p = ',';
-          p++;
-          len++;
-
-          q = toplevel->xdg_toplevel->title;
-          while(*q != 0) {
-            if(len >= cap) {
-              cap *= 2;
-              message = realloc(message, cap);
-              p = message + len;
-            }
-            *p = *q;
-            p++;
-            q++;
-            len++;
-          }
-          
-          *p = '\n';
-          p++;
-          len++;
-        }
+void
+ipc_handle_request(struct mwc_ipc_client *client, struct ipc_header *request, char *payload) {
+  if(request->encoding >= IPC_ENCODING_COUNT) {
+    ipc_reply_error(client, request, IPC_ERROR_UNSUPPORTED_ENCODING, "unknown encoding");
+    return;
+  }
 
-        wl_list_for_each(toplevel, &workspace->slaves, link) {
-          char *q = toplevel->xdg_toplevel->app_id;
-          while(*q != 0) {
-            if(len >= cap) {
-              cap *= 2;
-              message = realloc(message, cap);
-              p = message + len;
-            }
-            *p = *q;
-            p++;
-            q++;
-            len++;
-          }
-          
-          if(len >= cap) {
-            cap *= 2;
-            message = realloc(message, cap);
-            p = message + len;
-          }
-
-          *p = ',';
-          p++;
-          len++;
-
-          q = toplevel->xdg_toplevel->title;
-          while(*q != 0) {
-            if(len >= cap) {
-              cap *= 2;
-              message = realloc(message, cap);
-              p = message + len;
-            }
-            *p = *q;
-            p++;
-            q++;
-            len++;
-          }
-          
-          *p = '\n';
-          p++;
-          len++;
-        }
+  if(request->version != IPC_PROTOCOL_VERSION) {
+    char message[128];
+    snprintf(message, sizeof(message), "protocol version %u is not supported, the compositor uses %u",
+             request->version, IPC_PROTOCOL_VERSION);
+    ipc_reply_error(client, request, IPC_ERROR_UNSUPPORTED_VERSION, message);
+    return;
+  }
+
+  if(request->type != IPC_MESSAGE_REQUEST) {
+    ipc_reply_error(client, request, IPC_ERROR_INVALID_REQUEST, "only requests can be sent");
+    return;
+  }
+
+  /* the first word is the request, the rest are its arguments */
+  char *arg = strchr(payload, ' ');
+  if(arg != NULL) {
+    *arg = 0;
+    arg++;
+  }
+
+  if(strcmp(payload, "subscribe") == 0) {
+    ipc_subscribe(client, request, arg);
+  } else if(strcmp(payload, "version") == 0) {
+    struct ipc_writer *writer = ipc_reply_begin(request);
+    ipc_writer_object_begin(writer);
+    ipc_writer_key(writer, "protocol");
+    ipc_writer_int(writer, IPC_PROTOCOL_VERSION);
+    ipc_writer_object_end(writer);
+    ipc_reply_end(client, request);
+  } else if(strcmp(payload, "toplevels") == 0) {
+    struct ipc_writer *writer = ipc_reply_begin(request);
+    ipc_writer_array_begin(writer);
+    struct mwc_output *output;
+    wl_list_for_each(output, &server.outputs, link) {
+      struct mwc_workspace *workspace;
+      wl_list_for_each(workspace, &output->workspaces, link) {
+        ipc_write_toplevels(writer, &workspace->floating_toplevels, 0);
+        ipc_write_toplevels(writer, &workspace->masters, 0);
+        ipc_write_toplevels(writer, &workspace->slaves, 0);
       }
     }
-  } else if(strcmp(request, "layers") == 0) {
+    ipc_writer_array_end(writer);
+    ipc_reply_end(client, request);
+  } else if(strcmp(payload, "layers") == 0) {
+    struct ipc_writer *writer = ipc_reply_begin(request);
+    ipc_writer_array_begin(writer);
     struct mwc_output *output;
     wl_list_for_each(output, &server.outputs, link) {
       struct mwc_layer_surface *layer;
       for(size_t i = 0; i < 4; i++) {
         wl_list_for_each(layer, &(&output->layers.background)[i], link) {
-          char *q = layer->wlr_layer_surface->namespace;
-          while(*q != 0) {
-            if(len >= cap) {
-              cap *= 2;
-              message = realloc(message, cap);
-              p = message + len;
-            }
-            *p = *q;
-            p++;
-            q++;
-            len++;
-          }
-
-          if(len >= cap) {
-            cap *= 2;
-            message = realloc(message, cap);
-            p = message + len;
-          }
-
-          *p = '\n';
-          p++;
-          len++;
+          ipc_writer_object_begin(writer);
+          ipc_writer_key(writer, "namespace");
+          ipc_writer_string(writer, layer->wlr_layer_surface->namespace);
+          ipc_writer_key(writer, "output");
+          ipc_writer_string(writer, output->wlr_output->name);
+          ipc_writer_object_end(writer);
         }
       }
     }
-  } else if(strcmp(request, "outputs") == 0) {
+    ipc_writer_array_end(writer);
+    ipc_reply_end(client, request);
+  } else if(strcmp(payload, "outputs") == 0) {
+    struct ipc_writer *writer = ipc_reply_begin(request);
+    ipc_writer_array_begin(writer);
     struct mwc_output *output;
     wl_list_for_each(output, &server.outputs, link) {
-      char *q = output->wlr_output->name;
-      while(*q != 0) {
-        if(len >= cap) {
-          cap *= 2;
-          message = realloc(message, cap);
-          p = message + len;
-        }
-        *p = *q;
-        p++;
-        q++;
-        len++;
+      ipc_writer_object_begin(writer);
+      ipc_write_output(writer, output);
+      ipc_writer_object_end(writer);
+    }
+    ipc_writer_array_end(writer);
+    ipc_reply_end(client, request);
+  } else if(strcmp(payload, "master-count") == 0) {
+    /* either an absolute value, or a relative one if it starts with a sign */
+    char *end;
+    int64_t value = arg == NULL ? 0 : strtoll(arg, &end, 10);
+    if(arg == NULL || end == arg || *end != 0) {
+      ipc_reply_error(client, request, IPC_ERROR_INVALID_ARGUMENT, "expected [+|-]<count>");
+      return;
+    }
+
+    struct mwc_workspace *workspace = server.active_workspace;
+    if(arg[0] == '+' || arg[0] == '-') {
+      value += workspace->master_count;
+    }
+    layout_set_master_count(workspace, max(value, 1));
+
+    struct ipc_writer *writer = ipc_reply_begin(request);
+    ipc_writer_int(writer, workspace->master_count);
+    ipc_reply_end(client, request);
+  } else if(strcmp(payload, "master-ratio") == 0) {
+    char *end;
+    double value = arg == NULL ? 0 : strtod(arg, &end);
+    if(arg == NULL || end == arg || *end != 0) {
+      ipc_reply_error(client, request, IPC_ERROR_INVALID_ARGUMENT, "expected [+|-]<ratio>");
+      return;
+    }
+
+    struct mwc_workspace *workspace = server.active_workspace;
+    if(arg[0] == '+' || arg[0] == '-') {
+      value += workspace->master_ratio;
+    }
+    layout_set_master_ratio(workspace, value);
+
+    struct ipc_writer *writer = ipc_reply_begin(request);
+    ipc_writer_double(writer, workspace->master_ratio);
+    ipc_reply_end(client, request);
+  } else if(strcmp(payload, "focus") == 0) {
+    char *end;
+    uint64_t id = arg == NULL ? 0 : strtoull(arg, &end, 10);
+    if(arg == NULL || end == arg || *end != 0) {
+      ipc_reply_error(client, request, IPC_ERROR_INVALID_ARGUMENT, "expected <id>");
+      return;
+    }
+
+    struct mwc_toplevel *toplevel = ipc_find_toplevel(id);
+    if(toplevel == NULL) {
+      ipc_reply_error(client, request, IPC_ERROR_INVALID_ARGUMENT, "no toplevel with that id");
+      return;
+    }
+
+    change_workspace(toplevel->workspace, true);
+    focus_toplevel(toplevel);
+
+    /* it can still be refused, by a lock or a fullscreen toplevel for example */
+    struct ipc_writer *writer = ipc_reply_begin(request);
+    ipc_writer_bool(writer, server.focused_toplevel == toplevel);
+    ipc_reply_end(client, request);
+  } else if(strcmp(payload, "exit") == 0) {
+    /* the reply may not make it out, the connection is closed when the compositor stops */
+    struct ipc_writer *writer = ipc_reply_begin(request);
+    ipc_writer_bool(writer, true);
+    ipc_reply_end(client, request);
+    keybind_stop_server(NULL);
+  } else if(strcmp(payload, "latency") == 0) {
+    struct ipc_writer *writer = ipc_reply_begin(request);
+    latency_write(writer);
+    ipc_reply_end(client, request);
+  } else if(strcmp(payload, "frame-times") == 0) {
+    if(arg != NULL && strcmp(arg, "reset") != 0) {
+      ipc_reply_error(client, request, IPC_ERROR_INVALID_ARGUMENT, "expected nothing or reset");
+      return;
+    }
+
+    struct ipc_writer *writer = ipc_reply_begin(request);
+    latency_write_frame_times(writer, arg != NULL);
+    ipc_reply_end(client, request);
+  } else if(strcmp(payload, "changed-since") == 0) {
+    char *end;
+    uint64_t since = arg == NULL ? 0 : strtoull(arg, &end, 10);
+    if(arg == NULL || end == arg || *end != 0) {
+      ipc_reply_error(client, request, IPC_ERROR_INVALID_ARGUMENT, "expected <generation>");
+      return;
+    }
+
+    /* the client missed some removals, so it has to start over */
+    bool full = !generation_removals_known(since);
+    if(full) {
+      since = 0;
+    }
+
+    struct ipc_writer *writer = ipc_reply_begin(request);
+    ipc_writer_object_begin(writer);
+    ipc_writer_key(writer, "generation");
+    ipc_writer_int(writer, server.generations.current);
+    ipc_writer_key(writer, "full");
+    ipc_writer_bool(writer, full);
+    ipc_writer_key(writer, "active_workspace");
+    ipc_writer_int(writer, server.active_workspace->index);
+
+    struct mwc_output *output;
+    ipc_writer_key(writer, "outputs");
+    ipc_writer_array_begin(writer);
+    wl_list_for_each(output, &server.outputs, link) {
+      if(output->generation <= since) continue;
+
+      ipc_writer_object_begin(writer);
+      ipc_write_output(writer, output);
+      ipc_writer_object_end(writer);
+    }
+    ipc_writer_array_end(writer);
+
+    ipc_writer_key(writer, "workspaces");
+    ipc_writer_array_begin(writer);
+    wl_list_for_each(output, &server.outputs, link) {
+      struct mwc_workspace *workspace;
+      wl_list_for_each(workspace, &output->workspaces, link) {
+        if(workspace->generation <= since) continue;
+
+        ipc_writer_object_begin(writer);
+        ipc_write_workspace(writer, workspace);
+        ipc_writer_object_end(writer);
+      }
+    }
+    ipc_writer_array_end(writer);
+
+    ipc_writer_key(writer, "toplevels");
+    ipc_writer_array_begin(writer);
+    wl_list_for_each(output, &server.outputs, link) {
+      struct mwc_workspace *workspace;
+      wl_list_for_each(workspace, &output->workspaces, link) {
+        ipc_write_toplevels(writer, &workspace->floating_toplevels, since);
+        ipc_write_toplevels(writer, &workspace->masters, since);
+        ipc_write_toplevels(writer, &workspace->slaves, since);
       }
+    }
+    ipc_writer_array_end(writer);
+
+    /* with their generation, a toplevel can be unmapped and mapped again after since */
+    ipc_writer_key(writer, "removed");
+    ipc_writer_array_begin(writer);
+    for(size_t i = 0; i < GENERATION_REMOVED_COUNT && !full; i++) {
+      struct mwc_removed *removed = &server.generations.removed[i];
+      if(removed->generation <= since) continue;
 
-      if(len >= cap) {
-        cap *= 2;
-        message = realloc(message, cap);
-        p = message + len;
+      ipc_writer_object_begin(writer);
+      ipc_writer_key(writer, "generation");
+      ipc_writer_int(writer, removed->generation);
+      if(removed->type == MWC_REMOVED_TOPLEVEL) {
+        ipc_writer_key(writer, "toplevel");
+        ipc_writer_int(writer, removed->toplevel_id);
+      } else {
+        ipc_writer_key(writer, "output");
+        ipc_writer_string(writer, removed->output_name);
       }
+      ipc_writer_object_end(writer);
+    }
+    ipc_writer_array_end(writer);
+
+    ipc_writer_object_end(writer);
+    ipc_reply_end(client, request);
+  } else if(strcmp(payload, "stats") == 0) {
+    struct ipc_writer *writer = ipc_reply_begin(request);
+    ipc_writer_object_begin(writer);
+    /* replaced while waiting for ipc_coalesce_ms, not to be confused with the per client
+     * count of events replaced in its queue */
+    ipc_writer_key(writer, "coalesced_pending");
+    ipc_writer_int(writer, server.ipc_coalesced);
+    ipc_writer_key(writer, "clients");
+    ipc_writer_array_begin(writer);
+    struct mwc_ipc_client *c;
+    wl_list_for_each(c, &server.ipc_clients, link) {
+      ipc_writer_object_begin(writer);
+      ipc_writer_key(writer, "fd");
+      ipc_writer_int(writer, c->fd);
+      ipc_writer_key(writer, "subscribed");
+      ipc_writer_bool(writer, c->subscribed);
+      ipc_writer_key(writer, "queued");
+      ipc_writer_int(writer, c->out_length);
+      ipc_writer_key(writer, "dropped");
+      ipc_writer_int(writer, c->dropped);
+      ipc_writer_key(writer, "coalesced");
+      ipc_writer_int(writer, c->coalesced);
+      ipc_writer_object_end(writer);
+    }
+    ipc_writer_array_end(writer);
+    ipc_writer_object_end(writer);
+    ipc_reply_end(client, request);
+  } else if(strcmp(payload, "shm") == 0) {
+    if(client->out_fd != -1) {
+      ipc_reply_error(client, request, IPC_ERROR_INVALID_REQUEST,
+                      "the previous shm reply is not received yet");
+      return;
+    }
 
-      *p = '\n';
-      p++;
-      len++;
+    int fd = shm_state_get_fd();
+    if(fd == -1) {
+      ipc_reply_error(client, request, IPC_ERROR_INTERNAL, "could not create the shared state");
+      return;
     }
+
+    struct ipc_writer *writer = ipc_reply_begin(request);
+    ipc_writer_object_begin(writer);
+    ipc_writer_key(writer, "version");
+    ipc_writer_int(writer, IPC_SHM_VERSION);
+    ipc_writer_key(writer, "size");
+    ipc_writer_int(writer, sizeof(struct ipc_shm_state));
+    ipc_writer_object_end(writer);
+    ipc_writer_object_end(writer);
+    ipc_client_write_message_with_fd(client, IPC_MESSAGE_REPLY, request->id, request->encoding,
+                                     writer->data, writer->length, fd);
+  } else if(strcmp(payload, "save-layout") == 0 && server.headless) {
+    /* it would overwrite the layout of the real session with whatever the test clients left */
+    ipc_reply_error(client, request, IPC_ERROR_INVALID_REQUEST, "no layout is saved in a headless session");
+  } else if(strcmp(payload, "save-layout") == 0) {
+    snapshot_save();
+    struct ipc_writer *writer = ipc_reply_begin(request);
+    ipc_writer_bool(writer, true);
+    ipc_reply_end(client, request);
   } else {
-    message = "invalid request\n";
-    len = strlen(message);
+    char message[128];
+    snprintf(message, sizeof(message), "unknown request '%.64s'", payload);
+    ipc_reply_error(client, request, IPC_ERROR_INVALID_REQUEST, message);
   }
+}
 
-  write(fd, message, len);
-  free(message);
-  close(fd);
+size_t
+ipc_message_size(const char *message) {
+  struct ipc_header header;
+  memcpy(&header, message, sizeof(header));
+  return sizeof(header) + header.length;
 }
 
-void *
-ipc_run(void *data) {
-  struct sigaction sa;
-  sa.sa_handler = sigpipe_handler;
-  sa.sa_flags = 0;
-  sigemptyset(&sa.sa_mask);
+enum ipc_message_type
+ipc_message_type(const char *message) {
+  struct ipc_header header;
+  memcpy(&header, message, sizeof(header));
+  return header.type;
+}
 
-  if(sigaction(SIGPIPE, &sa, NULL) == -1) goto no_close;
+void
+ipc_message_write(char *dest, enum ipc_message_type type, uint32_t id,
+                  enum ipc_encoding encoding, const char *payload, uint32_t length) {
+  struct ipc_header header = {
+    .length = length,
+    .id = id,
+    .version = IPC_PROTOCOL_VERSION,
+    .type = type,
+    .encoding = encoding,
+  };
 
-  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
-  if(fd == -1) goto no_close;
+  memcpy(dest, &header, sizeof(header));
+  memcpy(dest + sizeof(header), payload, length);
+}
 
-  struct sockaddr_un address = {0};
-  address.sun_family = AF_UNIX;
-  strcpy(address.sun_path, IPC_PATH);
+void
+ipc_client_abandon(struct mwc_ipc_client *client, const char *reason) {
+  wlr_log(WLR_INFO, "ipc: disconnecting client %d, %s", client->fd, reason);
+  client->out_length = 0;
+  client->out_sent = 0;
+  if(client->out_fd != -1) {
+    close(client->out_fd);
+    client->out_fd = -1;
+  }
+  client->closing = true;
+}
 
-  if(bind(fd, (struct sockaddr *)&address, sizeof(address))) goto error;
-  if(listen(fd, 128) == -1) goto error;
+bool
+ipc_client_write_message(struct mwc_ipc_client *client, enum ipc_message_type type, uint32_t id,
+                         enum ipc_encoding encoding, const char *payload, uint32_t length) {
+  size_t size = sizeof(struct ipc_header) + length;
+  if(client->out_length + size > client->out_cap) {
+    size_t out_cap = max(client->out_cap * 2, client->out_length + size);
+    char *out = realloc(client->out, out_cap);
+    if(out == NULL) {
+      ipc_client_abandon(client, "out of memory");
+      return false;
+    }
+    client->out = out;
+    client->out_cap = out_cap;
+  }
 
-  array_init(&server.ipc_clients);
-  server.ipc_running = true;
+  ipc_message_write(client->out + client->out_length, type, id, encoding, payload, length);
+  client->out_length += size;
+  return true;
+}
 
-  char buffer[1024];
-  while(1) {
-    struct sockaddr_un client_address;
-    socklen_t sock_len;
-    int client = accept(fd, (struct sockaddr *)&client_address, &sock_len);
-    if(client == -1) continue;
+void
+ipc_client_write_message_with_fd(struct mwc_ipc_client *client, enum ipc_message_type type,
+                                 uint32_t id, enum ipc_encoding encoding, const char *payload,
+                                 uint32_t length, int fd) {
+  assert(client->out_fd == -1);
 
-    wlr_log(WLR_INFO, "ipc: new client on fd: %d", client);
+  client->out_fd = fd;
+  client->out_fd_offset = client->out_length;
+  /* the fd is closed together with everything else then */
+  if(!ipc_client_write_message(client, type, id, encoding, payload, length)) return;
 
-    ssize_t len = read(client, buffer, sizeof(buffer) - 1);
-    if(len < 0) continue;
+  /* messages are not aligned in out, so the header is not accessed in place */
+  client->out[client->out_fd_offset + offsetof(struct ipc_header, flags)] |= IPC_MESSAGE_HAS_FD;
+}
 
-    buffer[len] = 0;
+/* a config reload may raise ipc_buffer_size past what was allocated on subscribe */
+size_t
+ipc_client_event_limit(struct mwc_ipc_client *client) {
+  return min(server.config->ipc_buffer_size, client->out_cap);
+}
 
-    if(strcmp(buffer, "subscribe") == 0) {
-      ipc_add_client(client);
+/* the partly sent message at the front of out must not be dropped */
+size_t
+ipc_client_kept_length(struct mwc_ipc_client *client) {
+  return client->out_sent > 0 ? ipc_message_size(client->out) : 0;
+}
+
+void
+ipc_client_append_event(struct mwc_ipc_client *client, const char *payload, uint32_t length,
+                        uint8_t flags) {
+  ipc_message_write(client->out + client->out_length, IPC_MESSAGE_EVENT, client->subscribe_id,
+                    client->encoding, payload, length);
+  client->out[client->out_length + offsetof(struct ipc_header, flags)] = flags;
+  client->out_length += sizeof(struct ipc_header) + length;
+}
+
+uint8_t
+ipc_message_flags(const char *message) {
+  struct ipc_header header;
+  memcpy(&header, message, sizeof(header));
+  return header.flags;
+}
+
+/* reads back the time_usec of an event payload, see ipc_create_message() */
+uint64_t
+ipc_event_time_usec(enum ipc_encoding encoding, const char *payload, uint32_t length) {
+  if(encoding == IPC_ENCODING_JSON) {
+    /* {"time_usec":<digits>, the digits are always followed by a comma */
+    size_t offset = strlen("{\"time_usec\":");
+    return length > offset ? strtoull(payload + offset, NULL, 10) : 0;
+  }
+
+  /* the object tag, the key as a tagged string and the tag of the int */
+  size_t offset = 1 + 1 + sizeof(uint32_t) + strlen("time_usec") + 1;
+  int64_t value = 0;
+  if(length >= offset + sizeof(value)) {
+    memcpy(&value, payload + offset, sizeof(value));
+  }
+  return value;
+}
+
+/* drops queued events after the kept message, oldest first, until size more bytes fit.
+ * replies to requests are never dropped */
+void
+ipc_client_drop_oldest(struct mwc_ipc_client *client, size_t size) {
+  size_t limit = ipc_client_event_limit(client);
+  size_t read = ipc_client_kept_length(client);
+  size_t write = read;
+
+  while(read < client->out_length) {
+    size_t message_size = ipc_message_size(client->out + read);
+    if(ipc_message_type(client->out + read) == IPC_MESSAGE_EVENT
+       && client->out_length - (read - write) + size > limit) {
+      client->dropped++;
     } else {
-      ipc_handle_simple(buffer, client);
+      if(client->out_fd != -1 && client->out_fd_offset == read) {
+        client->out_fd_offset = write;
+      }
+      memmove(client->out + write, client->out + read, message_size);
+      write += message_size;
+    }
+    read += message_size;
+  }
+
+  client->out_length = write;
+}
+
+/* replaces all queued events with the current state, which already includes whatever
+ * the dropped events were about. events about something going away are kept, in order.
+ * time_usec is the time of the event that did not fit, the state gets the time of the
+ * oldest change it stands for */
+void
+ipc_client_coalesce(struct mwc_ipc_client *client, uint64_t time_usec) {
+  size_t read = ipc_client_kept_length(client);
+  size_t write = read;
+
+  while(read < client->out_length) {
+    size_t message_size = ipc_message_size(client->out + read);
+    if(ipc_message_type(client->out + read) == IPC_MESSAGE_EVENT
+       && !(ipc_message_flags(client->out + read) & IPC_MESSAGE_NO_STATE)) {
+      uint64_t dropped_usec = ipc_event_time_usec(client->encoding,
+                                                  client->out + read + sizeof(struct ipc_header),
+                                                  message_size - sizeof(struct ipc_header));
+      time_usec = min(time_usec, dropped_usec);
+      client->coalesced++;
+    } else {
+      if(client->out_fd != -1 && client->out_fd_offset == read) {
+        client->out_fd_offset = write;
+      }
+      memmove(client->out + write, client->out + read, message_size);
+      write += message_size;
+    }
+    read += message_size;
+  }
+
+  client->out_length = write;
+
+  /* whatever does not fit now is dropped */
+  client->coalescing = true;
+  for(size_t i = 0; i < IPC_EVENT_COUNT; i++) {
+    if(client->subscriptions[i].client != NULL) {
+      ipc_client_send_state(client, i, time_usec);
+    }
+  }
+  client->coalescing = false;
+}
+
+void
+ipc_client_queue_event(struct mwc_ipc_client *client, enum ipc_event event,
+                       const char *payload, uint32_t length) {
+  if(client->closing) return;
+
+  size_t size = sizeof(struct ipc_header) + length;
+  size_t limit = ipc_client_event_limit(client);
+  if(client->out_length + size > limit && !client->coalescing) {
+    switch(server.config->ipc_backpressure) {
+      case MWC_IPC_COALESCE: {
+        ipc_client_coalesce(client, ipc_event_time_usec(client->encoding, payload, length));
+        /* the event is part of the current state then, so it is not written again */
+        if(ipc_event_has_state(event)) return;
+        break;
+      }
+      case MWC_IPC_DROP_OLDEST: {
+        ipc_client_drop_oldest(client, size);
+        break;
+      }
+      case MWC_IPC_DISCONNECT: {
+        ipc_client_abandon(client, "it is not reading events");
+        return;
+      }
     }
   }
 
+  if(client->out_length + size > limit) {
+    client->dropped++;
+    return;
+  }
+
+  uint8_t flags = ipc_event_has_state(event) ? 0 : IPC_MESSAGE_NO_STATE;
+  if(client->sending_state) {
+    flags |= IPC_MESSAGE_STATE;
+  }
+  ipc_client_append_event(client, payload, length, flags);
+}
+
+ssize_t
+ipc_send_with_fd(int socket, const char *data, size_t length, int fd) {
+  struct iovec iov = {
+    .iov_base = (void *)data,
+    .iov_len = length,
+  };
+  char control[CMSG_SPACE(sizeof(fd))] = {0};
+  struct msghdr message = {
+    .msg_iov = &iov,
+    .msg_iovlen = 1,
+    .msg_control = control,
+    .msg_controllen = sizeof(control),
+  };
+
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(fd));
+  memcpy(CMSG_DATA(cmsg), &fd, sizeof(fd));
+
+  return sendmsg(socket, &message, MSG_NOSIGNAL);
+}
+
+void
+ipc_client_flush(struct mwc_ipc_client *client) {
+  while(client->out_sent < client->out_length) {
+    /* the fd arrives together with the bytes it is sent with, so it has to go
+     * exactly with the start of its message and what is before it goes alone */
+    bool with_fd = client->out_fd != -1 && client->out_sent == client->out_fd_offset;
+    size_t end = client->out_fd != -1 && client->out_sent < client->out_fd_offset
+      ? client->out_fd_offset : client->out_length;
+
+    ssize_t n = with_fd
+      ? ipc_send_with_fd(client->fd, client->out + client->out_sent,
+                         end - client->out_sent, client->out_fd)
+      : send(client->fd, client->out + client->out_sent, end - client->out_sent, MSG_NOSIGNAL);
+    if(n < 0) {
+      if(errno == EAGAIN || errno == EWOULDBLOCK) break;
+      if(errno == EINTR) continue;
+
+      wlr_log(WLR_INFO, "ipc: could not write to client %d, assuming closed", client->fd);
+      client->out_sent = client->out_length;
+      client->closing = true;
+      break;
+    }
+    client->out_sent += n;
+
+    if(with_fd) {
+      close(client->out_fd);
+      client->out_fd = -1;
+    }
+  }
+
+  /* only whole messages are removed, a partly sent one stays at the front */
+  size_t done = 0;
+  while(done < client->out_length) {
+    size_t size = ipc_message_size(client->out + done);
+    if(done + size > client->out_sent) break;
+    done += size;
+  }
+
+  memmove(client->out, client->out + done, client->out_length - done);
+  client->out_length -= done;
+  client->out_sent -= done;
+  /* it is not sent yet, so its message is not done */
+  if(client->out_fd != -1) {
+    client->out_fd_offset -= done;
+  }
+
+  /* a client whose requests are being handled is destroyed when that is done */
+  if(client->out_length == 0 && client->closing && !client->busy) {
+    ipc_client_destroy(client);
+    return;
+  }
+
+  wl_event_source_fd_update(client->source, ipc_client_mask(client));
+}
+
+uint32_t
+ipc_client_mask(struct mwc_ipc_client *client) {
+  /* we only wait for the socket to become writable while there is something to write */
+  uint32_t mask = client->out_length > 0 ? WL_EVENT_WRITABLE : 0;
+  /* and stop reading from clients that are closing, or do not read their replies */
+  if(!client->closing && !ipc_client_backlogged(client)) {
+    mask |= WL_EVENT_READABLE;
+  }
+  return mask;
+}
+
+bool
+ipc_client_backlogged(struct mwc_ipc_client *client) {
+  return client->out_length > server.config->ipc_buffer_size;
+}
+
+void
+ipc_client_destroy(struct mwc_ipc_client *client) {
+  wlr_log(WLR_INFO, "ipc: client on fd %d disconnected (%" PRIu64 " events dropped, %" PRIu64 " coalesced)",
+          client->fd, client->dropped, client->coalesced);
+
+  wl_event_source_remove(client->source);
+  close(client->fd);
+  wl_list_remove(&client->link);
+  for(size_t i = 0; i < IPC_EVENT_COUNT; i++) {
+    if(client->subscriptions[i].client != NULL) {
+      wl_list_remove(&client->subscriptions[i].link);
+    }
+  }
+
+  if(client->out_fd != -1) {
+    close(client->out_fd);
+  }
+
+  free(client->in);
+  free(client->out);
+  free(client);
+}
+
+/* handles all the complete requests in the buffer, returns false if the client
+ * sent something we cannot recover from and is closing */
+bool
+ipc_client_handle_requests(struct mwc_ipc_client *client) {
+  size_t start = 0;
+  while(!client->closing && client->in_length - start >= sizeof(struct ipc_header)) {
+    struct ipc_header header;
+    memcpy(&header, client->in + start, sizeof(header));
+
+    if(header.length > IPC_MAX_REQUEST_LENGTH) {
+      wlr_log(WLR_ERROR, "ipc: request of client %d is too long, disconnecting", client->fd);
+      ipc_reply_error(client, &header, IPC_ERROR_TOO_LONG, "request is too long");
+      client->in_length = 0;
+      client->closing = true;
+      return false;
+    }
+
+    if(client->in_length - start < sizeof(header) + header.length) break;
+
+    /* copied, so it can be null terminated without touching the next request */
+    char payload[IPC_MAX_REQUEST_LENGTH + 1];
+    memcpy(payload, client->in + start + sizeof(header), header.length);
+    payload[header.length] = 0;
+    /* be forgiving to clients that end the request with a newline */
+    if(header.length > 0 && payload[header.length - 1] == '\n') {
+      payload[header.length - 1] = 0;
+    }
+
+    ipc_handle_request(client, &header, payload);
+    start += sizeof(header) + header.length;
+  }
+
+  memmove(client->in, client->in + start, client->in_length - start);
+  client->in_length -= start;
+
+  return true;
+}
+
+int
+ipc_handle_client_event(int fd, uint32_t mask, void *data) {
+  struct mwc_ipc_client *client = data;
+
+  if(mask & WL_EVENT_ERROR) {
+    ipc_client_destroy(client);
+    return 0;
+  }
+
+  /* handling requests can flush this client, which must not destroy it under us */
+  client->busy = true;
+
+  if((mask & WL_EVENT_READABLE) && !client->closing) {
+    bool eof = false;
+    while(true) {
+      /* a request always fits, so there is room as long as they are being handled */
+      ssize_t n = read(fd, client->in + client->in_length,
+                       sizeof(struct ipc_header) + IPC_MAX_REQUEST_LENGTH - client->in_length);
+      if(n < 0) {
+        if(errno == EINTR) continue;
+        if(errno != EAGAIN && errno != EWOULDBLOCK) eof = true;
+        break;
+      }
+      if(n == 0) {
+        eof = true;
+        break;
+      }
+
+      client->in_length += n;
+      if(!ipc_client_handle_requests(client)) break;
+      /* the rest is read once the replies are written, see ipc_client_mask() */
+      if(client->closing || ipc_client_backlogged(client)) break;
+    }
+
+    if(eof) {
+      /* subscribers are closed right away, nobody is reading anymore */
+      if(client->subscribed) {
+        ipc_client_destroy(client);
+        return 0;
+      }
+
+      /* a request cut off by the end of the stream is ignored */
+      client->closing = true;
+    }
+  }
+
+  client->busy = false;
+  ipc_client_flush(client);
+  return 0;
+}
+
+int
+ipc_handle_connection(int fd, uint32_t mask, void *data) {
+  while(true) {
+    int client_fd = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if(client_fd == -1) {
+      if(errno == EINTR) continue;
+      if(errno != EAGAIN && errno != EWOULDBLOCK) {
+        wlr_log(WLR_ERROR, "ipc: accept failed: %s", strerror(errno));
+      }
+      break;
+    }
+
+    wlr_log(WLR_INFO, "ipc: new client on fd: %d", client_fd);
+
+    struct mwc_ipc_client *client = calloc(1, sizeof(*client));
+    client->fd = client_fd;
+    client->out_fd = -1;
+    client->in = malloc(sizeof(struct ipc_header) + IPC_MAX_REQUEST_LENGTH);
+    client->source = wl_event_loop_add_fd(server.wl_event_loop, client_fd, WL_EVENT_READABLE,
+                                          ipc_handle_client_event, client);
+
+    wl_list_insert(&server.ipc_clients, &client->link);
+  }
+
+  return 0;
+}
+
+bool
+ipc_init(const char *path) {
+  wl_list_init(&server.ipc_clients);
+  for(size_t i = 0; i < IPC_EVENT_COUNT; i++) {
+    wl_list_init(&server.ipc_subscribers[i]);
+  }
+  wl_list_init(&server.ipc_pending_toplevels);
+
+  struct sockaddr_un address = {0};
+  if(strlen(path) >= sizeof(address.sun_path)) {
+    wlr_log(WLR_ERROR, "ipc: socket path '%s' is too long", path);
+    return false;
+  }
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, path);
+  strcpy(server.ipc_path, path);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if(fd == -1) goto no_close;
+
+  /* a socket left over from a crash would make bind fail */
+  unlink(server.ipc_path);
+
+  if(bind(fd, (struct sockaddr *)&address, sizeof(address))) goto error;
+  if(listen(fd, 128) == -1) goto error;
+
+  server.ipc_fd = fd;
+  server.ipc_source = wl_event_loop_add_fd(server.wl_event_loop, fd, WL_EVENT_READABLE,
+                                           ipc_handle_connection, NULL);
+  server.ipc_pending_timer = wl_event_loop_add_timer(server.wl_event_loop,
+                                                     ipc_handle_pending_timer, NULL);
+  server.ipc_running = true;
+  setenv(IPC_SOCKET_ENV, server.ipc_path, true);
+
+  return true;
+
 error:
   wlr_log(WLR_ERROR, "ipc: %s", strerror(errno));
   close(fd);
 no_close:
-  unlink(IPC_PATH);
-  return NULL;
+  unlink(server.ipc_path);
+  return false;
+}
+
+void
+ipc_finish(void) {
+  if(!server.ipc_running) return;
+
+  struct mwc_ipc_client *client, *tmp;
+  wl_list_for_each_safe(client, tmp, &server.ipc_clients, link) {
+    ipc_client_destroy(client);
+  }
+
+  if(server.ipc_pending_idle != NULL) {
+    wl_event_source_remove(server.ipc_pending_idle);
+  }
+  wl_event_source_remove(server.ipc_pending_timer);
+  shm_state_finish();
+  wl_event_source_remove(server.ipc_source);
+  close(server.ipc_fd);
+  unlink(server.ipc_path);
+
+  ipc_writer_finish(&server.ipc_reply_writer);
+  ipc_writer_finish(&server.ipc_state_writer);
+  for(size_t i = 0; i < IPC_ENCODING_COUNT; i++) {
+    ipc_writer_finish(&server.ipc_event_writers[i]);
+  }
+
+  server.ipc_running = false;
 }
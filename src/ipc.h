@@ -1,13 +1,156 @@
+#pragma once
+
 #include "ipc_shared.h"
+#include "ipc_writer.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <wayland-server-core.h>
 
 enum ipc_event {
   IPC_ACTIVE_WORKSPACE,
   IPC_ACTIVE_TOPLEVEL,
+  /* these carry a toplevel, see ipc_broadcast_toplevel() */
+  IPC_TOPLEVEL_MAP,
+  IPC_TOPLEVEL_UNMAP,
+  IPC_TOPLEVEL_TITLE,
+  IPC_TOPLEVEL_APP_ID,
+  IPC_TOPLEVEL_WORKSPACE,
+  IPC_TOPLEVEL_FLOATING,
+  IPC_TOPLEVEL_FULLSCREEN,
+  IPC_TOPLEVEL_GEOMETRY,
+  /* these carry an output, see ipc_broadcast_output() */
+  IPC_OUTPUT_ADD,
+  IPC_OUTPUT_REMOVE,
+  IPC_CONFIG_RELOAD,
   IPC_EVENT_COUNT,
 };
 
+struct mwc_ipc_client;
+struct mwc_output;
+struct mwc_toplevel;
+
+/* links a client into the list of subscribers of one event type */
+struct mwc_ipc_subscription {
+  /* NULL if the client is not subscribed */
+  struct mwc_ipc_client *client;
+  struct wl_list link;
+};
+
+struct mwc_ipc_client {
+  int fd;
+  struct wl_event_source *source;
+  struct wl_list link;
+
+  /* receives events from ipc_broadcast_message(), at least of one type */
+  bool subscribed;
+  struct mwc_ipc_subscription subscriptions[IPC_EVENT_COUNT];
+  /* the client is done writing, it is closed once everything is sent */
+  bool closing;
+  /* its requests are being handled right now */
+  bool busy;
+
+  /* events are sent with the id and encoding of the subscribe request */
+  uint32_t subscribe_id;
+  enum ipc_encoding encoding;
+
+  /* room for a header and the longest request */
+  char *in;
+  size_t in_length;
+
+  /* whole messages, see util/ipc_shared.h */
+  char *out;
+  size_t out_length;
+  size_t out_cap;
+  /* how much of out is sent already, it never reaches past the first message */
+  size_t out_sent;
+  /* a file descriptor that goes with the first byte of the message at out_fd_offset,
+   * -1 if there is none. only one can wait at a time */
+  int out_fd;
+  size_t out_fd_offset;
+
+  /* events that were thrown away or replaced, see ipc_backpressure in the config */
+  uint64_t dropped;
+  uint64_t coalesced;
+  /* the queue is being refilled with the current state, which must not coalesce again */
+  bool coalescing;
+  /* events queued now get IPC_MESSAGE_STATE, see ipc_client_send_state() */
+  bool sending_state;
+};
+
+/* events that only describe the current state of something are not sent right away,
+ * they wait for ipc_coalesce_ms and are sent once, with the state at that time.
+ * other events are sent immediately, after everything that waits */
 void
 ipc_broadcast_message(enum ipc_event event);
 
-void *
-ipc_run(void *args);
+/* every toplevel event carries the full description of the toplevel, with its id */
+void
+ipc_broadcast_toplevel(enum ipc_event event, struct mwc_toplevel *toplevel);
+
+void
+ipc_broadcast_output(enum ipc_event event, struct mwc_output *output);
+
+/* throws away everything that is waiting to be written and closes the client */
+void
+ipc_client_abandon(struct mwc_ipc_client *client, const char *reason);
+
+/* appends a message to the outgoing buffer of the client, see ipc_client_flush().
+ * if there is no memory for it, the client is abandoned and false returned */
+bool
+ipc_client_write_message(struct mwc_ipc_client *client, enum ipc_message_type type, uint32_t id,
+                         enum ipc_encoding encoding, const char *payload, uint32_t length);
+
+/* like ipc_client_write_message(), with fd attached to the message. the client owns fd then */
+void
+ipc_client_write_message_with_fd(struct mwc_ipc_client *client, enum ipc_message_type type,
+                                 uint32_t id, enum ipc_encoding encoding, const char *payload,
+                                 uint32_t length, int fd);
+
+/* queues an event for a subscriber without allocating; once ipc_buffer_size
+ * bytes are waiting, the configured backpressure policy is applied */
+void
+ipc_client_queue_event(struct mwc_ipc_client *client, enum ipc_event event,
+                       const char *payload, uint32_t length);
+
+/* writes as much as the socket takes without blocking, the rest is written
+ * when it becomes writable. the client may be destroyed after this */
+void
+ipc_client_flush(struct mwc_ipc_client *client);
+
+/* what to wait for on the socket of the client */
+uint32_t
+ipc_client_mask(struct mwc_ipc_client *client);
+
+/* true while more than ipc_buffer_size bytes are waiting to be written. no more
+ * requests are read then, so replies cannot pile up without bound */
+bool
+ipc_client_backlogged(struct mwc_ipc_client *client);
+
+void
+ipc_client_destroy(struct mwc_ipc_client *client);
+
+/* sends all the coalesced events now */
+void
+ipc_send_pending(void);
+
+int
+ipc_handle_pending_idle(void *data);
+
+int
+ipc_handle_pending_timer(void *data);
+
+int
+ipc_handle_client_event(int fd, uint32_t mask, void *data);
+
+int
+ipc_handle_connection(int fd, uint32_t mask, void *data);
+
+/* starts listening on path, everything runs on the wayland event loop. the path is
+ * exported as IPC_SOCKET_ENV, so programs started by the compositor find it */
+bool
+ipc_init(const char *path);
+
+void
+ipc_finish(void);
@@ -0,0 +1,228 @@
+#include "ipc_writer.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void
+ipc_writer_reserve(struct ipc_writer *writer, size_t length) {
+  if(writer->length + length <= writer->cap) return;
+
+  size_t cap = writer->cap == 0 ? 256 : writer->cap;
+  while(cap < writer->length + length) {
+    cap *= 2;
+  }
+
+  writer->data = realloc(writer->data, cap);
+  writer->cap = cap;
+}
+
+void
+ipc_writer_append(struct ipc_writer *writer, const void *data, size_t length) {
+  ipc_writer_reserve(writer, length);
+  memcpy(writer->data + writer->length, data, length);
+  writer->length += length;
+}
+
+void
+ipc_writer_append_tag(struct ipc_writer *writer, enum ipc_binary_tag tag) {
+  uint8_t byte = tag;
+  ipc_writer_append(writer, &byte, 1);
+}
+
+/* called before every value and key, adds the comma json needs */
+void
+ipc_writer_value_begin(struct ipc_writer *writer) {
+  if(writer->after_key) {
+    writer->after_key = false;
+    return;
+  }
+
+  if(writer->encoding == IPC_ENCODING_JSON && writer->written[writer->depth]) {
+    ipc_writer_append(writer, ",", 1);
+  }
+  writer->written[writer->depth] = true;
+}
+
+void
+ipc_writer_reset(struct ipc_writer *writer, enum ipc_encoding encoding) {
+  writer->encoding = encoding;
+  writer->length = 0;
+  writer->depth = 0;
+  writer->written[0] = false;
+  writer->after_key = false;
+}
+
+void
+ipc_writer_finish(struct ipc_writer *writer) {
+  free(writer->data);
+  writer->data = NULL;
+  writer->length = 0;
+  writer->cap = 0;
+}
+
+void
+ipc_writer_container_begin(struct ipc_writer *writer, char json, enum ipc_binary_tag tag) {
+  assert(writer->depth + 1 < IPC_WRITER_MAX_DEPTH);
+
+  ipc_writer_value_begin(writer);
+  if(writer->encoding == IPC_ENCODING_JSON) {
+    ipc_writer_append(writer, &json, 1);
+  } else {
+    ipc_writer_append_tag(writer, tag);
+  }
+
+  writer->depth++;
+  writer->written[writer->depth] = false;
+}
+
+void
+ipc_writer_container_end(struct ipc_writer *writer, char json) {
+  assert(writer->depth > 0);
+
+  writer->depth--;
+  if(writer->encoding == IPC_ENCODING_JSON) {
+    ipc_writer_append(writer, &json, 1);
+  } else {
+    ipc_writer_append_tag(writer, IPC_BINARY_END);
+  }
+}
+
+void
+ipc_writer_object_begin(struct ipc_writer *writer) {
+  ipc_writer_container_begin(writer, '{', IPC_BINARY_OBJECT);
+}
+
+void
+ipc_writer_object_end(struct ipc_writer *writer) {
+  ipc_writer_container_end(writer, '}');
+}
+
+void
+ipc_writer_array_begin(struct ipc_writer *writer) {
+  ipc_writer_container_begin(writer, '[', IPC_BINARY_ARRAY);
+}
+
+void
+ipc_writer_array_end(struct ipc_writer *writer) {
+  ipc_writer_container_end(writer, ']');
+}
+
+void
+ipc_writer_json_string(struct ipc_writer *writer, const char *value) {
+  ipc_writer_append(writer, "\"", 1);
+
+  const char *start = value;
+  for(const char *p = value; *p != 0; p++) {
+    unsigned char c = *p;
+    if(c != '"' && c != '\\' && c >= 0x20) continue;
+
+    ipc_writer_append(writer, start, p - start);
+    start = p + 1;
+
+    char escaped[8];
+    switch(c) {
+      case '"': ipc_writer_append(writer, "\\\"", 2); break;
+      case '\\': ipc_writer_append(writer, "\\\\", 2); break;
+      case '\n': ipc_writer_append(writer, "\\n", 2); break;
+      case '\t': ipc_writer_append(writer, "\\t", 2); break;
+      default: {
+        int length = snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+        ipc_writer_append(writer, escaped, length);
+      }
+    }
+  }
+
+  ipc_writer_append(writer, start, strlen(start));
+  ipc_writer_append(writer, "\"", 1);
+}
+
+void
+ipc_writer_raw_string(struct ipc_writer *writer, const char *value) {
+  if(writer->encoding == IPC_ENCODING_JSON) {
+    ipc_writer_json_string(writer, value);
+  } else {
+    uint32_t length = strlen(value);
+    ipc_writer_append_tag(writer, IPC_BINARY_STRING);
+    ipc_writer_append(writer, &length, sizeof(length));
+    ipc_writer_append(writer, value, length);
+  }
+}
+
+void
+ipc_writer_key(struct ipc_writer *writer, const char *key) {
+  ipc_writer_value_begin(writer);
+  ipc_writer_raw_string(writer, key);
+  if(writer->encoding == IPC_ENCODING_JSON) {
+    ipc_writer_append(writer, ":", 1);
+  }
+  writer->after_key = true;
+}
+
+void
+ipc_writer_string(struct ipc_writer *writer, const char *value) {
+  if(value == NULL) {
+    ipc_writer_null(writer);
+    return;
+  }
+
+  ipc_writer_value_begin(writer);
+  ipc_writer_raw_string(writer, value);
+}
+
+void
+ipc_writer_int(struct ipc_writer *writer, int64_t value) {
+  ipc_writer_value_begin(writer);
+  if(writer->encoding == IPC_ENCODING_JSON) {
+    char buffer[32];
+    int length = snprintf(buffer, sizeof(buffer), "%lld", (long long)value);
+    ipc_writer_append(writer, buffer, length);
+  } else {
+    ipc_writer_append_tag(writer, IPC_BINARY_INT);
+    ipc_writer_append(writer, &value, sizeof(value));
+  }
+}
+
+void
+ipc_writer_double(struct ipc_writer *writer, double value) {
+  if(!isfinite(value)) {
+    ipc_writer_null(writer);
+    return;
+  }
+
+  ipc_writer_value_begin(writer);
+  if(writer->encoding == IPC_ENCODING_JSON) {
+    char buffer[32];
+    int length = snprintf(buffer, sizeof(buffer), "%.6g", value);
+    ipc_writer_append(writer, buffer, length);
+  } else {
+    ipc_writer_append_tag(writer, IPC_BINARY_DOUBLE);
+    ipc_writer_append(writer, &value, sizeof(value));
+  }
+}
+
+void
+ipc_writer_bool(struct ipc_writer *writer, bool value) {
+  ipc_writer_value_begin(writer);
+  if(writer->encoding == IPC_ENCODING_JSON) {
+    if(value) {
+      ipc_writer_append(writer, "true", 4);
+    } else {
+      ipc_writer_append(writer, "false", 5);
+    }
+  } else {
+    ipc_writer_append_tag(writer, value ? IPC_BINARY_TRUE : IPC_BINARY_FALSE);
+  }
+}
+
+void
+ipc_writer_null(struct ipc_writer *writer) {
+  ipc_writer_value_begin(writer);
+  if(writer->encoding == IPC_ENCODING_JSON) {
+    ipc_writer_append(writer, "null", 4);
+  } else {
+    ipc_writer_append_tag(writer, IPC_BINARY_NULL);
+  }
+}
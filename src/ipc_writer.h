@@ -0,0 +1,65 @@
+#pragma once
+
+#include "ipc_shared.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* objects and arrays cannot be nested deeper than this */
+#define IPC_WRITER_MAX_DEPTH 16
+
+/* serializes values as json or binary into a buffer that only ever grows,
+ * so it can be reset and reused without allocating. keys and values are
+ * written in order, e.g. object_begin, key, int, key, string, object_end */
+struct ipc_writer {
+  enum ipc_encoding encoding;
+
+  char *data;
+  size_t length;
+  size_t cap;
+
+  uint32_t depth;
+  /* if something was written at each depth already, which needs a comma in json */
+  bool written[IPC_WRITER_MAX_DEPTH];
+  /* a key was just written, so the value does not get a comma */
+  bool after_key;
+};
+
+void
+ipc_writer_reset(struct ipc_writer *writer, enum ipc_encoding encoding);
+
+void
+ipc_writer_finish(struct ipc_writer *writer);
+
+void
+ipc_writer_object_begin(struct ipc_writer *writer);
+
+void
+ipc_writer_object_end(struct ipc_writer *writer);
+
+void
+ipc_writer_array_begin(struct ipc_writer *writer);
+
+void
+ipc_writer_array_end(struct ipc_writer *writer);
+
+void
+ipc_writer_key(struct ipc_writer *writer, const char *key);
+
+/* NULL is written as null */
+void
+ipc_writer_string(struct ipc_writer *writer, const char *value);
+
+void
+ipc_writer_int(struct ipc_writer *writer, int64_t value);
+
+/* nan and infinities are written as null, as json does not have them */
+void
+ipc_writer_double(struct ipc_writer *writer, double value);
+
+void
+ipc_writer_bool(struct ipc_writer *writer, bool value);
+
+void
+ipc_writer_null(struct ipc_writer *writer);
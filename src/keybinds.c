@@ -8,6 +8,8 @@
 #include "toplevel.h"
 #include "workspace.h"
 #include "layout.h"
+#include "ipc.h"
+#include "array.h"
 
 #include <stddef.h>
 #include <stdint.h>
@@ -39,30 +41,93 @@ server_handle_keybinds(struct mwc_keyboard *keyboard, uint32_t keycode,
   bool handled = handle_change_vt_key(syms, count);
   if(handled) return true;
 
-  struct keybind *k;
+  bool pressed = state == WL_KEYBOARD_KEY_STATE_PRESSED;
   for(size_t i = 0; i < count; i++) {
-    wl_list_for_each(k, &server.config->keybinds, link) {
-      if(!k->initialized) continue;
-
-      if(k->active && k->stop && syms[i] == k->key
-         && state == WL_KEYBOARD_KEY_STATE_RELEASED) {
-        k->active = false;
-        k->stop(k->args);
-        return true;
-      }
-
-      if(modifiers == k->modifiers && syms[i] == k->key
-         && state == WL_KEYBOARD_KEY_STATE_PRESSED) {
-        k->active = true;
-        k->action(k->args);
-        return true;
-      }
+    if(keybind_table_handle(&server.config->keybind_table, modifiers, syms[i], pressed)) {
+      return true;
     }
   }
 
   return false;
 }
 
+uint32_t
+keybind_hash(uint32_t modifiers, uint32_t key, uint32_t bucket_count) {
+  /* fibonacci hashing, bucket_count is always a power of two */
+  uint64_t h = (((uint64_t)modifiers << 32) | key) * 11400714819323198485ull;
+  return (h >> 32) & (bucket_count - 1);
+}
+
+void
+keybind_table_init(struct keybind_table *table, struct wl_list *keybinds) {
+  uint32_t count = wl_list_length(keybinds);
+
+  /* we keep the load factor under 0.5 */
+  table->bucket_count = 16;
+  while(table->bucket_count < 2 * count) {
+    table->bucket_count *= 2;
+  }
+
+  table->buckets = calloc(table->bucket_count, sizeof(*table->buckets));
+  array_init(&table->active);
+
+  /* keybinds with the same combination keep their list order in the bucket,
+   * so the first one in the list still wins */
+  struct keybind *k;
+  wl_list_for_each_reverse(k, keybinds, link) {
+    uint32_t bucket = keybind_hash(k->modifiers, k->key, table->bucket_count);
+    k->next = table->buckets[bucket];
+    table->buckets[bucket] = k;
+  }
+}
+
+void
+keybind_table_finish(struct keybind_table *table) {
+  free(table->buckets);
+  array_destroy(&table->active);
+}
+
+struct keybind *
+keybind_table_lookup(struct keybind_table *table, uint32_t modifiers, uint32_t key) {
+  uint32_t bucket = keybind_hash(modifiers, key, table->bucket_count);
+  for(struct keybind *k = table->buckets[bucket]; k != NULL; k = k->next) {
+    /* workspace keybinds are not initialized until their workspace exists */
+    if(k->initialized && k->modifiers == modifiers && k->key == key) return k;
+  }
+
+  return NULL;
+}
+
+bool
+keybind_table_handle(struct keybind_table *table, uint32_t modifiers, uint32_t key,
+                     bool pressed) {
+  if(!pressed) {
+    /* modifiers could have been released first, so only the key has to match */
+    for(size_t i = 0; i < array_len(table->active); i++) {
+      struct keybind *k = table->active[i];
+      if(k->key != key) continue;
+
+      array_remove(&table->active, i);
+      k->active = false;
+      k->stop(k->args);
+      return true;
+    }
+
+    return false;
+  }
+
+  struct keybind *k = keybind_table_lookup(table, modifiers, key);
+  if(k == NULL) return false;
+
+  if(k->stop != NULL && !k->active) {
+    k->active = true;
+    array_push(&table->active, k);
+  }
+
+  k->action(k->args);
+  return true;
+}
+
 bool
 handle_change_vt_key(const xkb_keysym_t *keysyms, size_t count) {
 	for(int i = 0; i < count; i++) {
@@ -143,7 +208,7 @@ keybind_resize_focused_toplevel(void *data) {
   }
   strcat(cursor_image, "corner");
 
-  wlr_cursor_set_xcursor(server.cursor, server.cursor_mgr, cursor_image);
+  cursor_set_xcursor(cursor_image);
 
   server.client_driven_move_resize = false;
   toplevel_start_resize(toplevel, edges);
@@ -170,7 +235,7 @@ keybind_move_focused_toplevel(void *data) {
   struct mwc_toplevel *toplevel = get_pointer_focused_toplevel();
   if(toplevel == NULL || toplevel->fullscreen) return;
 
-  wlr_cursor_set_xcursor(server.cursor, server.cursor_mgr, "hand1");
+  cursor_set_xcursor("hand1");
 
   server.client_driven_move_resize = false;
   toplevel_start_move(toplevel);
@@ -283,6 +348,7 @@ keybind_move_focus(void *data) {
         }
         struct mwc_toplevel *t = wl_container_of(next, t, link);
         focus_toplevel(t);
+        layout_scroll_to_toplevel(t);
         cursor_jump_focused_toplevel();
         return;
       }
@@ -296,6 +362,7 @@ keybind_move_focus(void *data) {
         }
         struct mwc_toplevel *t = wl_container_of(next, t, link);
         focus_toplevel(t);
+        layout_scroll_to_toplevel(t);
         cursor_jump_focused_toplevel();
         return;
       }
@@ -470,7 +537,7 @@ keybind_focused_toplevel_toggle_floating(void *data) {
     toplevel->floating = false;
     wl_list_remove(&toplevel->link);
 
-    if(wl_list_length(&toplevel->workspace->masters) < server.config->master_count) {
+    if(wl_list_length(&toplevel->workspace->masters) < layout_master_count(toplevel->workspace)) {
       wl_list_insert(toplevel->workspace->masters.prev, &toplevel->link);
     } else {
       wl_list_insert(toplevel->workspace->slaves.prev, &toplevel->link);
@@ -478,12 +545,16 @@ keybind_focused_toplevel_toggle_floating(void *data) {
 
     wlr_scene_node_reparent(&toplevel->scene_tree->node, server.tiled_tree);
     wlr_scene_node_raise_to_top(&toplevel->scene_tree->node);
+    server.scene_generation++;
 
     layout_set_pending_state(toplevel->workspace);
+    generation_toplevel_changed(toplevel);
+    ipc_broadcast_toplevel(IPC_TOPLEVEL_FLOATING, toplevel);
     return;
   }
 
   toplevel->floating = true;
+  toplevel_set_suspended(toplevel, false);
   if(toplevel_is_master(toplevel)) {
     if(!wl_list_empty(&toplevel->workspace->slaves)) {
       struct mwc_toplevel *s = wl_container_of(toplevel->workspace->slaves.prev, s, link);
@@ -503,8 +574,11 @@ keybind_focused_toplevel_toggle_floating(void *data) {
 
   wlr_scene_node_reparent(&toplevel->scene_tree->node, server.floating_tree);
   wlr_scene_node_raise_to_top(&toplevel->scene_tree->node);
+  server.scene_generation++;
 
   layout_set_pending_state(toplevel->workspace);
+  generation_toplevel_changed(toplevel);
+  ipc_broadcast_toplevel(IPC_TOPLEVEL_FLOATING, toplevel);
 }
 
 void
@@ -523,3 +597,31 @@ void
 keybind_reload_config(void *data) {
   config_reload();
 }
+
+void
+keybind_adjust_master_count(void *data) {
+  struct mwc_workspace *workspace = server.active_workspace;
+  if(server.grabbed_toplevel != NULL) return;
+
+  int64_t delta = (int64_t)data;
+  layout_set_master_count(workspace, max((int64_t)workspace->master_count + delta, 1));
+}
+
+void
+keybind_adjust_master_ratio(void *data) {
+  struct mwc_workspace *workspace = server.active_workspace;
+  if(server.grabbed_toplevel != NULL) return;
+
+  double delta = *(double*)data;
+  layout_set_master_ratio(workspace, workspace->master_ratio + delta);
+}
+
+void
+keybind_toggle_layout(void *data) {
+  struct mwc_workspace *workspace = server.active_workspace;
+  if(server.grabbed_toplevel != NULL) return;
+
+  layout_set_type(workspace, workspace->layout == MWC_LAYOUT_SCROLLING
+                  ? MWC_LAYOUT_MASTER
+                  : MWC_LAYOUT_SCROLLING);
+}
@@ -15,8 +15,32 @@ struct keybind {
   keybind_action_func_t stop;
   void *args;
   struct wl_list link;
+  /* next keybind in the same bucket of the keybind table */
+  struct keybind *next;
 };
 
+/* keybinds hashed by (modifiers, key), so a key press is a single lookup */
+struct keybind_table {
+  struct keybind **buckets;
+  uint32_t bucket_count;
+  /* pressed keybinds with a stop action, waiting for their key to be released */
+  struct keybind **active;
+};
+
+void
+keybind_table_init(struct keybind_table *table, struct wl_list *keybinds);
+
+void
+keybind_table_finish(struct keybind_table *table);
+
+struct keybind *
+keybind_table_lookup(struct keybind_table *table, uint32_t modifiers, uint32_t key);
+
+/* runs the keybind matching the key event, returns whether there was one */
+bool
+keybind_table_handle(struct keybind_table *table, uint32_t modifiers, uint32_t key,
+                     bool pressed);
+
 bool
 server_handle_keybinds(struct mwc_keyboard *keyboard,
                        uint32_t keycode,
@@ -75,3 +99,12 @@ keybind_focused_toplevel_toggle_fullscreen(void *data);
 
 void
 keybind_reload_config(void *data);
+
+void
+keybind_toggle_layout(void *data);
+
+void
+keybind_adjust_master_count(void *data);
+
+void
+keybind_adjust_master_ratio(void *data);
@@ -1,11 +1,15 @@
 #include "keyboard.h"
 
+#include "idle.h"
 #include "keybinds.h"
+#include "latency.h"
+#include "replay.h"
 #include "mwc.h"
 #include "config.h"
 
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 #include <wlr/types/wlr_seat.h>
 #include <wlr/util/log.h>
 #include <libinput.h>
@@ -35,8 +39,16 @@ void
 keyboard_handle_key(struct wl_listener *listener, void *data) {
   struct mwc_keyboard *keyboard = wl_container_of(listener, keyboard, key);
   struct wlr_keyboard_key_event *event = data;
+  record_event(MWC_RECORD_KEY, event->time_msec, &(struct mwc_record_key){
+    .keycode = event->keycode, .state = event->state,
+  }, sizeof(struct mwc_record_key));
 
   server.last_used_keyboard = keyboard;
+  idle_notify_activity();
+
+  if(event->state == WL_KEYBOARD_KEY_STATE_PRESSED) {
+    latency_mark_input(MWC_INPUT_KEYBOARD, event->time_msec);
+  }
 
   /* translate libinput keycode -> xkbcommon */
   uint32_t keycode = event->keycode + 8;
@@ -98,9 +110,26 @@ server_handle_new_keyboard(struct wlr_input_device *device) {
 }
 
 bool
-keyboard_configure(struct mwc_keyboard *keyboard) {
-  struct xkb_context *context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
-  if(context == NULL) return false;
+string_equal_or_null(const char *a, const char *b) {
+  if(a == NULL || b == NULL) return a == b;
+  return strcmp(a, b) == 0;
+}
+
+char *
+strdup_or_null(const char *s) {
+  return s == NULL ? NULL : strdup(s);
+}
+
+struct xkb_keymap *
+keyboard_get_keymap(void) {
+  /* every keyboard uses the same rules, so the keymap is compiled once and
+   * only recompiled when they change on reload */
+  if(server.keymap_cache.keymap != NULL
+     && string_equal_or_null(server.keymap_cache.layouts, server.config->keymap_layouts)
+     && string_equal_or_null(server.keymap_cache.variants, server.config->keymap_variants)
+     && string_equal_or_null(server.keymap_cache.options, server.config->keymap_options)) {
+    return server.keymap_cache.keymap;
+  }
 
   struct xkb_rule_names rule_names = {
     .layout = server.config->keymap_layouts,
@@ -108,32 +137,66 @@ keyboard_configure(struct mwc_keyboard *keyboard) {
     .options = server.config->keymap_options,
   };
 
-  struct xkb_keymap *keymap = xkb_keymap_new_from_names(context, &rule_names,
+  struct xkb_keymap *keymap = xkb_keymap_new_from_names(server.xkb_context, &rule_names,
                                                         XKB_KEYMAP_COMPILE_NO_FLAGS);
   if(keymap == NULL) {
     wlr_log(WLR_ERROR, "could not apply the desired configuration to the keyboard");
-    keymap = xkb_keymap_new_from_names(context, NULL,
+    keymap = xkb_keymap_new_from_names(server.xkb_context, NULL,
                                        XKB_KEYMAP_COMPILE_NO_FLAGS);
     if(keymap == NULL) {
       wlr_log(WLR_ERROR, "could not apply the default configuration to the keyboard");
-      return false;
+      return NULL;
     }
   }
 
-  wlr_keyboard_set_keymap(keyboard->wlr_keyboard, keymap);
-  xkb_keymap_unref(keymap);
-  xkb_context_unref(context);
+  keyboard_keymap_cache_finish();
 
-  if(keyboard->empty != NULL) {
-    xkb_state_unref(keyboard->empty);
-  }
+  server.keymap_cache.keymap = keymap;
+  server.keymap_cache.layouts = strdup_or_null(server.config->keymap_layouts);
+  server.keymap_cache.variants = strdup_or_null(server.config->keymap_variants);
+  server.keymap_cache.options = strdup_or_null(server.config->keymap_options);
+
+  return keymap;
+}
 
-  keyboard->empty = xkb_state_new(keymap);
+void
+keyboard_keymap_cache_finish(void) {
+  /* keyboards hold their own reference to the keymap */
+  xkb_keymap_unref(server.keymap_cache.keymap);
+  free(server.keymap_cache.layouts);
+  free(server.keymap_cache.variants);
+  free(server.keymap_cache.options);
+
+  server.keymap_cache.keymap = NULL;
+  server.keymap_cache.layouts = NULL;
+  server.keymap_cache.variants = NULL;
+  server.keymap_cache.options = NULL;
+}
+
+bool
+keyboard_configure(struct mwc_keyboard *keyboard) {
+  struct xkb_keymap *keymap = keyboard_get_keymap();
+  if(keymap == NULL) return false;
+
+  /* setting a keymap serializes it and sends it to every client, so we
+   * only do it when it actually changed */
+  if(keyboard->wlr_keyboard->keymap != keymap) {
+    wlr_keyboard_set_keymap(keyboard->wlr_keyboard, keymap);
+
+    if(keyboard->empty != NULL) {
+      xkb_state_unref(keyboard->empty);
+    }
+
+    keyboard->empty = xkb_state_new(keymap);
+  }
 
   uint32_t rate = server.config->keyboard_rate;
   uint32_t delay = server.config->keyboard_delay;
 
-  wlr_keyboard_set_repeat_info(keyboard->wlr_keyboard, rate, delay);
+  if(keyboard->wlr_keyboard->repeat_info.rate != (int32_t)rate
+     || keyboard->wlr_keyboard->repeat_info.delay != (int32_t)delay) {
+    wlr_keyboard_set_repeat_info(keyboard->wlr_keyboard, rate, delay);
+  }
 
   return true;
 }
@@ -25,5 +25,12 @@ keyboard_handle_key(struct wl_listener *listener, void *data);
 void
 keyboard_handle_destroy(struct wl_listener *listener, void *data);
 
+/* returns the keymap for the current config, shared between all the keyboards */
+struct xkb_keymap *
+keyboard_get_keymap(void);
+
+void
+keyboard_keymap_cache_finish(void);
+
 bool
 keyboard_configure(struct mwc_keyboard *keyboard);
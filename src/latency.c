@@ -0,0 +1,189 @@
+#include "latency.h"
+
+#include "mwc.h"
+#include "output.h"
+#include "toplevel.h"
+#include "workspace.h"
+
+#include <stdio.h>
+#include <time.h>
+#include <wayland-util.h>
+#include <wlr/types/wlr_cursor.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_output_layout.h>
+
+extern struct mwc_server server;
+
+/* input timestamps are milliseconds truncated to 32 bits, so we wrap the same way */
+bool
+latency_input_expired(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  uint32_t now_ms = now.tv_sec * 1000 + now.tv_nsec / 1000000;
+  return now_ms - server.latency_input.time_msec > LATENCY_INPUT_TIMEOUT_MS;
+}
+
+/* keyboard input goes to the focused toplevel, pointer input to the surface under the cursor */
+struct mwc_output *
+latency_input_output(enum mwc_input_type type) {
+  if(type == MWC_INPUT_KEYBOARD && server.focused_toplevel != NULL) {
+    return server.focused_toplevel->workspace->output;
+  }
+
+  struct wlr_output *wlr_output = wlr_output_layout_output_at(server.output_layout,
+                                                              server.cursor->x, server.cursor->y);
+  if(wlr_output != NULL && wlr_output->data != NULL) {
+    return wlr_output->data;
+  }
+  return server.active_workspace != NULL ? server.active_workspace->output : NULL;
+}
+
+void
+latency_mark_input(enum mwc_input_type type, uint32_t time_msec) {
+  /* we measure from the oldest input that is not on the screen yet */
+  if(server.latency_input.pending && !latency_input_expired()) return;
+
+  struct mwc_output *output = latency_input_output(type);
+  server.latency_input = (struct mwc_latency_input){
+    .pending = output != NULL,
+    .type = type,
+    .time_msec = time_msec,
+    .output = output,
+  };
+}
+
+/* frames without damage in between, like for a hardware cursor, do not matter,
+ * the sample waits for the commit of its output that shows the result */
+void
+latency_output_committed(struct mwc_output *output) {
+  if(!server.latency_input.pending || server.latency_input.output != output
+     || output->latency.waiting) return;
+
+  if(latency_input_expired()) {
+    server.latency_input.pending = false;
+    return;
+  }
+
+  output->latency.waiting = true;
+  output->latency.commit_seq = output->wlr_output->commit_seq;
+  output->latency.input = server.latency_input;
+
+  server.latency_input.pending = false;
+}
+
+void
+latency_output_destroyed(struct mwc_output *output) {
+  if(server.latency_input.output == output) {
+    server.latency_input.pending = false;
+    server.latency_input.output = NULL;
+  }
+}
+
+void
+latency_histogram_add(struct mwc_latency_histogram *histogram, uint32_t latency_ms) {
+  size_t bucket = 0;
+  while(bucket < LATENCY_BUCKET_COUNT - 1 && latency_ms >= (1u << bucket)) {
+    bucket++;
+  }
+
+  histogram->buckets[bucket]++;
+  histogram->count++;
+  histogram->total_ms += latency_ms;
+  histogram->max_ms = max(histogram->max_ms, latency_ms);
+}
+
+void
+latency_frame_drawn(struct mwc_output *output, struct timespec *start, struct timespec *end) {
+  struct mwc_frame_time *frame_time = &output->latency.frame_time;
+  uint32_t usec = (end->tv_sec - start->tv_sec) * 1000000 + (end->tv_nsec - start->tv_nsec) / 1000;
+
+  frame_time->count++;
+  frame_time->total_usec += usec;
+  frame_time->max_usec = max(frame_time->max_usec, usec);
+  frame_time->window_max_usec = max(frame_time->window_max_usec, usec);
+}
+
+void
+output_handle_present(struct wl_listener *listener, void *data) {
+  struct mwc_output *output = wl_container_of(listener, output, present);
+  struct wlr_output_event_present *event = data;
+
+  if(!output->latency.waiting || event->commit_seq != output->latency.commit_seq) return;
+
+  output->latency.waiting = false;
+  if(!event->presented || event->when == NULL) return;
+
+  /* input timestamps are milliseconds truncated to 32 bits, so we wrap the same way */
+  uint32_t presented_ms = event->when->tv_sec * 1000 + event->when->tv_nsec / 1000000;
+  uint32_t latency_ms = presented_ms - output->latency.input.time_msec;
+
+  latency_histogram_add(&output->latency.histograms[output->latency.input.type], latency_ms);
+}
+
+void
+latency_write(struct ipc_writer *writer) {
+  char *type_names[MWC_INPUT_TYPE_COUNT] = {
+    [MWC_INPUT_POINTER] = "pointer",
+    [MWC_INPUT_KEYBOARD] = "keyboard",
+  };
+
+  ipc_writer_array_begin(writer);
+
+  struct mwc_output *output;
+  wl_list_for_each(output, &server.outputs, link) {
+    for(size_t t = 0; t < MWC_INPUT_TYPE_COUNT; t++) {
+      struct mwc_latency_histogram *h = &output->latency.histograms[t];
+      double average = h->count > 0 ? (double)h->total_ms / h->count : 0;
+
+      ipc_writer_object_begin(writer);
+      ipc_writer_key(writer, "output");
+      ipc_writer_string(writer, output->wlr_output->name);
+      ipc_writer_key(writer, "type");
+      ipc_writer_string(writer, type_names[t]);
+      ipc_writer_key(writer, "count");
+      ipc_writer_int(writer, h->count);
+      ipc_writer_key(writer, "average_ms");
+      ipc_writer_double(writer, average);
+      ipc_writer_key(writer, "max_ms");
+      ipc_writer_int(writer, h->max_ms);
+      ipc_writer_key(writer, "buckets");
+      ipc_writer_array_begin(writer);
+      for(size_t i = 0; i < LATENCY_BUCKET_COUNT; i++) {
+        ipc_writer_int(writer, h->buckets[i]);
+      }
+      ipc_writer_array_end(writer);
+      ipc_writer_object_end(writer);
+    }
+  }
+
+  ipc_writer_array_end(writer);
+}
+
+void
+latency_write_frame_times(struct ipc_writer *writer, bool reset) {
+  ipc_writer_array_begin(writer);
+
+  struct mwc_output *output;
+  wl_list_for_each(output, &server.outputs, link) {
+    struct mwc_frame_time *f = &output->latency.frame_time;
+
+    ipc_writer_object_begin(writer);
+    ipc_writer_key(writer, "output");
+    ipc_writer_string(writer, output->wlr_output->name);
+    ipc_writer_key(writer, "count");
+    ipc_writer_int(writer, f->count);
+    ipc_writer_key(writer, "total_usec");
+    ipc_writer_int(writer, f->total_usec);
+    ipc_writer_key(writer, "max_usec");
+    ipc_writer_int(writer, f->max_usec);
+    ipc_writer_key(writer, "window_max_usec");
+    ipc_writer_int(writer, f->window_max_usec);
+    ipc_writer_object_end(writer);
+
+    if(reset) {
+      f->window_max_usec = 0;
+    }
+  }
+
+  ipc_writer_array_end(writer);
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "ipc_writer.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <wayland-server-core.h>
+
+/* buckets are powers of two in milliseconds: < 1, < 2, < 4 ... < 256 and the rest */
+#define LATENCY_BUCKET_COUNT 10
+/* input that has not changed anything on its output after this long never will,
+ * so whatever commit comes next is not its result */
+#define LATENCY_INPUT_TIMEOUT_MS 500
+
+struct mwc_output;
+
+enum mwc_input_type {
+  MWC_INPUT_POINTER,
+  MWC_INPUT_KEYBOARD,
+  MWC_INPUT_TYPE_COUNT,
+};
+
+struct mwc_latency_histogram {
+  uint64_t buckets[LATENCY_BUCKET_COUNT];
+  uint64_t count;
+  uint64_t total_ms;
+  uint32_t max_ms;
+};
+
+/* the oldest input that has not been shown yet */
+struct mwc_latency_input {
+  bool pending;
+  enum mwc_input_type type;
+  uint32_t time_msec;
+  /* the output of the surface the input went to, its result is shown there */
+  struct mwc_output *output;
+};
+
+/* how long drawing the frames of an output takes */
+struct mwc_frame_time {
+  uint64_t count;
+  uint64_t total_usec;
+  uint32_t max_usec;
+  /* the max since the window was last restarted, see latency_write_frame_times() */
+  uint32_t window_max_usec;
+};
+
+struct mwc_output_latency {
+  /* set when a commit of this output carries an input, until it is presented */
+  bool waiting;
+  uint32_t commit_seq;
+  struct mwc_latency_input input;
+
+  struct mwc_latency_histogram histograms[MWC_INPUT_TYPE_COUNT];
+  struct mwc_frame_time frame_time;
+};
+
+/* time_msec is the timestamp of the input event, CLOCK_MONOTONIC based */
+void
+latency_mark_input(enum mwc_input_type type, uint32_t time_msec);
+
+/* called after an output commit that changed something on the screen */
+void
+latency_output_committed(struct mwc_output *output);
+
+/* forgets input that was going to the output, it is going away */
+void
+latency_output_destroyed(struct mwc_output *output);
+
+/* start and end are CLOCK_MONOTONIC, around everything the frame handler did */
+void
+latency_frame_drawn(struct mwc_output *output, struct timespec *start, struct timespec *end);
+
+void
+output_handle_present(struct wl_listener *listener, void *data);
+
+/* writes an array with a histogram for every output and input type, bucket i
+ * counts latencies below 2^i ms and the last one everything else */
+void
+latency_write(struct ipc_writer *writer);
+
+/* writes an array with the frame times of every output, totals since it was added and
+ * the max of the current window. reset starts a new window after writing */
+void
+latency_write_frame_times(struct ipc_writer *writer, bool reset);
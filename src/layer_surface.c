@@ -7,6 +7,7 @@
 #include "mwc.h"
 #include "popup.h"
 #include "output.h"
+#include "pointer_constraint.h"
 #include "something.h"
 #include "layout.h"
 #include "toplevel.h"
@@ -81,6 +82,7 @@ layer_surface_handle_commit(struct wl_listener *listener, void *data) {
   if(!layer_surface->wlr_layer_surface->initialized) return;
 
   struct mwc_output *output = layer_surface->wlr_layer_surface->output->data;
+  server.scene_generation++;
 
   uint32_t committed = layer_surface->wlr_layer_surface->current.committed;
 	enum zwlr_layer_shell_v1_layer layer = layer_surface->wlr_layer_surface->current.layer;
@@ -120,6 +122,7 @@ layer_surface_handle_map(struct wl_listener *listener, void *data) {
   struct mwc_output *output = wlr_layer_surface->output->data;
 
   wlr_scene_node_raise_to_top(&layer_surface->scene->tree->node);
+  server.scene_generation++;
   if(server.config->blur) {
     struct layer_rule_blur *b;
     wl_list_for_each(b, &server.config->layer_rules.blur, link) {
@@ -144,6 +147,7 @@ layer_surface_handle_unmap(struct wl_listener *listener, void *data) {
   struct mwc_layer_surface *layer_surface = wl_container_of(listener, layer_surface, unmap);
 
   wl_list_remove(&layer_surface->link);
+  server.scene_generation++;
 
   struct mwc_output *output = layer_surface->wlr_layer_surface->output->data;
 
@@ -250,6 +254,7 @@ focus_layer_surface(struct mwc_layer_surface *layer_surface) {
     wlr_seat_keyboard_notify_enter(server.seat, layer_surface->wlr_layer_surface->surface,
                                    keyboard->keycodes, keyboard->num_keycodes, &keyboard->modifiers);
   }
+  cursor_update_constraint();
 }
 
 void
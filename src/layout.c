@@ -2,6 +2,7 @@
 
 #include "mwc.h"
 #include "config.h"
+#include "layout_math.h"
 #include "toplevel.h"
 #include "wlr/util/box.h"
 
@@ -12,49 +13,99 @@
 extern struct mwc_server server;
 
 void
-calculate_masters_dimensions(struct mwc_output *output, uint32_t master_count,
+layout_get_params(struct mwc_workspace *workspace, struct mwc_layout_params *params) {
+  *params = (struct mwc_layout_params){
+    .outer_gaps = server.config->outer_gaps,
+    .inner_gaps = server.config->inner_gaps,
+    .border_width = server.config->border_width,
+    .master_ratio = workspace->master_ratio,
+    .column_ratio = server.config->scrolling_column_ratio,
+  };
+}
+
+struct mwc_box
+layout_get_area(struct mwc_output *output) {
+  return (struct mwc_box){
+    .x = output->usable_area.x,
+    .y = output->usable_area.y,
+    .width = output->usable_area.width,
+    .height = output->usable_area.height,
+  };
+}
+
+void
+calculate_masters_dimensions(struct mwc_workspace *workspace, uint32_t master_count,
                              uint32_t slave_count, uint32_t *width, uint32_t *height) {
-  uint32_t outer_gaps = server.config->outer_gaps;
-  uint32_t inner_gaps = server.config->inner_gaps;
-  double master_ratio = server.config->master_ratio;
-  double border_width = server.config->border_width;
+  struct mwc_layout_params params;
+  layout_get_params(workspace, &params);
+  struct mwc_box area = layout_get_area(workspace->output);
+
+  layout_math_masters_dimensions(&params, &area, master_count, slave_count, width, height);
+}
+
+void
+calculate_slaves_dimensions(struct mwc_workspace *workspace, uint32_t slave_count,
+                            uint32_t *width, uint32_t *height) {
+  struct mwc_layout_params params;
+  layout_get_params(workspace, &params);
+  struct mwc_box area = layout_get_area(workspace->output);
+
+  layout_math_slaves_dimensions(&params, &area, slave_count, width, height);
+}
+
+void
+calculate_column_dimensions(struct mwc_workspace *workspace, uint32_t *width, uint32_t *height) {
+  struct mwc_layout_params params;
+  layout_get_params(workspace, &params);
+  struct mwc_box area = layout_get_area(workspace->output);
 
-  struct wlr_box output_box = output->usable_area;
+  layout_math_column_dimensions(&params, &area, width, height);
+}
 
-  uint32_t total_width = slave_count > 0
-    ? output_box.width * master_ratio
-    : output_box.width;
+uint32_t
+layout_column_slot_width(struct mwc_workspace *workspace) {
+  struct mwc_layout_params params;
+  layout_get_params(workspace, &params);
+  struct mwc_box area = layout_get_area(workspace->output);
 
-  uint32_t total_decorations = slave_count > 0
-    ? outer_gaps // left outer gaps
-      + master_count * 2 * border_width // all borders
-      + (master_count - 1) * 2 * inner_gaps // inner gaps between masters
-      + inner_gaps // right inner gaps 
-    : outer_gaps // left outer gaps
-      + master_count * 2 * border_width // all borders
-      + (master_count - 1) * 2 * inner_gaps // inner gaps between masters
-      + outer_gaps; // right outer gaps
+  return layout_math_column_slot_width(&params, &area);
+}
 
-  *width = (total_width - total_decorations) / master_count;
-  *height = output_box.height - 2 * outer_gaps - 2 * border_width;
+uint32_t
+layout_master_count(struct mwc_workspace *workspace) {
+  /* scrolling layout keeps every tiled toplevel on the strip, so there are no slaves */
+  if(workspace->layout == MWC_LAYOUT_SCROLLING) return UINT32_MAX;
+
+  return workspace->master_count;
 }
 
 void
-calculate_slaves_dimensions(struct mwc_output *output, uint32_t slave_count,
-                            uint32_t *width, uint32_t *height) {
-  uint32_t outer_gaps = server.config->outer_gaps;
-  uint32_t inner_gaps = server.config->inner_gaps;
-  double master_ratio = server.config->master_ratio;
-  double border_width = server.config->border_width;
+layout_set_master_count(struct mwc_workspace *workspace, uint32_t master_count) {
+  master_count = max(master_count, 1);
+  if(workspace->master_count == master_count) return;
 
-  struct wlr_box output_box = output->usable_area;
+  workspace->master_count = master_count;
+  generation_workspace_changed(workspace);
 
-  *width = output_box.width * (1 - master_ratio)
-    - outer_gaps - inner_gaps
-    - 2 * border_width;
-  *height = (output_box.height - 2 * outer_gaps
-    - (slave_count - 1) * 2 * inner_gaps
-    - slave_count * 2 * border_width) / slave_count;
+  /* the scrolling layout does not have slaves, it will be applied when switching back */
+  if(workspace->layout != MWC_LAYOUT_MASTER) return;
+
+  layout_reorganize(workspace);
+  layout_set_pending_state(workspace);
+}
+
+void
+layout_set_master_ratio(struct mwc_workspace *workspace, double master_ratio) {
+  master_ratio = clamp(master_ratio, 0.05, 0.95);
+  if(workspace->master_ratio == master_ratio) return;
+
+  workspace->master_ratio = master_ratio;
+  generation_workspace_changed(workspace);
+
+  /* without slaves masters take the whole output anyway */
+  if(workspace->layout != MWC_LAYOUT_MASTER || wl_list_empty(&workspace->slaves)) return;
+
+  layout_set_pending_state(workspace);
 }
 
 bool
@@ -83,65 +134,142 @@ layout_set_pending_state(struct mwc_workspace *workspace) {
   /* if there are no masters we are done */
   if(wl_list_empty(&workspace->masters)) return;
 
-  struct mwc_output *output = workspace->output;
+  if(workspace->layout == MWC_LAYOUT_SCROLLING) {
+    layout_scrolling_set_pending_state(workspace);
+    return;
+  }
 
-  uint32_t outer_gaps = server.config->outer_gaps;
-  uint32_t inner_gaps = server.config->inner_gaps;
-  double master_ratio = server.config->master_ratio;
-  double border_width = server.config->border_width;
+  struct mwc_layout_params params;
+  layout_get_params(workspace, &params);
+  struct mwc_box area = layout_get_area(workspace->output);
 
   uint32_t slave_count = wl_list_length(&workspace->slaves);
   uint32_t master_count = wl_list_length(&workspace->masters);
 
-  uint32_t master_width, master_height;
-  calculate_masters_dimensions(output, master_count, slave_count,
-                               &master_width, &master_height);
-
   struct mwc_toplevel *m;
   size_t i = 0;
   wl_list_for_each(m, &workspace->masters, link) {
-    uint32_t master_x = output->usable_area.x + outer_gaps
-      + (master_width + 2 * border_width) * i
-      + 2 * inner_gaps * i
-      + border_width;
-    uint32_t master_y = output->usable_area.y + outer_gaps
-      + border_width;
-
-    toplevel_set_pending_state(m, master_x, master_y, master_width, master_height);
+    struct mwc_box box = layout_math_master_box(&params, &area, master_count, slave_count, i);
+
+    /* toplevels could be left culled after switching from the scrolling layout */
+    if(m->suspended) {
+      toplevel_set_suspended(m, false);
+    }
+
+    toplevel_set_pending_state(m, box.x, box.y, box.width, box.height);
     i++;
   }
 
   if(slave_count == 0) return;
 
   /* share the remaining space among slaves */
-  uint32_t slave_width, slave_height, slave_x, slave_y;
-  calculate_slaves_dimensions(workspace->output, slave_count, &slave_width, &slave_height);
-
   struct mwc_toplevel *s;
   i = 0;
   wl_list_for_each(s, &workspace->slaves, link) {
-    slave_x = output->usable_area.x + output->usable_area.width * master_ratio
-      + inner_gaps + border_width;
-    slave_y = output->usable_area.y + outer_gaps
-      + i * (slave_height + inner_gaps * 2 + 2 * border_width)
-      + border_width;
+    struct mwc_box box = layout_math_slave_box(&params, &area, slave_count, i);
+
+    if(s->suspended) {
+      toplevel_set_suspended(s, false);
+    }
+
+    toplevel_set_pending_state(s, box.x, box.y, box.width, box.height);
+    i++;
+  }
+}
+
+void
+layout_scrolling_set_pending_state(struct mwc_workspace *workspace) {
+  struct mwc_layout_params params;
+  layout_get_params(workspace, &params);
+  struct mwc_box area = layout_get_area(workspace->output);
+
+  /* toplevels could have been removed from the strip, so we dont want to
+   * leave the viewport scrolled past its end */
+  uint32_t column_count = wl_list_length(&workspace->masters);
+  workspace->scroll_offset = layout_math_clamp_scroll_offset(&params, &area, column_count,
+                                                             workspace->scroll_offset);
+
+  struct mwc_toplevel *t;
+  size_t i = 0;
+  wl_list_for_each(t, &workspace->masters, link) {
+    struct mwc_box box = layout_math_column_box(&params, &area, workspace->scroll_offset, i);
 
-    toplevel_set_pending_state(s, slave_x, slave_y, slave_width, slave_height);
+    /* columns that are completely outside of the usable area are not drawn,
+     * and their clients are told they are suspended so they can stop rendering */
+    toplevel_set_suspended(t, !layout_math_box_visible(&params, &area, &box));
+
+    toplevel_set_pending_state(t, box.x, box.y, box.width, box.height);
     i++;
   }
 }
 
-/* this function assumes they are in the same workspace and
- * that t2 comes after t1 if in the same list */
+void
+layout_scroll_to_toplevel(struct mwc_toplevel *toplevel) {
+  struct mwc_workspace *workspace = toplevel->workspace;
+  if(workspace->layout != MWC_LAYOUT_SCROLLING || toplevel->floating
+     || toplevel->fullscreen) return;
+
+  struct mwc_output *output = workspace->output;
+
+  uint32_t slot_width = layout_column_slot_width(workspace);
+  int32_t view_width = output->usable_area.width - 2 * server.config->outer_gaps;
+
+  int32_t slot_start = 0;
+  struct mwc_toplevel *t;
+  wl_list_for_each(t, &workspace->masters, link) {
+    if(t == toplevel) break;
+    slot_start += slot_width;
+  }
+  int32_t slot_end = slot_start + slot_width;
+
+  int32_t offset = workspace->scroll_offset;
+  if(slot_start < offset) {
+    offset = slot_start;
+  } else if(slot_end > offset + view_width) {
+    offset = slot_end - view_width;
+  }
+
+  if(offset == workspace->scroll_offset) return;
+
+  workspace->scroll_offset = offset;
+  layout_set_pending_state(workspace);
+}
+
+void
+layout_reorganize(struct mwc_workspace *workspace) {
+  /* the master layout takes slaves back from where it put the masters it had too many of,
+   * so changing the master count back and forth leaves the order alone. the scrolling
+   * layout takes all of them, from the front so they keep their order on the strip */
+  layout_math_rebalance(&workspace->masters, &workspace->slaves, layout_master_count(workspace),
+                        workspace->layout == MWC_LAYOUT_SCROLLING);
+}
+
+void
+layout_set_type(struct mwc_workspace *workspace, enum mwc_layout_type type) {
+  if(workspace->layout == type) return;
+
+  workspace->layout = type;
+  workspace->scroll_offset = 0;
+  generation_workspace_changed(workspace);
+
+  layout_reorganize(workspace);
+  layout_set_pending_state(workspace);
+
+  if(server.focused_toplevel != NULL && server.focused_toplevel->workspace == workspace) {
+    layout_scroll_to_toplevel(server.focused_toplevel);
+  }
+}
+
+/* this function assumes they are in the same workspace */
 void
 layout_swap_tiled_toplevels(struct mwc_toplevel *t1, struct mwc_toplevel *t2) {
-  struct wl_list *before_t1 = t1->link.prev;
-  wl_list_remove(&t1->link);
-  wl_list_insert(&t2->link, &t1->link);
-  wl_list_remove(&t2->link);
-  wl_list_insert(before_t1, &t2->link);
+  layout_math_swap(&t1->link, &t2->link);
 
   layout_set_pending_state(t1->workspace);
+
+  if(server.focused_toplevel == t1 || server.focused_toplevel == t2) {
+    layout_scroll_to_toplevel(server.focused_toplevel);
+  }
 }
 
 struct mwc_toplevel *
@@ -184,6 +312,28 @@ layout_find_closest_tiled_toplevel(struct mwc_workspace *workspace, bool master,
 struct mwc_toplevel *
 layout_toplevel_at(struct mwc_workspace *workspace, uint32_t x, uint32_t y) {
   struct mwc_toplevel *t;
+  if(workspace->layout == MWC_LAYOUT_SCROLLING) {
+    uint32_t decorations_x = server.config->inner_gaps + server.config->border_width;
+    uint32_t decorations_y = server.config->outer_gaps + server.config->border_width;
+
+    wl_list_for_each(t, &workspace->masters, link) {
+      if(t->suspended) continue;
+
+      struct wlr_box box = {
+        .x = t->current.x - decorations_x,
+        .y = t->current.y - decorations_y,
+        .width = t->current.width + 2 * decorations_x + 1,
+        .height = t->current.height + 2 * decorations_y + 1,
+      };
+
+      if(wlr_box_contains_point(&box, x, y)) {
+        return t;
+      }
+    }
+
+    return NULL;
+  }
+
   wl_list_for_each(t, &workspace->masters, link) {
     uint32_t decorations_left = t->link.prev == &workspace->masters
       ? server.config->outer_gaps + server.config->border_width
@@ -2,17 +2,43 @@
 
 #include "output.h"
 #include "mwc.h"
+#include "layout_math.h"
 
 #include <stdint.h>
 
+/* fills the layout parameters from the config and the workspace */
 void
-calculate_masters_dimensions(struct mwc_output *output, uint32_t master_count,
+layout_get_params(struct mwc_workspace *workspace, struct mwc_layout_params *params);
+
+struct mwc_box
+layout_get_area(struct mwc_output *output);
+
+void
+calculate_masters_dimensions(struct mwc_workspace *workspace, uint32_t master_count,
                              uint32_t slave_count, uint32_t *width, uint32_t *height);
 
 void
-calculate_slaves_dimensions(struct mwc_output *output, uint32_t slave_count,
+calculate_slaves_dimensions(struct mwc_workspace *workspace, uint32_t slave_count,
                             uint32_t *width, uint32_t *height);
 
+void
+calculate_column_dimensions(struct mwc_workspace *workspace, uint32_t *width, uint32_t *height);
+
+uint32_t
+layout_column_slot_width(struct mwc_workspace *workspace);
+
+/* how many toplevels should be kept in the masters list of this workspace */
+uint32_t
+layout_master_count(struct mwc_workspace *workspace);
+
+/* these change the layout of a single workspace at runtime, until the next
+ * config reload that changes the same option */
+void
+layout_set_master_count(struct mwc_workspace *workspace, uint32_t master_count);
+
+void
+layout_set_master_ratio(struct mwc_workspace *workspace, double master_ratio);
+
 bool
 toplevel_is_master(struct mwc_toplevel *toplevel);
 
@@ -22,8 +48,22 @@ toplevel_is_slave(struct mwc_toplevel *toplevel);
 void
 layout_set_pending_state(struct mwc_workspace *workspace);
 
-/* this function assumes they are in the same workspace and
- * that t2 comes after t1 if in the same list */
+void
+layout_scrolling_set_pending_state(struct mwc_workspace *workspace);
+
+/* scrolls the workspace so the column of this toplevel is fully visible */
+void
+layout_scroll_to_toplevel(struct mwc_toplevel *toplevel);
+
+/* moves toplevels between masters and slaves until there are as many
+ * masters as the workspace layout wants */
+void
+layout_reorganize(struct mwc_workspace *workspace);
+
+void
+layout_set_type(struct mwc_workspace *workspace, enum mwc_layout_type type);
+
+/* this function assumes they are in the same workspace */
 void
 layout_swap_tiled_toplevels(struct mwc_toplevel *t1,
                             struct mwc_toplevel *t2);
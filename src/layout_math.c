@@ -0,0 +1,237 @@
+#include "layout_math.h"
+
+#include <stdint.h>
+#include <wayland-util.h>
+
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#define min(a, b) ((a) < (b) ? (a) : (b))
+
+/* sizes are computed as signed, so too many toplevels for the area give us
+ * a 1 pixel wide toplevel instead of a wrapped around huge one */
+uint32_t
+layout_math_positive(int64_t value) {
+  return value > 0 ? value : 1;
+}
+
+void
+layout_math_split(int64_t start, int64_t length, uint32_t count, uint32_t index,
+                  int64_t gap, int64_t border, int32_t *part_start, uint32_t *part_size) {
+  int64_t size = (length - (count - 1) * 2 * gap - count * 2 * border) / count;
+  if(size >= 1) {
+    *part_start = start + index * (size + 2 * gap + 2 * border) + border;
+    *part_size = size;
+    return;
+  }
+
+  /* gaps and borders do not leave a pixel for every part, so they are left out
+   * and the parts share the length as evenly as they can */
+  int64_t begin = start + index * length / count;
+  int64_t end = start + (index + 1) * length / count;
+  *part_start = begin;
+  *part_size = layout_math_positive(end - begin);
+}
+
+/* the span the masters are split along horizontally */
+void
+layout_math_masters_span(struct mwc_layout_params *params, struct mwc_box *area,
+                         uint32_t slave_count, int64_t *start, int64_t *length) {
+  int64_t outer_gaps = params->outer_gaps;
+  int64_t inner_gaps = params->inner_gaps;
+
+  /* with slaves the right edge is an inner gap, next to them */
+  *start = area->x + outer_gaps;
+  *length = slave_count > 0
+    ? (int64_t)(area->width * params->master_ratio) - outer_gaps - inner_gaps
+    : area->width - 2 * outer_gaps;
+}
+
+void
+layout_math_masters_dimensions(struct mwc_layout_params *params, struct mwc_box *area,
+                               uint32_t master_count, uint32_t slave_count,
+                               uint32_t *width, uint32_t *height) {
+  struct mwc_box box = layout_math_master_box(params, area, master_count, slave_count, 0);
+  *width = box.width;
+  *height = box.height;
+}
+
+void
+layout_math_slaves_dimensions(struct mwc_layout_params *params, struct mwc_box *area,
+                              uint32_t slave_count, uint32_t *width, uint32_t *height) {
+  struct mwc_box box = layout_math_slave_box(params, area, slave_count, 0);
+  *width = box.width;
+  *height = box.height;
+}
+
+void
+layout_math_column_dimensions(struct mwc_layout_params *params, struct mwc_box *area,
+                              uint32_t *width, uint32_t *height) {
+  struct mwc_box box = layout_math_column_box(params, area, 0, 0);
+  *width = box.width;
+  *height = box.height;
+}
+
+uint32_t
+layout_math_column_slot_width(struct mwc_layout_params *params, struct mwc_box *area) {
+  /* each column takes a slot of this width on the strip, including its gaps and borders */
+  return layout_math_positive((area->width - 2 * (int64_t)params->outer_gaps)
+                              * params->column_ratio);
+}
+
+struct mwc_box
+layout_math_master_box(struct mwc_layout_params *params, struct mwc_box *area,
+                       uint32_t master_count, uint32_t slave_count, uint32_t index) {
+  int64_t start, length;
+  layout_math_masters_span(params, area, slave_count, &start, &length);
+
+  struct mwc_box box;
+  uint32_t width, height;
+  layout_math_split(start, length, master_count, index,
+                    params->inner_gaps, params->border_width, &box.x, &width);
+  layout_math_split(area->y + (int64_t)params->outer_gaps, area->height - 2 * (int64_t)params->outer_gaps,
+                    1, 0, params->inner_gaps, params->border_width, &box.y, &height);
+  box.width = width;
+  box.height = height;
+  return box;
+}
+
+struct mwc_box
+layout_math_slave_box(struct mwc_layout_params *params, struct mwc_box *area,
+                      uint32_t slave_count, uint32_t index) {
+  int64_t outer_gaps = params->outer_gaps;
+  int64_t inner_gaps = params->inner_gaps;
+  int64_t masters_width = (int64_t)(area->width * params->master_ratio);
+
+  struct mwc_box box;
+  uint32_t width, height;
+  layout_math_split(area->x + masters_width + inner_gaps,
+                    area->width - masters_width - outer_gaps - inner_gaps,
+                    1, 0, inner_gaps, params->border_width, &box.x, &width);
+  layout_math_split(area->y + outer_gaps, area->height - 2 * outer_gaps, slave_count, index,
+                    inner_gaps, params->border_width, &box.y, &height);
+  box.width = width;
+  box.height = height;
+  return box;
+}
+
+int32_t
+layout_math_clamp_scroll_offset(struct mwc_layout_params *params, struct mwc_box *area,
+                                uint32_t column_count, int32_t scroll_offset) {
+  int64_t slot_width = layout_math_column_slot_width(params, area);
+  int64_t view_width = area->width - 2 * (int64_t)params->outer_gaps;
+
+  int64_t max_offset = max(column_count * slot_width - view_width, 0);
+  return min(max(scroll_offset, 0), max_offset);
+}
+
+struct mwc_box
+layout_math_column_box(struct mwc_layout_params *params, struct mwc_box *area,
+                       int32_t scroll_offset, uint32_t index) {
+  int64_t outer_gaps = params->outer_gaps;
+  int64_t inner_gaps = params->inner_gaps;
+  int64_t slot_width = layout_math_column_slot_width(params, area);
+
+  /* the gaps of a column are inside of its slot */
+  struct mwc_box box;
+  uint32_t width, height;
+  layout_math_split(area->x + outer_gaps + index * slot_width - scroll_offset + inner_gaps,
+                    slot_width - 2 * inner_gaps, 1, 0, inner_gaps, params->border_width,
+                    &box.x, &width);
+  layout_math_split(area->y + outer_gaps, area->height - 2 * outer_gaps, 1, 0,
+                    inner_gaps, params->border_width, &box.y, &height);
+  box.width = width;
+  box.height = height;
+  return box;
+}
+
+bool
+layout_math_box_visible(struct mwc_layout_params *params, struct mwc_box *area,
+                        struct mwc_box *box) {
+  int32_t left = box->x - params->border_width;
+  int32_t top = box->y - params->border_width;
+  int32_t right = box->x + box->width + params->border_width;
+  int32_t bottom = box->y + box->height + params->border_width;
+
+  return left < area->x + area->width && right > area->x
+    && top < area->y + area->height && bottom > area->y;
+}
+
+bool
+layout_math_list_contains(struct wl_list *list, struct wl_list *link) {
+  for(struct wl_list *l = list->next; l != list; l = l->next) {
+    if(l == link) return true;
+  }
+  return false;
+}
+
+void
+layout_math_insert_tiled(struct wl_list *masters, struct wl_list *slaves, uint32_t master_count,
+                         struct wl_list *link, struct wl_list *target, struct mwc_box *target_box,
+                         int32_t x, int32_t y) {
+  if(target == NULL) {
+    if((uint32_t)wl_list_length(masters) < master_count) {
+      wl_list_insert(masters->prev, link);
+    } else {
+      wl_list_insert(slaves->prev, link);
+    }
+    return;
+  }
+
+  bool on_left_side = x <= target_box->x + target_box->width / 2;
+  bool on_top_side = y <= target_box->y + target_box->height / 2;
+  bool target_is_master = layout_math_list_contains(masters, target);
+
+  /* we insert it before target if either:
+   *   - its last master and there are some slaves
+   *   - cursor is on left (top) */
+  if((target_is_master && target == masters->prev && !wl_list_empty(slaves))
+     || (target_is_master && on_left_side)
+     || (!target_is_master && on_top_side)) {
+    wl_list_insert(target->prev, link);
+  } else {
+    wl_list_insert(target, link);
+  }
+
+  if((uint32_t)wl_list_length(masters) > master_count) {
+    struct wl_list *last = masters->prev;
+    wl_list_remove(last);
+    wl_list_insert(slaves->prev, last);
+  }
+}
+
+void
+layout_math_swap(struct wl_list *a, struct wl_list *b) {
+  if(a == b) return;
+
+  /* a goes after b and b where a was, which is b itself if it comes right before a */
+  if(a->prev == b) {
+    struct wl_list *t = a;
+    a = b;
+    b = t;
+  }
+
+  struct wl_list *before_a = a->prev;
+  wl_list_remove(a);
+  wl_list_insert(b, a);
+  wl_list_remove(b);
+  wl_list_insert(before_a, b);
+}
+
+void
+layout_math_rebalance(struct wl_list *masters, struct wl_list *slaves, uint32_t master_count,
+                      bool from_front) {
+  uint32_t count = wl_list_length(masters);
+
+  while(count > master_count) {
+    struct wl_list *last = masters->prev;
+    wl_list_remove(last);
+    wl_list_insert(slaves->prev, last);
+    count--;
+  }
+
+  while(count < master_count && !wl_list_empty(slaves)) {
+    struct wl_list *slave = from_front ? slaves->next : slaves->prev;
+    wl_list_remove(slave);
+    wl_list_insert(masters->prev, slave);
+    count++;
+  }
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+/* geometry and order of the tiled layouts, kept free of wlroots and server state,
+ * so it can be used outside of a running compositor */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <wayland-util.h>
+
+/* same layout as struct wlr_box */
+struct mwc_box {
+  int32_t x, y;
+  int32_t width, height;
+};
+
+struct mwc_layout_params {
+  uint32_t outer_gaps;
+  uint32_t inner_gaps;
+  uint32_t border_width;
+  double master_ratio;
+  double column_ratio;
+};
+
+uint32_t
+layout_math_positive(int64_t value);
+
+/* start and size of the part at index, out of count parts next to each other along
+ * a span of length. every part has a border around it and parts are 2 * gap apart.
+ * when that does not leave a pixel for each part the gaps and borders are left out,
+ * so the parts stay inside of the span without overlapping while it has a pixel for each */
+void
+layout_math_split(int64_t start, int64_t length, uint32_t count, uint32_t index,
+                  int64_t gap, int64_t border, int32_t *part_start, uint32_t *part_size);
+
+void
+layout_math_masters_span(struct mwc_layout_params *params, struct mwc_box *area,
+                         uint32_t slave_count, int64_t *start, int64_t *length);
+
+void
+layout_math_masters_dimensions(struct mwc_layout_params *params, struct mwc_box *area,
+                               uint32_t master_count, uint32_t slave_count,
+                               uint32_t *width, uint32_t *height);
+
+void
+layout_math_slaves_dimensions(struct mwc_layout_params *params, struct mwc_box *area,
+                              uint32_t slave_count, uint32_t *width, uint32_t *height);
+
+void
+layout_math_column_dimensions(struct mwc_layout_params *params, struct mwc_box *area,
+                              uint32_t *width, uint32_t *height);
+
+uint32_t
+layout_math_column_slot_width(struct mwc_layout_params *params, struct mwc_box *area);
+
+/* the boxes below are the content of the toplevel, without borders */
+struct mwc_box
+layout_math_master_box(struct mwc_layout_params *params, struct mwc_box *area,
+                       uint32_t master_count, uint32_t slave_count, uint32_t index);
+
+struct mwc_box
+layout_math_slave_box(struct mwc_layout_params *params, struct mwc_box *area,
+                      uint32_t slave_count, uint32_t index);
+
+/* clamps the scroll offset so the strip is not scrolled past its end */
+int32_t
+layout_math_clamp_scroll_offset(struct mwc_layout_params *params, struct mwc_box *area,
+                                uint32_t column_count, int32_t scroll_offset);
+
+struct mwc_box
+layout_math_column_box(struct mwc_layout_params *params, struct mwc_box *area,
+                       int32_t scroll_offset, uint32_t index);
+
+/* whether the box, grown by the border, is at least partially inside the area */
+bool
+layout_math_box_visible(struct mwc_layout_params *params, struct mwc_box *area,
+                        struct mwc_box *box);
+
+/* the order of the tiled toplevels of a workspace is kept in its masters and slaves
+ * lists, the links below are those of struct mwc_toplevel */
+
+bool
+layout_math_list_contains(struct wl_list *list, struct wl_list *link);
+
+/* inserts link among the tiled toplevels, next to target when it was dropped at x, y
+ * on the target, whose box is given. without a target it goes to the end of the masters
+ * if there is room for it, of the slaves otherwise. the last master is moved to the
+ * slaves if that leaves too many of them */
+void
+layout_math_insert_tiled(struct wl_list *masters, struct wl_list *slaves, uint32_t master_count,
+                         struct wl_list *link, struct wl_list *target, struct mwc_box *target_box,
+                         int32_t x, int32_t y);
+
+/* swaps two links, in the same list or not, next to each other or not */
+void
+layout_math_swap(struct wl_list *a, struct wl_list *b);
+
+/* moves links between masters and slaves until there are master_count masters,
+ * or no slaves left. masters go to the end of the slaves, and slaves are taken from
+ * the end too, unless from_front is set */
+void
+layout_math_rebalance(struct wl_list *masters, struct wl_list *slaves, uint32_t master_count,
+                      bool from_front);
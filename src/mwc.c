@@ -15,18 +15,24 @@
 #include "decoration.h"
 #include "dnd.h"
 #include "gamma_control.h"
+#include "idle.h"
+#include "pointer_constraint.h"
 #include "session_lock.h"
+#include "snapshot.h"
+#include "replay.h"
 
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <unistd.h>
 #include <wayland-server-core.h>
 #include <wayland-util.h>
 #include "wlr/util/log.h"
 #include "wlr/types/wlr_seat.h"
 #include <wlr/backend/session.h>
+#include <wlr/backend/headless.h>
 #include "wlr/types/wlr_cursor.h"
 #include "wlr/types/wlr_data_device.h"
 #include "wlr/backend.h"
@@ -48,6 +54,7 @@
 #include <wlr/types/wlr_presentation_time.h>
 #include <wlr/types/wlr_fractional_scale_v1.h>
 #include <wlr/types/wlr_session_lock_v1.h>
+#include <wlr/types/wlr_content_type_v1.h>
 
 /* we initialize an instance of our global state */
 struct mwc_server server;
@@ -97,7 +104,7 @@ server_handle_request_cursor_shape(struct wl_listener *listener, void *data) {
   struct wlr_seat_client *focused_client = server.seat->pointer_state.focused_client;
   if(focused_client == event->seat_client) {
     const char *name = wlr_cursor_shape_v1_name(event->shape);
-    wlr_cursor_set_xcursor(server.cursor, server.cursor_mgr, name);
+    cursor_set_xcursor(name);
     server.client_cursor.surface = NULL;
   }
 }
@@ -111,8 +118,7 @@ server_handle_request_cursor(struct wl_listener *listener, void *data) {
      * provided surface as the cursor image. it will set the hardware cursor
      * on the output that it's currently on and continue to do so as the
      * cursor moves between outputs */
-    wlr_cursor_set_surface(server.cursor, event->surface,
-                           event->hotspot_x, event->hotspot_y);
+    cursor_set_surface(event->surface, event->hotspot_x, event->hotspot_y);
     /* TODO: maybe this should be placed elsewhere */
     server.client_cursor.surface = event->surface;
     server.client_cursor.hotspot_x = event->hotspot_x;
@@ -140,12 +146,34 @@ main(int argc, char *argv[]) {
   sigaction(SIGCHLD, &sa, NULL);
 
   bool debug = false;
+  char *record_path = NULL;
+  char *replay_path = NULL;
+  char *socket_name = NULL;
   for(int i = 1; i < argc; i++) {
     if(strcmp(argv[i], "--debug") == 0) {
       debug = true;
+    } else if(strcmp(argv[i], "--headless") == 0) {
+      server.headless = true;
+    } else if(strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+      socket_name = argv[++i];
+    } else if(strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+      record_path = argv[++i];
+    } else if(strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+      replay_path = argv[++i];
     }
   }
 
+  if(record_path != NULL && replay_path != NULL) {
+    fprintf(stderr, "--record and --replay can not be used together\n");
+    return 1;
+  }
+
+  /* a replay has outputs of its own, --headless alone gets one in HEADLESS_OUTPUT_* */
+  bool headless_output = server.headless && replay_path == NULL;
+  if(replay_path != NULL) {
+    server.headless = true;
+  }
+
   mkdir("/tmp/mwc", 0777);
   if(debug) {
     /* make it so all the logs do to the log file */
@@ -179,7 +207,12 @@ main(int argc, char *argv[]) {
    * output hardware. The autocreate option will choose the most suitable
    * backend based on the current environment, such as opening an X11 window
    * if an X11 server is running. */
-  server.backend = wlr_backend_autocreate(server.wl_event_loop, &server.session);
+  /* headless sessions and replays do not need any real devices, and must not get input from them */
+  if(server.headless) {
+    server.backend = wlr_headless_backend_create(server.wl_event_loop);
+  } else {
+    server.backend = wlr_backend_autocreate(server.wl_event_loop, &server.session);
+  }
   if(server.backend == NULL) {
     wlr_log(WLR_ERROR, "failed to create wlr_backend");
     return 1;
@@ -308,6 +341,15 @@ main(int argc, char *argv[]) {
   wl_signal_add(&server.cursor->events.axis, &server.cursor_axis);
   server.cursor_frame.notify = server_handle_cursor_frame;
   wl_signal_add(&server.cursor->events.frame, &server.cursor_frame);
+  server.cursor_swipe_begin.notify = server_handle_cursor_swipe_begin;
+  wl_signal_add(&server.cursor->events.swipe_begin, &server.cursor_swipe_begin);
+  server.cursor_swipe_update.notify = server_handle_cursor_swipe_update;
+  wl_signal_add(&server.cursor->events.swipe_update, &server.cursor_swipe_update);
+  server.cursor_swipe_end.notify = server_handle_cursor_swipe_end;
+  wl_signal_add(&server.cursor->events.swipe_end, &server.cursor_swipe_end);
+
+  server.cursor_motion_timer = wl_event_loop_add_timer(server.wl_event_loop,
+                                                       cursor_handle_motion_timer, NULL);
 
   /*
    * Configures a seat, which is a single "seat" at which a user sits and
@@ -316,6 +358,11 @@ main(int argc, char *argv[]) {
    * let us know when new input devices are available on the backend.
    */
   wl_list_init(&server.keyboards);
+  server.xkb_context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
+  if(server.xkb_context == NULL) {
+    wlr_log(WLR_ERROR, "failed to create xkb context");
+    return 1;
+  }
   server.new_input.notify = server_handle_new_input;
   wl_signal_add(&server.backend->events.new_input, &server.new_input);
 
@@ -326,6 +373,9 @@ main(int argc, char *argv[]) {
   server.request_set_selection.notify = server_handle_request_set_selection;
   wl_signal_add(&server.seat->events.request_set_selection,
                 &server.request_set_selection);
+  server.pointer_focus_change.notify = server_handle_pointer_focus_change;
+  wl_signal_add(&server.seat->pointer_state.events.focus_change,
+                &server.pointer_focus_change);
 
   server.drag_icon_tree = wlr_scene_tree_create(&server.scene->tree);
 	wlr_scene_node_set_enabled(&server.drag_icon_tree->node, false);
@@ -371,6 +421,20 @@ main(int argc, char *argv[]) {
   server.set_gamma.notify = gamma_control_set_gamma;
   wl_signal_add(&server.gamma_control_manager->events.set_gamma, &server.set_gamma);
 
+  server.idle_notifier = wlr_idle_notifier_v1_create(server.wl_display);
+
+  /* fullscreen videos inhibit idle, see idle_update_inhibited() */
+  server.content_type_manager = wlr_content_type_manager_v1_create(server.wl_display, 1);
+
+  wl_list_init(&server.idle_inhibitors);
+  server.idle_inhibit_manager = wlr_idle_inhibit_v1_create(server.wl_display);
+  server.new_idle_inhibitor.notify = server_handle_new_idle_inhibitor;
+  wl_signal_add(&server.idle_inhibit_manager->events.new_inhibitor, &server.new_idle_inhibitor);
+
+  server.output_power_manager = wlr_output_power_manager_v1_create(server.wl_display);
+  server.output_power_set_mode.notify = output_power_manager_handle_set_mode;
+  wl_signal_add(&server.output_power_manager->events.set_mode, &server.output_power_set_mode);
+
   server.session_lock_manager = wlr_session_lock_manager_v1_create(server.wl_display);
   server.new_lock.notify = session_lock_manager_handle_new;
   server.lock_manager_destroy.notify = session_lock_manager_handle_destroy;
@@ -383,13 +447,34 @@ main(int argc, char *argv[]) {
   wl_signal_add(&server.cursor_shape_manager->events.request_set_shape, &server.request_cursor_shape);
   wl_signal_add(&server.cursor_shape_manager->events.destroy, &server.cursor_shape_manager_destroy);
 
-  /* Add a Unix socket to the Wayland display. */
-  const char *socket = wl_display_add_socket_auto(server.wl_display);
+  server.relative_pointer_manager = wlr_relative_pointer_manager_v1_create(server.wl_display);
+
+  server.pointer_constraints = wlr_pointer_constraints_v1_create(server.wl_display);
+  server.new_pointer_constraint.notify = server_handle_new_pointer_constraint;
+  wl_signal_add(&server.pointer_constraints->events.new_constraint, &server.new_pointer_constraint);
+
+  /* Add a Unix socket to the Wayland display. a fixed name lets whoever started a
+   * headless session know where to connect its clients */
+  const char *socket = socket_name;
+  if(socket_name != NULL) {
+    if(wl_display_add_socket(server.wl_display, socket_name) != 0) {
+      socket = NULL;
+    }
+  } else {
+    socket = wl_display_add_socket_auto(server.wl_display);
+  }
   if(!socket) {
     wlr_backend_destroy(server.backend);
     return 1;
   }
 
+  /* outputs are added when the backend starts, so we start recording before that */
+  if(record_path != NULL && !record_start(record_path)) {
+    wlr_backend_destroy(server.backend);
+    wl_display_destroy(server.wl_display);
+    return 1;
+  }
+
   /* Start the backend. This will enumerate outputs and inputs, become the DRM
    * master, etc */
   if(!wlr_backend_start(server.backend)) {
@@ -398,21 +483,45 @@ main(int argc, char *argv[]) {
     return 1;
   }
 
+  if(replay_path != NULL && !replay_start(replay_path)) {
+    wlr_backend_destroy(server.backend);
+    wl_display_destroy(server.wl_display);
+    return 1;
+  }
+
+  if(headless_output) {
+    wlr_headless_add_output(server.backend, HEADLESS_OUTPUT_WIDTH, HEADLESS_OUTPUT_HEIGHT);
+  }
+
   /* Set the WAYLAND_DISPLAY environment variable to our socket */
   setenv("WAYLAND_DISPLAY", socket, true);
 
-  /* creating a thread for the ipc to run on */
-  pthread_t ipc_thread;
-  pthread_create(&ipc_thread, NULL, ipc_run, NULL);
+  /* the ipc is ready before anything from the config is run. a headless session gets
+   * a socket of its own, so it does not take over the one of the session it may run in */
+  char ipc_path[108];
+  if(server.headless) {
+    snprintf(ipc_path, sizeof(ipc_path), "%s-%s-%d", IPC_PATH,
+             replay_path != NULL ? "replay" : "headless", getpid());
+  } else {
+    snprintf(ipc_path, sizeof(ipc_path), "%s", IPC_PATH);
+  }
+  if(!ipc_init(ipc_path)) {
+    wlr_log(WLR_ERROR, "failed to start the ipc, continuing without it");
+  }
 
   pthread_t inotify_thread;
   pthread_create(&inotify_thread, NULL, config_watch, server.config->dir);
 
-  /* sleep a bit so the ipc starts, 0.1 seconds is probably enough */
-  usleep(100000);
+  /* toplevels spawned below are put back where they were in the last session. a headless
+   * session only has clients someone else started, so it neither runs them nor touches
+   * the saved layout */
+  wl_list_init(&server.snapshot_entries);
+  if(!server.headless) {
+    snapshot_load();
 
-  for(size_t i = 0; i < server.config->run_count; i++) {
-    run_cmd(server.config->run[i]);
+    for(size_t i = 0; i < server.config->run_count; i++) {
+      run_cmd(server.config->run[i]);
+    }
   }
 
   server.running = true;
@@ -421,7 +530,16 @@ main(int argc, char *argv[]) {
   wlr_log(WLR_INFO, "running mwc on WAYLAND_DISPLAY=%s", socket);
   wl_display_run(server.wl_display);
 
-  unlink(IPC_PATH);
+  ipc_finish();
+
+  replay_finish();
+  record_finish();
+
+  /* clients are still around, so we can save where they are */
+  if(!server.headless) {
+    snapshot_save();
+  }
+  snapshot_clear();
 
   /* Once wl_display_run returns, we destroy all clients then shut down the
    * server. */
@@ -434,6 +552,9 @@ main(int argc, char *argv[]) {
   wlr_backend_destroy(server.backend);
   wl_display_destroy(server.wl_display);
 
+  keyboard_keymap_cache_finish();
+  xkb_context_unref(server.xkb_context);
+
   config_destroy(server.config);
 
   return 0;
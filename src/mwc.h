@@ -2,21 +2,35 @@
 
 #include <scenefx/types/wlr_scene.h>
 
+#include "generation.h"
+#include "gesture.h"
+#include "idle.h"
+#include "ipc.h"
 #include "keyboard.h"
+#include "latency.h"
 #include "pointer.h"
+#include "replay.h"
 #include "session_lock.h"
+#include "shm_state.h"
 
 #include <wayland-server-protocol.h>
 #include <wlr/util/box.h>
 #include <wlr/types/wlr_server_decoration.h>
 #include <wlr/types/wlr_gamma_control_v1.h>
 #include <wlr/types/wlr_cursor_shape_v1.h>
+#include <wlr/types/wlr_pointer_constraints_v1.h>
+#include <wlr/types/wlr_relative_pointer_v1.h>
 
 #define max(a, b) ((a) > (b) ? (a) : (b))
 #define min(a, b) ((a) < (b) ? (a) : (b))
+#define clamp(v, a, b) (max((a), min((v), (b))))
 
 #define STRING_INITIAL_LENGTH 64
 
+/* the output of a session started with --headless */
+#define HEADLESS_OUTPUT_WIDTH 1920
+#define HEADLESS_OUTPUT_HEIGHT 1080
+
 enum mwc_direction {
   MWC_UP,
   MWC_RIGHT,
@@ -59,11 +73,24 @@ struct mwc_server {
 	struct wl_listener cursor_button;
 	struct wl_listener cursor_axis;
 	struct wl_listener cursor_frame;
+  struct wl_listener cursor_swipe_begin;
+  struct wl_listener cursor_swipe_update;
+  struct wl_listener cursor_swipe_end;
+
+  /* workspace switching with trackpad swipes, see gesture.c */
+  struct mwc_swipe swipe;
 
   struct wlr_cursor_shape_manager_v1 *cursor_shape_manager;
   struct wl_listener request_cursor_shape;
   struct wl_listener cursor_shape_manager_destroy;
 
+  struct wlr_relative_pointer_manager_v1 *relative_pointer_manager;
+  struct wlr_pointer_constraints_v1 *pointer_constraints;
+  struct wl_listener new_pointer_constraint;
+  struct wl_listener pointer_focus_change;
+  /* constraint of the surface with pointer focus, while the client has it active */
+  struct wlr_pointer_constraint_v1 *active_constraint;
+
 	struct wlr_seat *seat;
 	struct wl_listener new_input;
 	struct wl_listener request_cursor;
@@ -78,6 +105,36 @@ struct mwc_server {
 	struct wl_list keyboards;
   struct mwc_keyboard *last_used_keyboard;
 
+  /* lives as long as the server, so keymaps are not compiled from scratch every time */
+  struct xkb_context *xkb_context;
+  /* the keymap compiled for the rules in the config, see keyboard_get_keymap() */
+  struct {
+    struct xkb_keymap *keymap;
+    char *layouts;
+    char *variants;
+    char *options;
+  } keymap_cache;
+
+  /* pointer motion is only hit-tested once per frame, see cursor_flush_motion() */
+  bool cursor_motion_pending;
+  uint32_t cursor_motion_time;
+  struct wl_event_source *cursor_motion_timer;
+  /* position of the surface with pointer focus at the last hit-test, in layout coordinates */
+  double pointer_surface_x, pointer_surface_y;
+  /* where the cursor was at the last motion sent to a client, so it is not sent twice.
+   * the surface is only compared against, never used */
+  struct wlr_surface *pointer_forwarded_surface;
+  double pointer_forwarded_x, pointer_forwarded_y;
+  /* the hit-test result is reused while the pointer stays in this surface and
+   * scene_generation has not changed since; bump it whenever something in the
+   * scene moves, appears or disappears */
+  struct wlr_surface *pointer_cache_surface;
+  uint64_t pointer_cache_generation;
+  uint64_t scene_generation;
+
+  /* input waiting to be committed to an output, see latency.c */
+  struct mwc_latency_input latency_input;
+
 	enum mwc_cursor_mode cursor_mode;
   /* this keeps state when the compositor is in the state of moving or
    * resizing toplevels */
@@ -87,6 +144,16 @@ struct mwc_server {
 	uint32_t resize_edges;
 	bool client_driven_move_resize;
 
+  /* what the cursor currently shows, so we can skip setting the same image again */
+  struct {
+    enum mwc_cursor_image_type type;
+    char xcursor_name[64];
+    struct wlr_surface *surface;
+    int32_t hotspot_x;
+    int32_t hotspot_y;
+    struct wl_listener surface_destroy;
+  } cursor_image;
+
   /* keeps state about the client cursor when the server initialized move/resize */
   struct {
     struct wlr_surface *surface;
@@ -98,6 +165,9 @@ struct mwc_server {
   struct mwc_workspace *active_workspace;
   /* toplevel with keyboard focus */
   struct mwc_toplevel *focused_toplevel;
+  /* the id the next toplevel gets */
+  uint64_t next_toplevel_id;
+  struct mwc_generations generations;
   /* keeps track if there is a layer surface that takes keyboard focus */
   struct mwc_layer_surface *focused_layer_surface;
   bool exclusive;
@@ -118,6 +188,15 @@ struct mwc_server {
   struct wlr_gamma_control_manager_v1 *gamma_control_manager;
   struct wl_listener set_gamma;
 
+  struct wlr_idle_notifier_v1 *idle_notifier;
+  struct wlr_idle_inhibit_manager_v1 *idle_inhibit_manager;
+  struct wlr_content_type_manager_v1 *content_type_manager;
+  struct wl_listener new_idle_inhibitor;
+  struct wl_list idle_inhibitors;
+
+  struct wlr_output_power_manager_v1 *output_power_manager;
+  struct wl_listener output_power_set_mode;
+
   struct wlr_session_lock_manager_v1 *session_lock_manager;
   struct wl_listener new_lock;
   struct wl_listener lock_manager_destroy;
@@ -125,8 +204,40 @@ struct mwc_server {
 
   struct mwc_config *config;
 
-  int *ipc_clients;
+  /* toplevels saved in the previous session, waiting to be matched */
+  struct wl_list snapshot_entries;
+  struct wl_event_source *snapshot_expire;
+
+  /* see replay.c, recording and replaying are mutually exclusive */
+  FILE *record_file;
+  struct timespec record_start;
+  struct mwc_replay *replay;
+  /* started with --headless or --replay, such a session has no real devices and
+   * leaves the saved layout alone */
+  bool headless;
+
+  int ipc_fd;
+  char ipc_path[108];
+  struct wl_event_source *ipc_source;
+  struct wl_list ipc_clients;
+  /* struct mwc_ipc_subscription, a list per enum ipc_event */
+  struct wl_list ipc_subscribers[IPC_EVENT_COUNT];
   bool ipc_running;
+  /* reused for every message, so sending them does not allocate */
+  struct ipc_writer ipc_reply_writer;
+  struct ipc_writer ipc_state_writer;
+  struct ipc_writer ipc_event_writers[IPC_ENCODING_COUNT];
+  /* events that are coalesced, a bitmask of enum ipc_event and toplevels with their own */
+  uint32_t ipc_pending;
+  /* when the oldest of them happened */
+  uint64_t ipc_pending_usec;
+  struct wl_list ipc_pending_toplevels;
+  struct wl_event_source *ipc_pending_idle;
+  struct wl_event_source *ipc_pending_timer;
+  /* events that were not sent because a newer one replaced them */
+  uint64_t ipc_coalesced;
+  /* mapped by clients, see util/ipc_shared.h */
+  struct mwc_shm_state shm_state;
 
   bool running;
 };
@@ -8,6 +8,9 @@
 #include "workspace.h"
 #include "toplevel.h"
 #include "ipc.h"
+#include "latency.h"
+#include "gesture.h"
+#include "replay.h"
 
 #include <assert.h>
 #include <stdbool.h>
@@ -25,6 +28,8 @@ void
 server_handle_new_output(struct wl_listener *listener, void *data) {
   struct wlr_output *wlr_output = data;
 
+  replay_name_output(wlr_output);
+
   /* we try to find the config for this output */
   struct output_config *output_config = NULL;
 
@@ -51,6 +56,9 @@ server_handle_new_output(struct wl_listener *listener, void *data) {
   output->request_state.notify = output_handle_request_state;
   wl_signal_add(&wlr_output->events.request_state, &output->request_state);
 
+  output->present.notify = output_handle_present;
+  wl_signal_add(&wlr_output->events.present, &output->present);
+
   output->destroy.notify = output_handle_destroy;
   wl_signal_add(&wlr_output->events.destroy, &output->destroy);
 
@@ -80,6 +88,8 @@ server_handle_new_output(struct wl_listener *listener, void *data) {
     wl_list_init(&workspace->slaves);
     workspace->output = output;
     workspace->index = 0;
+    workspace->master_count = server.config->master_count;
+    workspace->master_ratio = server.config->master_ratio;
 
     wl_list_insert(&output->workspaces, &workspace->link);
 
@@ -92,6 +102,10 @@ server_handle_new_output(struct wl_listener *listener, void *data) {
   wl_list_init(&output->layers.overlay);
 
   wl_list_insert(&server.outputs, &output->link);
+  record_output(MWC_RECORD_OUTPUT_ADD, output);
+
+  /* so the first hover over this output does not wait for the theme to load */
+  cursor_preload_scales();
 
   output->scene_output = wlr_scene_output_create(server.scene, output->wlr_output);
   struct wlr_box output_box = output_add_to_layout(output, output_config);
@@ -129,6 +143,9 @@ server_handle_new_output(struct wl_listener *listener, void *data) {
   if(server.active_workspace == NULL) {
     server.active_workspace = output->active_workspace;
   }
+
+  generation_output_changed(output);
+  ipc_broadcast_output(IPC_OUTPUT_ADD, output);
 }
 
 struct mwc_workspace *
@@ -167,6 +184,7 @@ output_transfer_existing_workspaces(struct mwc_output *output) {
         if(output->active_workspace == NULL) {
           output->active_workspace = w;
         }
+        generation_workspace_changed(w);
         found = true;
       }
     }
@@ -382,6 +400,7 @@ focus_output(struct mwc_output *output, enum mwc_direction side) {
     cursor_jump_output(output);
   } else {
     focus_toplevel(focus_next);
+    layout_scroll_to_toplevel(focus_next);
     cursor_jump_focused_toplevel();
   }
 }
@@ -393,17 +412,42 @@ output_handle_frame(struct wl_listener *listener, void *data) {
   struct mwc_output *output = wl_container_of(listener, output, frame);
   struct mwc_workspace *workspace = output->active_workspace;
 
+  /* turned off through power management, there is nobody to draw for */
+  if(!output->wlr_output->enabled) return;
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  /* pointer focus is updated once per frame, before drawing it */
+  cursor_flush_motion();
+
+  /* configures of an interactive resize are sent at most once per frame */
+  struct mwc_toplevel *grabbed = server.grabbed_toplevel;
+  if(grabbed != NULL && grabbed->workspace->output == output) {
+    toplevel_send_scheduled_configure(grabbed, false);
+  }
+
+  /* the workspace being swiped into view is drawn alongside the active one */
+  swipe_animation_tick(output);
   workspace_draw_frame(workspace);
+  if(server.swipe.output == output && server.swipe.to != NULL) {
+    workspace_draw_frame(server.swipe.to);
+  }
 
   struct wlr_scene_output *scene_output = wlr_scene_get_scene_output(server.scene,
                                                                      output->wlr_output);
 
-  wlr_scene_output_commit(scene_output, NULL);
+  /* only commits that change something can show the result of an input */
+  bool damaged = wlr_scene_output_needs_frame(scene_output);
+  if(wlr_scene_output_commit(scene_output, NULL) && damaged) {
+    latency_output_committed(output);
+  }
 
   struct timespec now;
   clock_gettime(CLOCK_MONOTONIC, &now);
 
   wlr_scene_output_send_frame_done(scene_output, &now);
+  latency_frame_drawn(output, &start, &now);
 }
 
 void
@@ -420,6 +464,15 @@ output_handle_request_state(struct wl_listener *listener, void *data) {
 void
 output_handle_destroy(struct wl_listener *listener, void *data) {
   struct mwc_output *output = wl_container_of(listener, output, destroy);
+  record_output(MWC_RECORD_OUTPUT_REMOVE, output);
+  generation_output_removed(output);
+  ipc_broadcast_output(IPC_OUTPUT_REMOVE, output);
+  latency_output_destroyed(output);
+
+  if(server.swipe.output == output) {
+    server.swipe.target = 0;
+    swipe_finish();
+  }
 
   /* we want to transfer all the workspaces to a new output;
    * if this was the only output then idk what to do honestly, maybe have a temporary
@@ -454,6 +507,7 @@ output_handle_destroy(struct wl_listener *listener, void *data) {
 
   wl_list_remove(&output->frame.link);
   wl_list_remove(&output->request_state.link);
+  wl_list_remove(&output->present.link);
   wl_list_remove(&output->destroy.link);
   wl_list_remove(&output->link);
 
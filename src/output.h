@@ -5,6 +5,7 @@
 #include <wlr/types/wlr_output.h>
 
 #include "workspace.h"
+#include "latency.h"
 #include "mwc.h"
 
 struct mwc_output {
@@ -24,11 +25,16 @@ struct mwc_output {
   struct wlr_scene_optimized_blur *blur;
 
   struct mwc_workspace *active_workspace;
+  /* see generation.h */
+  uint64_t generation;
 
   struct wlr_scene_rect *session_lock_rect;
 
+  struct mwc_output_latency latency;
+
 	struct wl_listener frame;
 	struct wl_listener request_state;
+  struct wl_listener present;
 	struct wl_listener destroy;
 };
 
@@ -3,20 +3,27 @@
 #include "config.h"
 #include "keybinds.h"
 #include "ipc.h"
+#include "latency.h"
 #include "layout.h"
 #include "mwc.h"
 #include "toplevel.h"
 #include "output.h"
+#include "pointer_constraint.h"
+#include "replay.h"
 #include "something.h"
 #include "dnd.h"
+#include "idle.h"
 #include "layer_surface.h"
 #include "workspace.h"
 
 #include <libinput.h>
+#include <stdio.h>
+#include <string.h>
 #include <wayland-server-core.h>
 #include <wayland-util.h>
 #include <wlr/backend/libinput.h>
 #include <wlr/types/wlr_cursor.h>
+#include <wlr/types/wlr_xcursor_manager.h>
 #include <wlr/util/log.h>
 
 extern struct mwc_server server;
@@ -127,17 +134,101 @@ server_reset_cursor_mode() {
   /* reset the cursor mode to passthrough. */
   server.cursor_mode = MWC_CURSOR_PASSTHROUGH;
   server.grabbed_toplevel->resizing = false;
+  /* the last size of the resize must not get lost */
+  toplevel_send_scheduled_configure(server.grabbed_toplevel, true);
   server.grabbed_toplevel = NULL;
   server.client_driven_move_resize = false;
 
   if(server.client_cursor.surface != NULL) {
-    wlr_cursor_set_surface(server.cursor, server.client_cursor.surface,
-                           server.client_cursor.hotspot_x, server.client_cursor.hotspot_y);
+    cursor_set_surface(server.client_cursor.surface,
+                       server.client_cursor.hotspot_x, server.client_cursor.hotspot_y);
   } else {
-    wlr_cursor_set_xcursor(server.cursor, server.cursor_mgr, "default");
+    cursor_set_xcursor("default");
   }
 }
 
+void
+cursor_image_forget_surface(void) {
+  if(server.cursor_image.surface != NULL) {
+    wl_list_remove(&server.cursor_image.surface_destroy.link);
+    server.cursor_image.surface = NULL;
+  }
+}
+
+void
+cursor_set_xcursor(const char *name) {
+  if(server.cursor_image.type == MWC_CURSOR_IMAGE_XCURSOR
+     && strcmp(server.cursor_image.xcursor_name, name) == 0) {
+    return;
+  }
+
+  /* the image for every output scale is picked by wlr_cursor itself */
+  wlr_cursor_set_xcursor(server.cursor, server.cursor_mgr, name);
+
+  cursor_image_forget_surface();
+  server.cursor_image.type = MWC_CURSOR_IMAGE_XCURSOR;
+  snprintf(server.cursor_image.xcursor_name, sizeof(server.cursor_image.xcursor_name), "%s", name);
+}
+
+void
+cursor_set_surface(struct wlr_surface *surface, int32_t hotspot_x, int32_t hotspot_y) {
+  if(server.cursor_image.type == MWC_CURSOR_IMAGE_SURFACE
+     && server.cursor_image.surface == surface
+     && server.cursor_image.hotspot_x == hotspot_x
+     && server.cursor_image.hotspot_y == hotspot_y) {
+    return;
+  }
+
+  /* a NULL surface hides the cursor */
+  wlr_cursor_set_surface(server.cursor, surface, hotspot_x, hotspot_y);
+
+  cursor_image_forget_surface();
+  server.cursor_image.type = MWC_CURSOR_IMAGE_SURFACE;
+  server.cursor_image.hotspot_x = hotspot_x;
+  server.cursor_image.hotspot_y = hotspot_y;
+
+  /* a new surface could end up at the same address, so we must not remember a dead one */
+  if(surface != NULL) {
+    server.cursor_image.surface = surface;
+    server.cursor_image.surface_destroy.notify = cursor_image_surface_handle_destroy;
+    wl_signal_add(&surface->events.destroy, &server.cursor_image.surface_destroy);
+  }
+}
+
+void
+cursor_image_surface_handle_destroy(struct wl_listener *listener, void *data) {
+  if(server.client_cursor.surface == server.cursor_image.surface) {
+    server.client_cursor.surface = NULL;
+  }
+
+  cursor_image_forget_surface();
+  server.cursor_image.type = MWC_CURSOR_IMAGE_UNKNOWN;
+}
+
+void
+cursor_preload_scales(void) {
+  struct mwc_output *output;
+  wl_list_for_each(output, &server.outputs, link) {
+    /* does nothing if the theme is already loaded at this scale */
+    wlr_xcursor_manager_load(server.cursor_mgr, output->wlr_output->scale);
+  }
+}
+
+void
+cursor_notify_motion(uint32_t time, double sx, double sy) {
+  struct wlr_surface *surface = server.seat->pointer_state.focused_surface;
+  if(surface == server.pointer_forwarded_surface
+     && server.cursor->x == server.pointer_forwarded_x
+     && server.cursor->y == server.pointer_forwarded_y) {
+    return;
+  }
+
+  wlr_seat_pointer_notify_motion(server.seat, time, sx, sy);
+  server.pointer_forwarded_surface = surface;
+  server.pointer_forwarded_x = server.cursor->x;
+  server.pointer_forwarded_y = server.cursor->y;
+}
+
 void
 cursor_handle_motion(uint32_t time) {
   /* get the output that the cursor is on currently */
@@ -182,15 +273,30 @@ cursor_handle_motion(uint32_t time) {
     dnd_icons_move(server.cursor->x, server.cursor->y);
   }
 
+  /* fast path: nothing has moved and the pointer is still in the same surface.
+   * subsurfaces above it could be hit instead, so those are always hit-tested */
+  struct wlr_seat *seat = server.seat;
+  struct wlr_surface *focused = seat->pointer_state.focused_surface;
+  if(focused != NULL && focused == server.pointer_cache_surface
+     && server.pointer_cache_generation == server.scene_generation
+     && wl_list_empty(&focused->current.subsurfaces_above)) {
+    double sx = server.cursor->x - server.pointer_surface_x;
+    double sy = server.cursor->y - server.pointer_surface_y;
+    if(wlr_surface_point_accepts_input(focused, sx, sy)) {
+      cursor_notify_motion(time, sx, sy);
+      return;
+    }
+  }
+
   /* find something under the pointer and send the event along. */
   double sx, sy;
-  struct wlr_seat *seat = server.seat;
   struct wlr_surface *surface = NULL;
   struct mwc_something *something =
     something_at(server.cursor->x, server.cursor->y, &surface, &sx, &sy);
 
   if(something == NULL) {
-    wlr_cursor_set_xcursor(server.cursor, server.cursor_mgr, "default");
+    server.pointer_cache_surface = NULL;
+    cursor_set_xcursor("default");
     /* clear pointer focus so future button events and such are not sent to
      * the last client to have the cursor over it */
     wlr_seat_pointer_clear_focus(seat);
@@ -206,50 +312,119 @@ cursor_handle_motion(uint32_t time) {
   }
 
   wlr_seat_pointer_notify_enter(seat, surface, sx, sy);
-  wlr_seat_pointer_notify_motion(seat, time, sx, sy);
+  cursor_notify_motion(time, sx, sy);
+
+  server.pointer_surface_x = server.cursor->x - sx;
+  server.pointer_surface_y = server.cursor->y - sy;
+  /* only the root surface is checked by the fast path, so we cache it only then */
+  server.pointer_cache_surface = wlr_surface_get_root_surface(surface) == surface ? surface : NULL;
+  server.pointer_cache_generation = server.scene_generation;
+}
+
+void
+cursor_schedule_motion(uint32_t time) {
+  server.cursor_motion_time = time;
+
+  /* clients still get every motion event, as long as the pointer stays
+   * inside the input region of the surface it was in at the last hit-test */
+  struct wlr_surface *surface = server.seat->pointer_state.focused_surface;
+  if(server.cursor_mode == MWC_CURSOR_PASSTHROUGH && surface != NULL) {
+    double sx = server.cursor->x - server.pointer_surface_x;
+    double sy = server.cursor->y - server.pointer_surface_y;
+    if(wlr_surface_point_accepts_input(surface, sx, sy)) {
+      cursor_notify_motion(time, sx, sy);
+    }
+  }
+
+  if(server.cursor_motion_pending) return;
+  server.cursor_motion_pending = true;
+
+  if(server.config->pointer_focus_rate > 0) {
+    wl_event_source_timer_update(server.cursor_motion_timer,
+                                 max(1000 / server.config->pointer_focus_rate, 1));
+  } else if(!server.active_workspace->output->wlr_output->enabled) {
+    /* an output that is turned off has no frames to wait for */
+    cursor_flush_motion();
+  } else {
+    /* hardware cursors do not cause frames on their own */
+    wlr_output_schedule_frame(server.active_workspace->output->wlr_output);
+  }
+}
+
+void
+cursor_flush_motion(void) {
+  if(!server.cursor_motion_pending) return;
+
+  server.cursor_motion_pending = false;
+  cursor_handle_motion(server.cursor_motion_time);
+}
+
+int
+cursor_handle_motion_timer(void *data) {
+  cursor_flush_motion();
+  return 0;
 }
 
 void
 server_handle_cursor_motion(struct wl_listener *listener, void *data) {
   struct wlr_pointer_motion_event *event = data;
-  wlr_cursor_move(server.cursor, &event->pointer->base,
-                  event->delta_x, event->delta_y);
-  cursor_handle_motion(event->time_msec);
+  record_event(MWC_RECORD_MOTION, event->time_msec, &(struct mwc_record_motion){
+    .dx = event->delta_x, .dy = event->delta_y,
+    .unaccel_dx = event->unaccel_dx, .unaccel_dy = event->unaccel_dy,
+  }, sizeof(struct mwc_record_motion));
+  latency_mark_input(MWC_INPUT_POINTER, event->time_msec);
+  idle_notify_activity();
+
+  /* relative motion goes to clients even when the cursor itself does not move */
+  wlr_relative_pointer_manager_v1_send_relative_motion(server.relative_pointer_manager, server.seat,
+                                                       (uint64_t)event->time_msec * 1000,
+                                                       event->delta_x, event->delta_y,
+                                                       event->unaccel_dx, event->unaccel_dy);
+
+  /* a locked pointer stays where it is, so there is nothing to hit-test or focus */
+  double dx = event->delta_x, dy = event->delta_y;
+  if(cursor_apply_constraint(&dx, &dy)) return;
+
+  wlr_cursor_move(server.cursor, &event->pointer->base, dx, dy);
+  cursor_schedule_motion(event->time_msec);
 }
 
 void
 server_handle_cursor_motion_absolute(
   struct wl_listener *listener, void *data) {
   struct wlr_pointer_motion_absolute_event *event = data;
+  record_event(MWC_RECORD_MOTION_ABSOLUTE, event->time_msec, &(struct mwc_record_motion_absolute){
+    .x = event->x, .y = event->y,
+  }, sizeof(struct mwc_record_motion_absolute));
   wlr_cursor_warp_absolute(server.cursor, &event->pointer->base, event->x, event->y);
-  cursor_handle_motion(event->time_msec);
+  latency_mark_input(MWC_INPUT_POINTER, event->time_msec);
+  idle_notify_activity();
+  cursor_schedule_motion(event->time_msec);
 }
 
 void
 server_handle_cursor_button(struct wl_listener *listener, void *data) {
   struct wlr_pointer_button_event *event = data;
+  record_event(MWC_RECORD_BUTTON, event->time_msec, &(struct mwc_record_button){
+    .button = event->button, .state = event->state,
+  }, sizeof(struct mwc_record_button));
+  idle_notify_activity();
+
+  /* the click has to go to whatever is under the pointer right now */
+  cursor_flush_motion();
 
   uint32_t modifiers = server.last_used_keyboard
     ? wlr_keyboard_get_modifiers(server.last_used_keyboard->wlr_keyboard)
     : 0;
 
-  struct keybind *k;
-  wl_list_for_each(k, &server.config->pointer_keybinds, link) {
-    if(!k->initialized) continue;
-
-    if(k->active && k->stop && event->button == k->key
-       && event->state == WL_POINTER_BUTTON_STATE_RELEASED) {
-      k->active = false;
-      k->stop(k->args);
-      return;
-    }
+  bool pressed = event->state == WL_POINTER_BUTTON_STATE_PRESSED;
+  if(pressed) {
+    latency_mark_input(MWC_INPUT_POINTER, event->time_msec);
+  }
 
-    if(modifiers == k->modifiers && event->button == k->key
-       && event->state == WL_POINTER_BUTTON_STATE_PRESSED) {
-      k->active = true;
-      k->action(k->args);
-      return;
-    }
+  if(keybind_table_handle(&server.config->pointer_keybind_table, modifiers,
+                          event->button, pressed)) {
+    return;
   }
 
   /* notify the client with pointer focus that a button press has occurred */
@@ -284,6 +459,14 @@ server_handle_cursor_button(struct wl_listener *listener, void *data) {
 void
 server_handle_cursor_axis(struct wl_listener *listener, void *data) {
   struct wlr_pointer_axis_event *event = data;
+  record_event(MWC_RECORD_AXIS, event->time_msec, &(struct mwc_record_axis){
+    .delta = event->delta, .delta_discrete = event->delta_discrete,
+    .orientation = event->orientation, .source = event->source,
+    .relative_direction = event->relative_direction,
+  }, sizeof(struct mwc_record_axis));
+  idle_notify_activity();
+
+  cursor_flush_motion();
 
   /* notify the client with pointer focus of the axis event */
   wlr_seat_pointer_notify_axis(server.seat,
@@ -293,6 +476,7 @@ server_handle_cursor_axis(struct wl_listener *listener, void *data) {
 
 void
 server_handle_cursor_frame(struct wl_listener *listener, void *data) {
+  record_event(MWC_RECORD_FRAME, 0, NULL, 0);
   wlr_seat_pointer_notify_frame(server.seat);
 }
 
@@ -4,6 +4,8 @@
 #include <wlr/types/wlr_pointer.h>
 #include <libinput.h>
 
+struct wlr_surface;
+
 struct mwc_pointer {
   struct wlr_pointer *wlr_pointer;
   const char *name;
@@ -12,6 +14,12 @@ struct mwc_pointer {
   struct wl_listener destroy;
 };
 
+enum mwc_cursor_image_type {
+  MWC_CURSOR_IMAGE_UNKNOWN,
+  MWC_CURSOR_IMAGE_XCURSOR,
+  MWC_CURSOR_IMAGE_SURFACE,
+};
+
 enum mwc_cursor_mode {
 	MWC_CURSOR_PASSTHROUGH,
 	MWC_CURSOR_MOVE,
@@ -30,9 +38,38 @@ pointer_configure(struct mwc_pointer *pointer);
 void
 server_reset_cursor_mode(void);
 
+/* these only touch the cursor when the image would actually change */
+void
+cursor_set_xcursor(const char *name);
+
+void
+cursor_set_surface(struct wlr_surface *surface, int32_t hotspot_x, int32_t hotspot_y);
+
+void
+cursor_image_surface_handle_destroy(struct wl_listener *listener, void *data);
+
+/* loads the cursor theme at scales of all the outputs, so it is ready before it is needed */
+void
+cursor_preload_scales(void);
+
+/* sends motion to the surface with pointer focus, unless it got it for this position already */
+void
+cursor_notify_motion(uint32_t time, double sx, double sy);
+
 void
 cursor_handle_motion(uint32_t time);
 
+/* forwards the motion to the focused surface and defers the rest of the work */
+void
+cursor_schedule_motion(uint32_t time);
+
+/* does the work of cursor_handle_motion() if there was motion since the last time */
+void
+cursor_flush_motion(void);
+
+int
+cursor_handle_motion_timer(void *data);
+
 void
 server_handle_cursor_motion(struct wl_listener *listener, void *data);
 
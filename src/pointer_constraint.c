@@ -0,0 +1,150 @@
+#include "pointer_constraint.h"
+
+#include "mwc.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <wayland-util.h>
+#include <pixman.h>
+#include <wlr/types/wlr_cursor.h>
+#include <wlr/types/wlr_seat.h>
+#include <wlr/types/wlr_xdg_shell.h>
+#include <wlr/util/region.h>
+
+extern struct mwc_server server;
+
+void
+server_handle_new_pointer_constraint(struct wl_listener *listener, void *data) {
+  struct wlr_pointer_constraint_v1 *wlr_constraint = data;
+
+  struct mwc_pointer_constraint *constraint = calloc(1, sizeof(*constraint));
+  constraint->wlr_constraint = wlr_constraint;
+  wlr_constraint->data = constraint;
+
+  constraint->set_region.notify = pointer_constraint_handle_set_region;
+  wl_signal_add(&wlr_constraint->events.set_region, &constraint->set_region);
+  constraint->destroy.notify = pointer_constraint_handle_destroy;
+  wl_signal_add(&wlr_constraint->events.destroy, &constraint->destroy);
+
+  /* the client usually asks for it while it already has pointer focus */
+  if(wlr_constraint->surface == server.seat->pointer_state.focused_surface) {
+    cursor_update_constraint();
+  }
+}
+
+void
+pointer_constraint_handle_set_region(struct wl_listener *listener, void *data) {
+  struct mwc_pointer_constraint *constraint = wl_container_of(listener, constraint, set_region);
+
+  if(server.active_constraint == constraint->wlr_constraint) {
+    cursor_confine_to_region(constraint->wlr_constraint);
+  }
+}
+
+void
+pointer_constraint_handle_destroy(struct wl_listener *listener, void *data) {
+  struct mwc_pointer_constraint *constraint = wl_container_of(listener, constraint, destroy);
+  struct wlr_pointer_constraint_v1 *wlr_constraint = constraint->wlr_constraint;
+
+  if(server.active_constraint == wlr_constraint) {
+    /* the client can tell us where it wants the cursor to be after unlocking,
+     * so it does not jump back to where it was locked */
+    if(wlr_constraint->type == WLR_POINTER_CONSTRAINT_V1_LOCKED
+       && wlr_constraint->current.cursor_hint.enabled) {
+      double sx = wlr_constraint->current.cursor_hint.x;
+      double sy = wlr_constraint->current.cursor_hint.y;
+      wlr_cursor_warp(server.cursor, NULL,
+                      server.pointer_surface_x + sx, server.pointer_surface_y + sy);
+      wlr_seat_pointer_warp(server.seat, sx, sy);
+    }
+
+    /* the constraint is going away, so there is nothing to deactivate */
+    server.active_constraint = NULL;
+  }
+
+  wl_list_remove(&constraint->set_region.link);
+  wl_list_remove(&constraint->destroy.link);
+  free(constraint);
+}
+
+void
+server_handle_pointer_focus_change(struct wl_listener *listener, void *data) {
+  struct wlr_seat_pointer_focus_change_event *event = data;
+
+  cursor_constrain(pointer_constraint_for_surface(event->new_surface));
+}
+
+struct wlr_pointer_constraint_v1 *
+pointer_constraint_for_surface(struct wlr_surface *surface) {
+  if(surface == NULL || surface != server.seat->keyboard_state.focused_surface) return NULL;
+
+  /* a toplevel on a workspace that is not shown keeps its focus with keep_focus */
+  struct wlr_xdg_toplevel *xdg_toplevel = wlr_xdg_toplevel_try_from_wlr_surface(surface);
+  if(xdg_toplevel != NULL && xdg_toplevel->base->data != NULL) {
+    struct wlr_scene_tree *scene_tree = xdg_toplevel->base->data;
+    int x, y;
+    if(!wlr_scene_node_coords(&scene_tree->node, &x, &y)) return NULL;
+  }
+
+  return wlr_pointer_constraints_v1_constraint_for_surface(server.pointer_constraints,
+                                                           surface, server.seat);
+}
+
+void
+cursor_update_constraint(void) {
+  cursor_constrain(pointer_constraint_for_surface(server.seat->pointer_state.focused_surface));
+}
+
+void
+cursor_constrain(struct wlr_pointer_constraint_v1 *constraint) {
+  if(server.active_constraint == constraint) return;
+
+  if(server.active_constraint != NULL) {
+    wlr_pointer_constraint_v1_send_deactivated(server.active_constraint);
+  }
+
+  server.active_constraint = constraint;
+
+  if(constraint != NULL) {
+    wlr_pointer_constraint_v1_send_activated(constraint);
+    cursor_confine_to_region(constraint);
+  }
+}
+
+void
+cursor_confine_to_region(struct wlr_pointer_constraint_v1 *constraint) {
+  if(constraint->type != WLR_POINTER_CONSTRAINT_V1_CONFINED) return;
+
+  double sx = server.cursor->x - server.pointer_surface_x;
+  double sy = server.cursor->y - server.pointer_surface_y;
+  if(pixman_region32_contains_point(&constraint->region, floor(sx), floor(sy), NULL)) return;
+
+  int count;
+  pixman_box32_t *boxes = pixman_region32_rectangles(&constraint->region, &count);
+  if(count == 0) return;
+
+  sx = (boxes[0].x1 + boxes[0].x2) / 2.0;
+  sy = (boxes[0].y1 + boxes[0].y2) / 2.0;
+  wlr_cursor_warp(server.cursor, NULL, server.pointer_surface_x + sx, server.pointer_surface_y + sy);
+  wlr_seat_pointer_warp(server.seat, sx, sy);
+}
+
+bool
+cursor_apply_constraint(double *dx, double *dy) {
+  struct wlr_pointer_constraint_v1 *constraint = server.active_constraint;
+  if(constraint == NULL || server.cursor_mode != MWC_CURSOR_PASSTHROUGH) return false;
+
+  if(constraint->type == WLR_POINTER_CONSTRAINT_V1_LOCKED) return true;
+
+  double sx = server.cursor->x - server.pointer_surface_x;
+  double sy = server.cursor->y - server.pointer_surface_y;
+
+  double sx_confined, sy_confined;
+  if(wlr_region_confine(&constraint->region, sx, sy, sx + *dx, sy + *dy,
+                        &sx_confined, &sy_confined)) {
+    *dx = sx_confined - sx;
+    *dy = sy_confined - sy;
+  }
+
+  return false;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <wayland-server-core.h>
+#include <wlr/types/wlr_pointer_constraints_v1.h>
+
+struct mwc_pointer_constraint {
+  struct wlr_pointer_constraint_v1 *wlr_constraint;
+
+  struct wl_listener set_region;
+  struct wl_listener destroy;
+};
+
+void
+server_handle_new_pointer_constraint(struct wl_listener *listener, void *data);
+
+void
+pointer_constraint_handle_set_region(struct wl_listener *listener, void *data);
+
+void
+pointer_constraint_handle_destroy(struct wl_listener *listener, void *data);
+
+/* the constraint of the surface, if it may hold right now: only while the surface
+ * has keyboard focus too and is shown, so the cursor does not get stuck in a surface
+ * the user has left with the keyboard */
+struct wlr_pointer_constraint_v1 *
+pointer_constraint_for_surface(struct wlr_surface *surface);
+
+/* activates the constraint of the surface with pointer focus, if there is one */
+void
+server_handle_pointer_focus_change(struct wl_listener *listener, void *data);
+
+/* called whenever keyboard focus changes or surfaces are hidden */
+void
+cursor_update_constraint(void);
+
+/* deactivates the current constraint and activates the given one, which can be NULL */
+void
+cursor_constrain(struct wlr_pointer_constraint_v1 *constraint);
+
+/* moves a confined cursor that is outside of the region into it */
+void
+cursor_confine_to_region(struct wlr_pointer_constraint_v1 *constraint);
+
+/* applies the active constraint to a relative motion, returns true if the
+ * cursor should not move at all */
+bool
+cursor_apply_constraint(double *dx, double *dy);
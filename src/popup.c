@@ -50,6 +50,9 @@ xdg_popup_handle_commit(struct wl_listener *listener, void *data) {
 
   if(!popup->xdg_popup->base->initialized) return;
 
+  /* popups are drawn over everything else, so the pointer could now be over one */
+  server.scene_generation++;
+
   if(popup->xdg_popup->base->initial_commit) {
     struct mwc_something *root = root_parent_of_surface(popup->xdg_popup->base->surface);
 
@@ -80,6 +83,7 @@ xdg_popup_handle_commit(struct wl_listener *listener, void *data) {
 void
 xdg_popup_handle_destroy(struct wl_listener *listener, void *data) {
   struct mwc_popup *popup = wl_container_of(listener, popup, destroy);
+  server.scene_generation++;
 
   wl_list_remove(&popup->commit.link);
   wl_list_remove(&popup->destroy.link);
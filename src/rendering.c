@@ -233,7 +233,8 @@ toplevel_animation_next_tick(struct mwc_toplevel *toplevel) {
   uint32_t y = toplevel->animation.initial.y +
     (toplevel->current.y - toplevel->animation.initial.y) * factor;
 
-  wlr_scene_node_set_position(&toplevel->scene_tree->node, x, y);
+  wlr_scene_node_set_position(&toplevel->scene_tree->node,
+                              x + toplevel->workspace->offset_x, y);
 
   toplevel->animation.current = (struct wlr_box){
     .x = x,
@@ -310,12 +311,15 @@ bool
 toplevel_draw_frame(struct mwc_toplevel *toplevel) {
   bool need_more_frames = false;
   if(toplevel->animation.running) {
+    /* the toplevel moves under the pointer */
+    server.scene_generation++;
     if(toplevel_animation_next_tick(toplevel)) {
       need_more_frames = true;
     }
   } else {
     wlr_scene_node_set_position(&toplevel->scene_tree->node,
-                                toplevel->current.x, toplevel->current.y);
+                                toplevel->current.x + toplevel->workspace->offset_x,
+                                toplevel->current.y);
   }
 
   if(server.config->border_width > 0) {
@@ -349,11 +353,14 @@ workspace_draw_frame(struct mwc_workspace *workspace) {
       }
     }
     wl_list_for_each(t, &workspace->masters, link) {
+      /* culled columns of the scrolling layout cost nothing */
+      if(t->suspended) continue;
       if(toplevel_draw_frame(t)) {
         need_more_frames = true;
       }
     }
     wl_list_for_each(t, &workspace->slaves, link) {
+      if(t->suspended) continue;
       if(toplevel_draw_frame(t)) {
         need_more_frames = true;
       }
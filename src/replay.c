@@ -0,0 +1,396 @@
+#include "replay.h"
+
+#include "array.h"
+#include "mwc.h"
+#include "output.h"
+#include "toplevel.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <wayland-util.h>
+#include <wlr/backend/headless.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/util/log.h>
+
+extern struct mwc_server server;
+
+uint64_t
+timespec_to_usec(struct timespec *t) {
+  return (uint64_t)t->tv_sec * 1000000 + t->tv_nsec / 1000;
+}
+
+uint64_t
+usec_since(struct timespec *start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return timespec_to_usec(&now) - timespec_to_usec(start);
+}
+
+bool
+record_start(const char *path) {
+  server.record_file = fopen(path, "w");
+  if(server.record_file == NULL) {
+    wlr_log(WLR_ERROR, "could not open '%s' for recording", path);
+    return false;
+  }
+
+  uint32_t version = RECORD_VERSION;
+  fwrite(RECORD_MAGIC, 1, strlen(RECORD_MAGIC), server.record_file);
+  fwrite(&version, sizeof(version), 1, server.record_file);
+
+  clock_gettime(CLOCK_MONOTONIC, &server.record_start);
+  return true;
+}
+
+void
+record_finish(void) {
+  if(server.record_file == NULL) return;
+
+  fclose(server.record_file);
+  server.record_file = NULL;
+}
+
+void
+record_event(enum mwc_record_type type, uint32_t time_msec, const void *payload, uint16_t size) {
+  if(server.record_file == NULL) return;
+
+  struct mwc_record_header header = {
+    .type = type,
+    .size = size,
+    .time_msec = time_msec,
+    .offset_usec = usec_since(&server.record_start),
+  };
+
+  fwrite(&header, sizeof(header), 1, server.record_file);
+  if(size > 0) {
+    fwrite(payload, size, 1, server.record_file);
+  }
+}
+
+uint32_t
+now_msec(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return timespec_to_usec(&now) / 1000;
+}
+
+void
+record_output(enum mwc_record_type type, struct mwc_output *output) {
+  if(server.record_file == NULL) return;
+
+  struct wlr_output *wlr_output = output->wlr_output;
+  struct mwc_record_output record = {
+    .width = wlr_output->width,
+    .height = wlr_output->height,
+    .refresh = wlr_output->refresh,
+    .scale = wlr_output->scale,
+  };
+  snprintf(record.name, sizeof(record.name), "%s", wlr_output->name);
+
+  record_event(type, now_msec(), &record, sizeof(record));
+}
+
+void
+record_toplevel(enum mwc_record_type type, struct mwc_toplevel *toplevel) {
+  if(server.record_file == NULL) return;
+
+  char *app_id = toplevel->xdg_toplevel->app_id;
+  char *title = toplevel->xdg_toplevel->title;
+
+  /* both are truncated, they are only there to make sense of the recording */
+  char payload[512];
+  int app_id_length = snprintf(payload, 256, "%s", app_id != NULL ? app_id : "");
+  app_id_length = min(app_id_length, 255);
+  int title_length = snprintf(payload + app_id_length + 1, 256, "%s", title != NULL ? title : "");
+  title_length = min(title_length, 255);
+
+  record_event(type, now_msec(), payload, app_id_length + 1 + title_length + 1);
+}
+
+const struct wlr_keyboard_impl replay_keyboard_impl = {
+  .name = "mwc-replay-keyboard",
+};
+
+const struct wlr_pointer_impl replay_pointer_impl = {
+  .name = "mwc-replay-pointer",
+};
+
+bool
+replay_start(const char *path) {
+  FILE *file = fopen(path, "r");
+  if(file == NULL) {
+    wlr_log(WLR_ERROR, "could not open '%s' for replaying", path);
+    return false;
+  }
+
+  struct mwc_replay *replay = calloc(1, sizeof(*replay));
+
+  fseek(file, 0, SEEK_END);
+  replay->size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+
+  replay->data = malloc(replay->size);
+  size_t read = fread(replay->data, 1, replay->size, file);
+  fclose(file);
+
+  size_t magic_length = strlen(RECORD_MAGIC);
+  uint32_t version;
+  if(read != replay->size || replay->size < magic_length + sizeof(version)
+     || memcmp(replay->data, RECORD_MAGIC, magic_length) != 0) {
+    wlr_log(WLR_ERROR, "'%s' is not an mwc recording", path);
+    free(replay->data);
+    free(replay);
+    return false;
+  }
+
+  memcpy(&version, replay->data + magic_length, sizeof(version));
+  if(version != RECORD_VERSION) {
+    wlr_log(WLR_ERROR, "'%s' has version %u, but only %u is supported",
+            path, version, RECORD_VERSION);
+    free(replay->data);
+    free(replay);
+    return false;
+  }
+
+  replay->position = magic_length + sizeof(version);
+  array_init(&replay->outputs);
+
+  /* the devices go through the same path as real ones */
+  wlr_keyboard_init(&replay->keyboard, &replay_keyboard_impl, replay_keyboard_impl.name);
+  wlr_pointer_init(&replay->pointer, &replay_pointer_impl, replay_pointer_impl.name);
+  wl_signal_emit_mutable(&server.backend->events.new_input, &replay->keyboard.base);
+  wl_signal_emit_mutable(&server.backend->events.new_input, &replay->pointer.base);
+
+  server.replay = replay;
+
+  clock_gettime(CLOCK_MONOTONIC, &replay->start);
+  replay->timer = wl_event_loop_add_timer(server.wl_event_loop, replay_handle_timer, replay);
+  wl_event_source_timer_update(replay->timer, 1);
+
+  return true;
+}
+
+void
+replay_add_output(struct mwc_replay *replay, struct mwc_record_output *record) {
+  struct mwc_replay_output output = {0};
+  memcpy(output.name, record->name, sizeof(output.name));
+  output.name[RECORD_NAME_LENGTH - 1] = 0;
+
+  /* creating it runs server_handle_new_output() right away, which names it */
+  replay->output_name = output.name;
+  struct wlr_output *wlr_output = wlr_headless_add_output(server.backend,
+                                                          record->width, record->height);
+  replay->output_name = NULL;
+  if(wlr_output == NULL) return;
+
+  struct wlr_output_state state;
+  wlr_output_state_init(&state);
+  wlr_output_state_set_custom_mode(&state, record->width, record->height, record->refresh);
+  wlr_output_state_set_scale(&state, record->scale);
+  wlr_output_commit_state(wlr_output, &state);
+  wlr_output_state_finish(&state);
+
+  output.wlr_output = wlr_output;
+  array_push(&replay->outputs, output);
+}
+
+void
+replay_name_output(struct wlr_output *wlr_output) {
+  if(server.replay == NULL || server.replay->output_name == NULL) return;
+
+  wlr_output_set_name(wlr_output, server.replay->output_name);
+}
+
+void
+replay_remove_output(struct mwc_replay *replay, struct mwc_record_output *record) {
+  for(size_t i = 0; i < array_len(replay->outputs); i++) {
+    if(strncmp(replay->outputs[i].name, record->name, RECORD_NAME_LENGTH) == 0) {
+      wlr_output_destroy(replay->outputs[i].wlr_output);
+      array_remove(&replay->outputs, i);
+      return;
+    }
+  }
+}
+
+bool
+replay_dispatch(struct mwc_replay *replay, struct mwc_record_header *header, void *payload) {
+  struct wlr_pointer *pointer = &replay->pointer;
+
+  switch(header->type) {
+    case MWC_RECORD_MOTION: {
+      if(header->size != sizeof(struct mwc_record_motion)) return false;
+      struct mwc_record_motion *r = payload;
+      struct wlr_pointer_motion_event event = {
+        .pointer = pointer,
+        .time_msec = header->time_msec,
+        .delta_x = r->dx,
+        .delta_y = r->dy,
+        .unaccel_dx = r->unaccel_dx,
+        .unaccel_dy = r->unaccel_dy,
+      };
+      wl_signal_emit_mutable(&pointer->events.motion, &event);
+      break;
+    }
+    case MWC_RECORD_MOTION_ABSOLUTE: {
+      if(header->size != sizeof(struct mwc_record_motion_absolute)) return false;
+      struct mwc_record_motion_absolute *r = payload;
+      struct wlr_pointer_motion_absolute_event event = {
+        .pointer = pointer,
+        .time_msec = header->time_msec,
+        .x = r->x,
+        .y = r->y,
+      };
+      wl_signal_emit_mutable(&pointer->events.motion_absolute, &event);
+      break;
+    }
+    case MWC_RECORD_BUTTON: {
+      if(header->size != sizeof(struct mwc_record_button)) return false;
+      struct mwc_record_button *r = payload;
+      struct wlr_pointer_button_event event = {
+        .pointer = pointer,
+        .time_msec = header->time_msec,
+        .button = r->button,
+        .state = r->state,
+      };
+      wl_signal_emit_mutable(&pointer->events.button, &event);
+      break;
+    }
+    case MWC_RECORD_AXIS: {
+      if(header->size != sizeof(struct mwc_record_axis)) return false;
+      struct mwc_record_axis *r = payload;
+      struct wlr_pointer_axis_event event = {
+        .pointer = pointer,
+        .time_msec = header->time_msec,
+        .source = r->source,
+        .orientation = r->orientation,
+        .relative_direction = r->relative_direction,
+        .delta = r->delta,
+        .delta_discrete = r->delta_discrete,
+      };
+      wl_signal_emit_mutable(&pointer->events.axis, &event);
+      break;
+    }
+    case MWC_RECORD_FRAME:
+      wl_signal_emit_mutable(&pointer->events.frame, pointer);
+      break;
+    case MWC_RECORD_SWIPE_BEGIN: {
+      if(header->size != sizeof(struct mwc_record_swipe)) return false;
+      struct mwc_record_swipe *r = payload;
+      struct wlr_pointer_swipe_begin_event event = {
+        .pointer = pointer,
+        .time_msec = header->time_msec,
+        .fingers = r->fingers,
+      };
+      wl_signal_emit_mutable(&pointer->events.swipe_begin, &event);
+      break;
+    }
+    case MWC_RECORD_SWIPE_UPDATE: {
+      if(header->size != sizeof(struct mwc_record_swipe)) return false;
+      struct mwc_record_swipe *r = payload;
+      struct wlr_pointer_swipe_update_event event = {
+        .pointer = pointer,
+        .time_msec = header->time_msec,
+        .fingers = r->fingers,
+        .dx = r->dx,
+        .dy = r->dy,
+      };
+      wl_signal_emit_mutable(&pointer->events.swipe_update, &event);
+      break;
+    }
+    case MWC_RECORD_SWIPE_END: {
+      if(header->size != sizeof(struct mwc_record_swipe)) return false;
+      struct mwc_record_swipe *r = payload;
+      struct wlr_pointer_swipe_end_event event = {
+        .pointer = pointer,
+        .time_msec = header->time_msec,
+        .cancelled = r->cancelled,
+      };
+      wl_signal_emit_mutable(&pointer->events.swipe_end, &event);
+      break;
+    }
+    case MWC_RECORD_KEY: {
+      if(header->size != sizeof(struct mwc_record_key)) return false;
+      struct mwc_record_key *r = payload;
+      /* this also updates modifiers, so they do not have to be recorded */
+      struct wlr_keyboard_key_event event = {
+        .time_msec = header->time_msec,
+        .keycode = r->keycode,
+        .update_state = true,
+        .state = r->state,
+      };
+      wlr_keyboard_notify_key(&replay->keyboard, &event);
+      break;
+    }
+    case MWC_RECORD_OUTPUT_ADD:
+      if(header->size != sizeof(struct mwc_record_output)) return false;
+      replay_add_output(replay, payload);
+      break;
+    case MWC_RECORD_OUTPUT_REMOVE:
+      if(header->size != sizeof(struct mwc_record_output)) return false;
+      replay_remove_output(replay, payload);
+      break;
+    case MWC_RECORD_TOPLEVEL_MAP:
+    case MWC_RECORD_TOPLEVEL_UNMAP: {
+      char *app_id = payload;
+      if(header->size == 0 || app_id[header->size - 1] != 0) return false;
+      wlr_log(WLR_INFO, "replay: at %.3lfs toplevel '%s' was %s",
+              header->offset_usec / 1000000.0, app_id,
+              header->type == MWC_RECORD_TOPLEVEL_MAP ? "mapped" : "unmapped");
+      break;
+    }
+    default:
+      return false;
+  }
+
+  return true;
+}
+
+int
+replay_handle_timer(void *data) {
+  struct mwc_replay *replay = data;
+
+  /* the virtual clock starts with the replay, and every event is sent
+   * when as much time has passed as when it was recorded */
+  uint64_t elapsed = usec_since(&replay->start);
+
+  while(replay->position + sizeof(struct mwc_record_header) <= replay->size) {
+    struct mwc_record_header header;
+    memcpy(&header, replay->data + replay->position, sizeof(header));
+
+    if(header.offset_usec > elapsed) {
+      uint64_t delay_ms = (header.offset_usec - elapsed + 999) / 1000;
+      wl_event_source_timer_update(replay->timer, max(delay_ms, 1));
+      return 0;
+    }
+
+    size_t payload_position = replay->position + sizeof(header);
+    if(payload_position + header.size > replay->size) break;
+
+    if(!replay_dispatch(replay, &header, replay->data + payload_position)) {
+      wlr_log(WLR_ERROR, "replay: invalid record of type %u, skipping it", header.type);
+    }
+
+    replay->position = payload_position + header.size;
+  }
+
+  wlr_log(WLR_INFO, "replay: finished in %.3lfs", usec_since(&replay->start) / 1000000.0);
+  wl_display_terminate(server.wl_display);
+
+  return 0;
+}
+
+void
+replay_finish(void) {
+  struct mwc_replay *replay = server.replay;
+  if(replay == NULL) return;
+
+  wl_event_source_remove(replay->timer);
+  wlr_keyboard_finish(&replay->keyboard);
+  wlr_pointer_finish(&replay->pointer);
+
+  array_destroy(&replay->outputs);
+  free(replay->data);
+  free(replay);
+
+  server.replay = NULL;
+}
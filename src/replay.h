@@ -0,0 +1,143 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <wayland-server-core.h>
+#include <wlr/interfaces/wlr_keyboard.h>
+#include <wlr/interfaces/wlr_pointer.h>
+
+/* a recording is RECORD_MAGIC and RECORD_VERSION followed by records, each
+ * being a struct mwc_record_header and then its payload. everything is
+ * written in the byte order of the machine that recorded it */
+#define RECORD_MAGIC "mwcrec"
+#define RECORD_VERSION 1
+#define RECORD_NAME_LENGTH 32
+
+struct mwc_output;
+struct mwc_toplevel;
+struct wlr_output;
+
+enum mwc_record_type {
+  MWC_RECORD_MOTION,
+  MWC_RECORD_MOTION_ABSOLUTE,
+  MWC_RECORD_BUTTON,
+  MWC_RECORD_AXIS,
+  MWC_RECORD_FRAME,
+  MWC_RECORD_SWIPE_BEGIN,
+  MWC_RECORD_SWIPE_UPDATE,
+  MWC_RECORD_SWIPE_END,
+  MWC_RECORD_KEY,
+  MWC_RECORD_OUTPUT_ADD,
+  MWC_RECORD_OUTPUT_REMOVE,
+  MWC_RECORD_TOPLEVEL_MAP,
+  MWC_RECORD_TOPLEVEL_UNMAP,
+};
+
+struct mwc_record_header {
+  uint16_t type;
+  /* size of the payload that follows */
+  uint16_t size;
+  /* timestamp of the input event, passed back as is when replaying */
+  uint32_t time_msec;
+  /* since the recording started, used for scheduling the replay */
+  uint64_t offset_usec;
+};
+
+struct mwc_record_motion {
+  double dx, dy;
+  double unaccel_dx, unaccel_dy;
+};
+
+struct mwc_record_motion_absolute {
+  double x, y;
+};
+
+struct mwc_record_button {
+  uint32_t button;
+  uint32_t state;
+};
+
+struct mwc_record_axis {
+  double delta;
+  int32_t delta_discrete;
+  uint32_t orientation;
+  uint32_t source;
+  uint32_t relative_direction;
+};
+
+struct mwc_record_swipe {
+  uint32_t fingers;
+  uint32_t cancelled;
+  double dx, dy;
+};
+
+struct mwc_record_key {
+  uint32_t keycode;
+  uint32_t state;
+};
+
+struct mwc_record_output {
+  char name[RECORD_NAME_LENGTH];
+  int32_t width, height;
+  int32_t refresh;
+  float scale;
+};
+
+/* toplevel records carry app_id and title, both null terminated, and are
+ * only markers when replaying, since there are no clients to map them */
+
+/* a recorded output name and the headless output created for it */
+struct mwc_replay_output {
+  char name[RECORD_NAME_LENGTH];
+  struct wlr_output *wlr_output;
+};
+
+struct mwc_replay {
+  char *data;
+  size_t size;
+  size_t position;
+
+  struct timespec start;
+  struct wl_event_source *timer;
+
+  /* virtual devices the recorded events are sent through */
+  struct wlr_keyboard keyboard;
+  struct wlr_pointer pointer;
+
+  /* dynamic array, see util/array.h */
+  struct mwc_replay_output *outputs;
+  /* the recorded name of the output being added, see replay_name_output() */
+  const char *output_name;
+};
+
+bool
+record_start(const char *path);
+
+void
+record_finish(void);
+
+void
+record_event(enum mwc_record_type type, uint32_t time_msec, const void *payload, uint16_t size);
+
+void
+record_output(enum mwc_record_type type, struct mwc_output *output);
+
+void
+record_toplevel(enum mwc_record_type type, struct mwc_toplevel *toplevel);
+
+/* has to be called after the backend, which must be headless, is started */
+bool
+replay_start(const char *path);
+
+int
+replay_handle_timer(void *data);
+
+/* gives a headless output created by the replay its recorded name, so the output and
+ * workspace config match it like they did when recording. called before it is configured */
+void
+replay_name_output(struct wlr_output *wlr_output);
+
+void
+replay_finish(void);
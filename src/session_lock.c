@@ -4,6 +4,7 @@
 #include "something.h"
 #include "toplevel.h"
 #include "mwc.h"
+#include "pointer_constraint.h"
 #include "rendering.h"
 #include "wlr/util/log.h"
 
@@ -41,6 +42,7 @@ lock_surface_handle_destroy(struct wl_listener *listener, void *data) {
 void
 session_lock_handle_new_surface(struct wl_listener *listener, void *data) {
 	struct mwc_lock *lock = wl_container_of(listener, lock, new_surface);
+  server.scene_generation++;
 
 	struct wlr_session_lock_surface_v1 *wlr_lock_surface = data;
   struct mwc_output *output = wlr_lock_surface->output->data;
@@ -84,6 +86,7 @@ focus_lock_surface(struct mwc_lock_surface *lock_surface) {
                                    keyboard->keycodes, keyboard->num_keycodes,
                                    &keyboard->modifiers);
   }
+  cursor_update_constraint();
 }
 
 void
@@ -91,6 +94,7 @@ session_lock_handle_unlock(struct wl_listener *listener, void *data) {
   struct mwc_lock *lock = wl_container_of(listener, lock, unlock);
   lock->locked = false;
   server.lock = NULL;
+  server.scene_generation++;
 
   struct wlr_output *wlr_output = wlr_output_layout_output_at(server.output_layout,
                                                               server.cursor->x, server.cursor->y);
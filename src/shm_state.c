@@ -0,0 +1,189 @@
+#include "shm_state.h"
+
+#include "mwc.h"
+#include "output.h"
+#include "toplevel.h"
+#include "workspace.h"
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <wayland-util.h>
+#include <wlr/types/wlr_output_layout.h>
+#include <wlr/util/log.h>
+
+extern struct mwc_server server;
+
+bool
+shm_state_init(void) {
+  if(server.shm_state.data != NULL) return true;
+
+  int fd = memfd_create("mwc-state", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if(fd == -1) goto no_close;
+  if(ftruncate(fd, sizeof(struct ipc_shm_state)) == -1) goto error;
+  /* clients map all of it, so it must never shrink under them */
+  if(fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) == -1) goto error;
+
+  struct ipc_shm_state *data = mmap(NULL, sizeof(*data), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if(data == MAP_FAILED) goto error;
+
+  /* opening it again through /proc is the only way to get a read only memfd */
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+  int read_only_fd = open(path, O_RDONLY | O_CLOEXEC);
+  if(read_only_fd == -1) {
+    munmap(data, sizeof(*data));
+    goto error;
+  }
+
+  data->version = IPC_SHM_VERSION;
+  server.shm_state = (struct mwc_shm_state){
+    .fd = fd,
+    .read_only_fd = read_only_fd,
+    .data = data,
+  };
+
+  shm_state_publish();
+  return true;
+
+error:
+  close(fd);
+no_close:
+  wlr_log(WLR_ERROR, "ipc: could not create the shared state: %s", strerror(errno));
+  return false;
+}
+
+void
+shm_state_schedule(void) {
+  if(server.shm_state.data == NULL || server.shm_state.idle != NULL) return;
+
+  server.shm_state.idle = wl_event_loop_add_idle(server.wl_event_loop, shm_state_handle_idle, NULL);
+}
+
+void
+shm_state_write_toplevels(struct ipc_shm_state *state, struct wl_list *toplevels) {
+  struct mwc_toplevel *toplevel;
+  wl_list_for_each(toplevel, toplevels, link) {
+    if(state->toplevel_count == IPC_SHM_MAX_TOPLEVELS) {
+      state->truncated = true;
+      return;
+    }
+
+    struct ipc_shm_toplevel *t = &state->toplevels[state->toplevel_count++];
+    const char *app_id = toplevel->xdg_toplevel->app_id;
+    const char *title = toplevel->xdg_toplevel->title;
+    *t = (struct ipc_shm_toplevel){
+      .id = toplevel->id,
+      .generation = toplevel->generation,
+      .workspace = toplevel->workspace->index,
+      .x = toplevel->current.x,
+      .y = toplevel->current.y,
+      .width = toplevel->current.width,
+      .height = toplevel->current.height,
+    };
+    snprintf(t->app_id, sizeof(t->app_id), "%s", app_id != NULL ? app_id : "");
+    snprintf(t->title, sizeof(t->title), "%s", title != NULL ? title : "");
+
+    if(toplevel->floating) t->flags |= IPC_SHM_FLOATING;
+    if(toplevel->fullscreen) t->flags |= IPC_SHM_FULLSCREEN;
+    if(toplevel == server.focused_toplevel) t->flags |= IPC_SHM_FOCUSED;
+  }
+}
+
+void
+shm_state_publish(void) {
+  struct ipc_shm_state *state = server.shm_state.data;
+  if(state == NULL) return;
+
+  /* odd while writing, readers retry until it is even and did not change */
+  __atomic_store_n(&state->sequence, state->sequence + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  state->generation = server.generations.current;
+  state->active_workspace = server.active_workspace != NULL ? server.active_workspace->index : 0;
+  state->focused_toplevel = server.focused_toplevel != NULL ? server.focused_toplevel->id : 0;
+  state->truncated = false;
+  state->output_count = 0;
+  state->workspace_count = 0;
+  state->toplevel_count = 0;
+
+  struct mwc_output *output;
+  wl_list_for_each(output, &server.outputs, link) {
+    if(state->output_count == IPC_SHM_MAX_OUTPUTS) {
+      state->truncated = true;
+      break;
+    }
+
+    struct wlr_box box;
+    wlr_output_layout_get_box(server.output_layout, output->wlr_output, &box);
+
+    uint32_t output_index = state->output_count++;
+    struct ipc_shm_output *o = &state->outputs[output_index];
+    *o = (struct ipc_shm_output){
+      .x = box.x,
+      .y = box.y,
+      .width = box.width,
+      .height = box.height,
+      .scale = output->wlr_output->scale,
+      .active_workspace = output->active_workspace->index,
+      .generation = output->generation,
+    };
+    snprintf(o->name, sizeof(o->name), "%s", output->wlr_output->name);
+
+    struct mwc_workspace *workspace;
+    wl_list_for_each(workspace, &output->workspaces, link) {
+      if(state->workspace_count == IPC_SHM_MAX_WORKSPACES) {
+        state->truncated = true;
+        break;
+      }
+
+      state->workspaces[state->workspace_count++] = (struct ipc_shm_workspace){
+        .index = workspace->index,
+        .output = output_index,
+        .layout = workspace->layout == MWC_LAYOUT_SCROLLING ? 1 : 0,
+        .master_count = workspace->master_count,
+        .master_ratio = workspace->master_ratio,
+        .fullscreen_toplevel = workspace->fullscreen_toplevel != NULL
+          ? workspace->fullscreen_toplevel->id : 0,
+        .generation = workspace->generation,
+      };
+
+      shm_state_write_toplevels(state, &workspace->floating_toplevels);
+      shm_state_write_toplevels(state, &workspace->masters);
+      shm_state_write_toplevels(state, &workspace->slaves);
+    }
+  }
+
+  __atomic_store_n(&state->sequence, state->sequence + 1, __ATOMIC_RELEASE);
+}
+
+int
+shm_state_handle_idle(void *data) {
+  server.shm_state.idle = NULL;
+  shm_state_publish();
+  return 0;
+}
+
+int
+shm_state_get_fd(void) {
+  if(!shm_state_init()) return -1;
+
+  return fcntl(server.shm_state.read_only_fd, F_DUPFD_CLOEXEC, 0);
+}
+
+void
+shm_state_finish(void) {
+  if(server.shm_state.idle != NULL) {
+    wl_event_source_remove(server.shm_state.idle);
+  }
+  if(server.shm_state.data != NULL) {
+    munmap(server.shm_state.data, sizeof(struct ipc_shm_state));
+    close(server.shm_state.read_only_fd);
+    close(server.shm_state.fd);
+  }
+  server.shm_state = (struct mwc_shm_state){0};
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "ipc_shared.h"
+
+#include <stdbool.h>
+#include <wayland-server-core.h>
+
+/* the state clients map after the shm request, see util/ipc_shared.h */
+struct mwc_shm_state {
+  int fd;
+  /* what clients get, they cannot write to it */
+  int read_only_fd;
+  /* NULL until the first client asks for it, nobody pays for it before that */
+  struct ipc_shm_state *data;
+  /* the state is rewritten once per loop iteration at most */
+  struct wl_event_source *idle;
+};
+
+/* creates the memfd if it does not exist yet, returns false if that fails */
+bool
+shm_state_init(void);
+
+/* something changed, the state is rewritten when the event loop is idle */
+void
+shm_state_schedule(void);
+
+void
+shm_state_publish(void);
+
+int
+shm_state_handle_idle(void *data);
+
+/* a new file descriptor for a client, the caller closes it. -1 on failure */
+int
+shm_state_get_fd(void);
+
+void
+shm_state_finish(void);
@@ -0,0 +1,278 @@
+#include "snapshot.h"
+
+#include "mwc.h"
+#include "layout.h"
+#include "output.h"
+#include "toplevel.h"
+#include "workspace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <wayland-util.h>
+#include <wlr/util/log.h>
+
+extern struct mwc_server server;
+
+/* the snapshot is a text file with one toplevel per line, fields separated by tabs:
+ *   <workspace> <f(loating)|t(iled)> <position> <x> <y> <width> <height> <fullscreen> <app_id> <title> */
+
+bool
+snapshot_get_path(char *dest, size_t size) {
+  char *state_home = getenv("XDG_STATE_HOME");
+  if(state_home != NULL) {
+    char dir[1024];
+    snprintf(dir, sizeof(dir), "%s/mwc", state_home);
+    mkdir(dir, 0755);
+    snprintf(dest, size, "%s/layout", dir);
+    return true;
+  }
+
+  /* /tmp/mwc is created on startup */
+  snprintf(dest, size, "/tmp/mwc/layout");
+  return true;
+}
+
+void
+snapshot_write_string(FILE *file, char *string) {
+  if(string == NULL) return;
+
+  /* tabs and newlines would break the format, titles do contain them sometimes */
+  for(char *p = string; *p != 0; p++) {
+    fputc(*p == '\t' || *p == '\n' ? ' ' : *p, file);
+  }
+}
+
+void
+snapshot_write_toplevel(FILE *file, struct mwc_toplevel *toplevel, uint32_t position) {
+  /* for fullscreen toplevels we save the state they return to */
+  struct wlr_box box = toplevel->fullscreen
+    ? toplevel->prev_geometry
+    : toplevel->current;
+
+  fprintf(file, "%u\t%c\t%u\t%d\t%d\t%d\t%d\t%d\t",
+          toplevel->workspace->index, toplevel->floating ? 'f' : 't', position,
+          box.x, box.y, box.width, box.height, toplevel->fullscreen);
+  snapshot_write_string(file, toplevel->xdg_toplevel->app_id);
+  fputc('\t', file);
+  snapshot_write_string(file, toplevel->xdg_toplevel->title);
+  fputc('\n', file);
+}
+
+void
+snapshot_save(void) {
+  char path[1024];
+  if(!snapshot_get_path(path, sizeof(path))) return;
+
+  /* we write to a temporary file first so a crash can not leave a half written snapshot */
+  char tmp_path[1032];
+  snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+  FILE *file = fopen(tmp_path, "w");
+  if(file == NULL) {
+    wlr_log(WLR_ERROR, "could not open %s for writing the layout snapshot", tmp_path);
+    return;
+  }
+
+  struct mwc_output *output;
+  wl_list_for_each(output, &server.outputs, link) {
+    struct mwc_workspace *workspace;
+    wl_list_for_each(workspace, &output->workspaces, link) {
+      struct mwc_toplevel *t;
+      wl_list_for_each(t, &workspace->floating_toplevels, link) {
+        snapshot_write_toplevel(file, t, 0);
+      }
+
+      uint32_t position = 0;
+      wl_list_for_each(t, &workspace->masters, link) {
+        snapshot_write_toplevel(file, t, position);
+        position++;
+      }
+      wl_list_for_each(t, &workspace->slaves, link) {
+        snapshot_write_toplevel(file, t, position);
+        position++;
+      }
+    }
+  }
+
+  fclose(file);
+
+  if(rename(tmp_path, path) != 0) {
+    wlr_log(WLR_ERROR, "could not save the layout snapshot to %s", path);
+    return;
+  }
+
+  wlr_log(WLR_INFO, "saved the layout snapshot to %s", path);
+}
+
+int
+snapshot_handle_expire(void *data) {
+  wlr_log(WLR_INFO, "layout snapshot expired, new toplevels are placed as usual");
+  snapshot_clear();
+  return 0;
+}
+
+void
+snapshot_load(void) {
+  char path[1024];
+  if(!snapshot_get_path(path, sizeof(path))) return;
+
+  FILE *file = fopen(path, "r");
+  if(file == NULL) return;
+
+  char line[1024];
+  while(fgets(line, sizeof(line), file) != NULL) {
+    line[strcspn(line, "\n")] = 0;
+
+    char *fields[10];
+    size_t count = 0;
+    char *p = line;
+    while(p != NULL && count < 10) {
+      fields[count] = strsep(&p, "\t");
+      count++;
+    }
+
+    if(count < 10) {
+      wlr_log(WLR_ERROR, "invalid line in the layout snapshot, skipping");
+      continue;
+    }
+
+    struct mwc_snapshot_entry *e = calloc(1, sizeof(*e));
+    *e = (struct mwc_snapshot_entry){
+      .workspace = atoi(fields[0]),
+      .floating = fields[1][0] == 'f',
+      .position = atoi(fields[2]),
+      .box = {
+        .x = atoi(fields[3]),
+        .y = atoi(fields[4]),
+        .width = atoi(fields[5]),
+        .height = atoi(fields[6]),
+      },
+      .fullscreen = atoi(fields[7]),
+      .app_id = strdup(fields[8]),
+      .title = strdup(fields[9]),
+    };
+
+    wl_list_insert(server.snapshot_entries.prev, &e->link);
+  }
+
+  fclose(file);
+
+  if(wl_list_empty(&server.snapshot_entries)) return;
+
+  wlr_log(WLR_INFO, "loaded %d toplevels from the layout snapshot %s",
+          wl_list_length(&server.snapshot_entries), path);
+
+  /* apps launched long after startup should not land in some stale slot */
+  server.snapshot_expire = wl_event_loop_add_timer(server.wl_event_loop,
+                                                   snapshot_handle_expire, NULL);
+  wl_event_source_timer_update(server.snapshot_expire, SNAPSHOT_RESTORE_TIMEOUT_MS);
+}
+
+void
+snapshot_clear(void) {
+  struct mwc_snapshot_entry *e, *tmp;
+  wl_list_for_each_safe(e, tmp, &server.snapshot_entries, link) {
+    wl_list_remove(&e->link);
+    free(e->app_id);
+    free(e->title);
+    free(e);
+  }
+
+  if(server.snapshot_expire != NULL) {
+    wl_event_source_remove(server.snapshot_expire);
+    server.snapshot_expire = NULL;
+  }
+}
+
+bool
+snapshot_restore_toplevel(struct mwc_toplevel *toplevel) {
+  if(wl_list_empty(&server.snapshot_entries)) return false;
+
+  char *app_id = toplevel->xdg_toplevel->app_id != NULL
+    ? toplevel->xdg_toplevel->app_id
+    : "";
+  char *title = toplevel->xdg_toplevel->title != NULL
+    ? toplevel->xdg_toplevel->title
+    : "";
+
+  /* we prefer an exact match, but titles tend to change between runs,
+   * so we settle for the first one with the same app_id */
+  struct mwc_snapshot_entry *match = NULL;
+  struct mwc_snapshot_entry *e;
+  wl_list_for_each(e, &server.snapshot_entries, link) {
+    if(strcmp(e->app_id, app_id) != 0) continue;
+
+    if(strcmp(e->title, title) == 0) {
+      match = e;
+      break;
+    }
+
+    if(match == NULL) {
+      match = e;
+    }
+  }
+
+  if(match == NULL) return false;
+
+  struct mwc_workspace *workspace = workspace_find_by_index(match->workspace);
+  if(workspace == NULL) {
+    workspace = toplevel->workspace;
+  }
+
+  toplevel->workspace = workspace;
+  toplevel->floating = match->floating;
+  toplevel->restore.valid = true;
+  toplevel->restore.pending = true;
+  toplevel->restore.position = match->position;
+  toplevel->restore.box = match->box;
+  toplevel->restore.fullscreen = match->fullscreen;
+
+  wl_list_remove(&match->link);
+  free(match->app_id);
+  free(match->title);
+  free(match);
+
+  if(wl_list_empty(&server.snapshot_entries)) {
+    snapshot_clear();
+  }
+
+  return true;
+}
+
+void
+snapshot_insert_tiled_toplevel(struct mwc_toplevel *toplevel) {
+  struct mwc_workspace *workspace = toplevel->workspace;
+
+  /* we insert it before the first toplevel that was saved after it; toplevels
+   * that were not restored are treated as if they came last */
+  struct wl_list *before = NULL;
+  struct mwc_toplevel *t;
+  wl_list_for_each(t, &workspace->masters, link) {
+    if(!t->restore.valid || t->restore.position > toplevel->restore.position) {
+      before = &t->link;
+      break;
+    }
+  }
+  if(before == NULL) {
+    wl_list_for_each(t, &workspace->slaves, link) {
+      if(!t->restore.valid || t->restore.position > toplevel->restore.position) {
+        before = &t->link;
+        break;
+      }
+    }
+  }
+
+  if(before != NULL) {
+    wl_list_insert(before->prev, &toplevel->link);
+  } else if(wl_list_length(&workspace->masters) < layout_master_count(workspace)) {
+    wl_list_insert(workspace->masters.prev, &toplevel->link);
+  } else {
+    wl_list_insert(workspace->slaves.prev, &toplevel->link);
+  }
+
+  /* masters could have overflown, or this could have been inserted into slaves
+   * while there is room among masters */
+  layout_reorganize(workspace);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <wayland-server-core.h>
+#include <wlr/util/box.h>
+
+/* for how long after startup we try to match new toplevels against the snapshot */
+#define SNAPSHOT_RESTORE_TIMEOUT_MS 60000
+
+struct mwc_toplevel;
+
+struct mwc_snapshot_entry {
+  char *app_id;
+  char *title;
+  uint32_t workspace;
+  bool floating;
+  bool fullscreen;
+  /* position among the tiled toplevels of the workspace, masters first */
+  uint32_t position;
+  struct wlr_box box;
+  struct wl_list link;
+};
+
+bool
+snapshot_get_path(char *dest, size_t size);
+
+void
+snapshot_save(void);
+
+void
+snapshot_load(void);
+
+void
+snapshot_clear(void);
+
+/* if there is a saved entry for this toplevel it applies its workspace and
+ * floating state to it and remembers the rest for when it maps */
+bool
+snapshot_restore_toplevel(struct mwc_toplevel *toplevel);
+
+void
+snapshot_insert_tiled_toplevel(struct mwc_toplevel *toplevel);
@@ -13,35 +13,40 @@
 
 extern struct mwc_server server;
 
-struct mwc_something *
-root_parent_of_surface(struct wlr_surface *wlr_surface) {
-  struct wlr_surface *root_wlr_surface =
-    wlr_surface_get_root_surface(wlr_surface);
-
-  struct wlr_scene_tree *tree;
+struct wlr_scene_tree *
+scene_tree_of_root_surface(struct wlr_surface *root_wlr_surface) {
   struct wlr_xdg_surface *xdg_surface =
     wlr_xdg_surface_try_from_wlr_surface(root_wlr_surface);
 
   if(xdg_surface != NULL) {
-    tree = xdg_surface->data;
-  } else {
-    struct wlr_layer_surface_v1 *wlr_layer_surface =
-      wlr_layer_surface_v1_try_from_wlr_surface(root_wlr_surface);
-    if(wlr_layer_surface != NULL) {
-      struct mwc_layer_surface *layer_surface = wlr_layer_surface->data;
-      tree = layer_surface->scene->tree;
-    } else {
-      struct wlr_session_lock_surface_v1 *wlr_lock_surface =
-        wlr_session_lock_surface_v1_try_from_wlr_surface(root_wlr_surface);
-      if(wlr_lock_surface != NULL) {
-        struct mwc_lock_surface *lock_surface = wlr_lock_surface->data;
-        tree = lock_surface->scene_tree;
-      } else {
-        return NULL;
-      }
-    }
+    return xdg_surface->data;
+  }
+
+  struct wlr_layer_surface_v1 *wlr_layer_surface =
+    wlr_layer_surface_v1_try_from_wlr_surface(root_wlr_surface);
+  if(wlr_layer_surface != NULL) {
+    struct mwc_layer_surface *layer_surface = wlr_layer_surface->data;
+    return layer_surface->scene->tree;
+  }
+
+  struct wlr_session_lock_surface_v1 *wlr_lock_surface =
+    wlr_session_lock_surface_v1_try_from_wlr_surface(root_wlr_surface);
+  if(wlr_lock_surface != NULL) {
+    struct mwc_lock_surface *lock_surface = wlr_lock_surface->data;
+    return lock_surface->scene_tree;
   }
 
+  return NULL;
+}
+
+struct mwc_something *
+root_parent_of_surface(struct wlr_surface *wlr_surface) {
+  struct wlr_surface *root_wlr_surface =
+    wlr_surface_get_root_surface(wlr_surface);
+
+  struct wlr_scene_tree *tree = scene_tree_of_root_surface(root_wlr_surface);
+  if(tree == NULL) return NULL;
+
   struct mwc_something *something = tree->node.data;
   while(something == NULL || something->type == MWC_POPUP) {
     tree = tree->node.parent;
@@ -51,6 +56,20 @@ root_parent_of_surface(struct wlr_surface *wlr_surface) {
   return something;
 }
 
+bool
+surface_is_visible(struct wlr_surface *wlr_surface) {
+  struct wlr_surface *root_wlr_surface =
+    wlr_surface_get_root_surface(wlr_surface);
+  if(!wlr_surface->mapped || !root_wlr_surface->mapped) return false;
+
+  struct wlr_scene_tree *tree = scene_tree_of_root_surface(root_wlr_surface);
+  if(tree == NULL) return false;
+
+  /* false if it or any of its parents is disabled, like on a workspace that is not shown */
+  int x, y;
+  return wlr_scene_node_coords(&tree->node, &x, &y);
+}
+
 struct mwc_something *
 something_at(double lx, double ly, struct wlr_surface **surface,
              double *sx, double *sy) {
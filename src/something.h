@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stdbool.h>
 #include <wlr/types/wlr_compositor.h>
 
 enum mwc_type {
@@ -12,6 +13,7 @@ enum mwc_type {
 struct mwc_toplevel;
 struct mwc_layer_surface;
 struct mwc_lock_surface;
+struct wlr_scene_tree;
 
 struct mwc_something {
   enum mwc_type type;
@@ -23,9 +25,17 @@ struct mwc_something {
   };
 };
 
+/* the scene tree of a toplevel, layer or lock surface, NULL for anything else */
+struct wlr_scene_tree *
+scene_tree_of_root_surface(struct wlr_surface *root_wlr_surface);
+
 struct mwc_something *
 root_parent_of_surface(struct wlr_surface *wlr_surface);
 
+/* mapped and not hidden with its workspace, or culled. it can still be covered */
+bool
+surface_is_visible(struct wlr_surface *wlr_surface);
+
 struct mwc_something *
 something_at(double lx, double ly,
              struct wlr_surface **surface,
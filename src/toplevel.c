@@ -10,8 +10,11 @@
 #include "something.h"
 #include "workspace.h"
 #include "output.h"
+#include "pointer_constraint.h"
 #include "helpers.h"
 #include "layer_surface.h"
+#include "snapshot.h"
+#include "replay.h"
 
 #include <assert.h>
 #include <limits.h>
@@ -35,6 +38,7 @@ server_handle_new_toplevel(struct wl_listener *listener, void *data) {
   /* allocate an mwc_toplevel for this surface */
   struct mwc_toplevel *toplevel = calloc(1, sizeof(*toplevel));
   toplevel->xdg_toplevel = xdg_toplevel;
+  toplevel->id = ++server.next_toplevel_id;
 
   toplevel->something.type = MWC_TOPLEVEL;
   toplevel->something.toplevel = toplevel;
@@ -88,21 +92,39 @@ void
 toplevel_handle_initial_commit(struct mwc_toplevel *toplevel) {
   /* when an xdg_surface performs an initial commit, the compositor must
    * reply with a configure so the client can map the surface. */
-  toplevel->floating = toplevel_should_float(toplevel);
+  struct mwc_output *prev_output = toplevel->workspace->output;
+  if(snapshot_restore_toplevel(toplevel)) {
+    /* it could have been sent to some other output */
+    struct mwc_output *output = toplevel->workspace->output;
+    if(output != prev_output) {
+      wlr_fractional_scale_v1_notify_scale(toplevel->xdg_toplevel->base->surface,
+                                           output->wlr_output->scale);
+      wlr_surface_set_preferred_buffer_scale(toplevel->xdg_toplevel->base->surface,
+                                             ceil(output->wlr_output->scale));
+    }
+  } else {
+    toplevel->floating = toplevel_should_float(toplevel);
+  }
 
   uint32_t width, height;
-  if(toplevel->floating) {
+  if(toplevel->restore.pending && !wlr_box_empty(&toplevel->restore.box)) {
+    /* configure it straight into its saved size, so it does not resize after mapping */
+    width = toplevel->restore.box.width;
+    height = toplevel->restore.box.height;
+  } else if(toplevel->floating) {
     /* we lookup window rules and send a configure */
     toplevel_floating_size(toplevel, &width, &height);
   } else {
-    struct mwc_output *output = toplevel->workspace->output;
-
-    uint32_t master_count = wl_list_length(&toplevel->workspace->masters);
-    uint32_t slave_count = wl_list_length(&toplevel->workspace->slaves);
-    if(master_count < server.config->master_count) {
-      calculate_masters_dimensions(output, master_count + 1, slave_count, &width, &height);
+    struct mwc_workspace *workspace = toplevel->workspace;
+
+    uint32_t master_count = wl_list_length(&workspace->masters);
+    uint32_t slave_count = wl_list_length(&workspace->slaves);
+    if(workspace->layout == MWC_LAYOUT_SCROLLING) {
+      calculate_column_dimensions(workspace, &width, &height);
+    } else if(master_count < layout_master_count(workspace)) {
+      calculate_masters_dimensions(workspace, master_count + 1, slave_count, &width, &height);
     } else {
-      calculate_slaves_dimensions(output, slave_count + 1, &width, &height);
+      calculate_slaves_dimensions(workspace, slave_count + 1, &width, &height);
     }
   }
 
@@ -125,6 +147,11 @@ toplevel_handle_commit(struct wl_listener *listener, void *data) {
     return;
   }
 
+  /* the content type could have changed to or from video */
+  if(toplevel->fullscreen) {
+    idle_update_inhibited();
+  }
+
   if(toplevel->resizing) {
     toplevel_commit(toplevel);
     return;
@@ -154,13 +181,16 @@ void
 toplevel_handle_map(struct wl_listener *listener, void *data) {
   /* called when the surface is mapped, or ready to display on-screen. */
   struct mwc_toplevel *toplevel = wl_container_of(listener, toplevel, map);
+  record_toplevel(MWC_RECORD_TOPLEVEL_MAP, toplevel);
 
   if(toplevel->floating) {
     wl_list_insert(&toplevel->workspace->floating_toplevels, &toplevel->link);
     toplevel->scene_tree = wlr_scene_xdg_surface_create(server.floating_tree,
                                                         toplevel->xdg_toplevel->base);
   } else {
-    if(wl_list_length(&toplevel->workspace->masters) < server.config->master_count) {
+    if(toplevel->restore.pending) {
+      snapshot_insert_tiled_toplevel(toplevel);
+    } else if(wl_list_length(&toplevel->workspace->masters) < layout_master_count(toplevel->workspace)) {
       wl_list_insert(toplevel->workspace->masters.prev, &toplevel->link);
     } else {
       wl_list_insert(toplevel->workspace->slaves.prev, &toplevel->link);
@@ -183,6 +213,12 @@ toplevel_handle_map(struct wl_listener *listener, void *data) {
     wlr_scene_node_set_enabled(&toplevel->scene_tree->node, false);
   }
 
+  /* a restored toplevel can land on a workspace that is not currently shown */
+  bool visible = toplevel->workspace == toplevel->workspace->output->active_workspace;
+  if(!visible) {
+    wlr_scene_node_set_enabled(&toplevel->scene_tree->node, false);
+  }
+
   /* we are keeping toplevels scene_tree in this free user data field, it is used in 
    * assigning parents to popups */
   toplevel->xdg_toplevel->base->data = toplevel->scene_tree;
@@ -192,9 +228,14 @@ toplevel_handle_map(struct wl_listener *listener, void *data) {
    * 'things' we can have on the screen */
   toplevel->scene_tree->node.data = &toplevel->something;
 
-  focus_toplevel(toplevel);
+  if(visible) {
+    focus_toplevel(toplevel);
+    layout_scroll_to_toplevel(toplevel);
+  }
 
-  if(toplevel->floating) {
+  if(toplevel->floating && toplevel->restore.pending && !wlr_box_empty(&toplevel->restore.box)) {
+    toplevel->pending = toplevel->restore.box;
+  } else if(toplevel->floating) {
     if(toplevel->pending.width == 0) {
       struct wlr_box geometry = toplevel_get_geometry(toplevel);
       toplevel->pending.width = geometry.width;
@@ -220,14 +261,40 @@ toplevel_handle_map(struct wl_listener *listener, void *data) {
   }
 
   toplevel_commit(toplevel);
+
+  generation_toplevel_changed(toplevel);
+  generation_workspace_changed(toplevel->workspace);
+  toplevel->ipc_mapped = true;
+  ipc_broadcast_toplevel(IPC_TOPLEVEL_MAP, toplevel);
+
+  /* fullscreen would hide layer surfaces of the shown workspace, so hidden ones stay tiled */
+  if(toplevel->restore.pending && toplevel->restore.fullscreen && visible) {
+    toplevel_set_fullscreen(toplevel);
+  }
+
+  /* it is applied once, mapping it again later places it like any other toplevel */
+  toplevel->restore.pending = false;
+
+  /* inhibitors on it count from now on */
+  idle_update_inhibited();
 }
 
 void
 toplevel_handle_unmap(struct wl_listener *listener, void *data) {
   /* called when the surface is unmapped, and should no longer be shown. */
   struct mwc_toplevel *toplevel = wl_container_of(listener, toplevel, unmap);
+  record_toplevel(MWC_RECORD_TOPLEVEL_UNMAP, toplevel);
+
+  /* inhibitors on it do not count anymore */
+  idle_update_inhibited();
+
+  generation_toplevel_removed(toplevel);
+  generation_workspace_changed(toplevel->workspace);
+  toplevel->ipc_mapped = false;
+  ipc_broadcast_toplevel(IPC_TOPLEVEL_UNMAP, toplevel);
 
   struct mwc_workspace *workspace = toplevel->workspace;
+  server.scene_generation++;
 
   /* reset the cursor mode if the grabbed toplevel was unmapped. */
   /* if its the one focus should be returned to, remove it */
@@ -255,15 +322,16 @@ toplevel_handle_unmap(struct wl_listener *listener, void *data) {
 
   if(toplevel == workspace->fullscreen_toplevel) {
     workspace->fullscreen_toplevel = NULL;
+    idle_update_inhibited();
     layers_under_fullscreen_set_enabled(workspace->output, true);
     struct mwc_toplevel *t;
     wl_list_for_each(t, &workspace->masters, link) {
       if(t == toplevel) continue;
-      wlr_scene_node_set_enabled(&t->scene_tree->node, true);
+      wlr_scene_node_set_enabled(&t->scene_tree->node, !t->suspended);
     }
     wl_list_for_each(t, &workspace->slaves, link) {
       if(t == toplevel) continue;
-      wlr_scene_node_set_enabled(&t->scene_tree->node, true);
+      wlr_scene_node_set_enabled(&t->scene_tree->node, !t->suspended);
     }
     wl_list_for_each(t, &workspace->floating_toplevels, link) {
       if(t == toplevel) continue;
@@ -394,6 +462,8 @@ toplevel_start_move(struct mwc_toplevel *toplevel) {
     .height = toplevel->current.height,
   };
 
+  toplevel_set_suspended(toplevel, false);
+
   if(toplevel->floating) {
     wl_list_remove(&toplevel->link);
   } else {
@@ -509,6 +579,9 @@ toplevel_handle_set_app_id(struct wl_listener *listener, void *data) {
   wlr_foreign_toplevel_handle_v1_set_app_id(toplevel->foreign_toplevel_handle,
                                             toplevel->xdg_toplevel->app_id);
 
+  generation_toplevel_changed(toplevel);
+  ipc_broadcast_toplevel(IPC_TOPLEVEL_APP_ID, toplevel);
+
   if(toplevel == server.focused_toplevel) {
     ipc_broadcast_message(IPC_ACTIVE_TOPLEVEL);
   }
@@ -523,6 +596,9 @@ toplevel_handle_set_title(struct wl_listener *listener, void *data) {
   wlr_foreign_toplevel_handle_v1_set_title(toplevel->foreign_toplevel_handle,
                                            toplevel->xdg_toplevel->title);
 
+  generation_toplevel_changed(toplevel);
+  ipc_broadcast_toplevel(IPC_TOPLEVEL_TITLE, toplevel);
+
   if(toplevel == server.focused_toplevel) {
     ipc_broadcast_message(IPC_ACTIVE_TOPLEVEL);
   }
@@ -628,10 +704,12 @@ cursor_jump_focused_toplevel(void) {
   struct mwc_toplevel *toplevel = server.focused_toplevel;
   if(toplevel == NULL) return;
 
+  /* we use the current state instead of the scene node, as the node could still be
+   * animating towards it (e.g. when the scrolling layout scrolls to this toplevel) */
   struct wlr_box geo_box = toplevel_get_geometry(toplevel);
   wlr_cursor_warp(server.cursor, NULL,
-                  toplevel->scene_tree->node.x + geo_box.x + toplevel->current.width / 2.0,
-                  toplevel->scene_tree->node.y + geo_box.y + toplevel->current.height / 2.0);
+                  toplevel->current.x + geo_box.x + toplevel->current.width / 2.0,
+                  toplevel->current.y + geo_box.y + toplevel->current.height / 2.0);
 }
 
 void
@@ -656,19 +734,50 @@ toplevel_set_pending_state(struct mwc_toplevel *toplevel, uint32_t x, uint32_t y
 
   if(toplevel->current.width == toplevel->pending.width
      && toplevel->current.height == toplevel->pending.height) {
+    toplevel->configure_scheduled = false;
     toplevel_commit(toplevel);
     return;
   };
 
+  if(toplevel->resizing) {
+    /* pointer motion can come way faster than clients can redraw, so we only
+     * send the newest size, once per output frame */
+    toplevel->configure_scheduled = true;
+    wlr_output_schedule_frame(toplevel->workspace->output->wlr_output);
+    return;
+  }
+
   toplevel->configure_serial = wlr_xdg_toplevel_set_size(toplevel->xdg_toplevel,
                                                          width, height);
   toplevel->dirty = true;
 }
 
+void
+toplevel_send_scheduled_configure(struct mwc_toplevel *toplevel, bool force) {
+  if(!toplevel->configure_scheduled) return;
+
+  /* dirty is no help here, toplevel_commit() clears it for commits that do not ack */
+  uint32_t acked_serial = toplevel->xdg_toplevel->base->current.configure_serial;
+  if(!force && acked_serial < toplevel->configure_serial) return;
+
+  toplevel->configure_scheduled = false;
+  toplevel->configure_serial = wlr_xdg_toplevel_set_size(toplevel->xdg_toplevel,
+                                                         toplevel->pending.width,
+                                                         toplevel->pending.height);
+  toplevel->dirty = true;
+}
+
 void
 toplevel_commit(struct mwc_toplevel *toplevel) {
+  struct wlr_box previous = toplevel->current;
   toplevel->dirty = false;
   toplevel->current = toplevel->pending;
+  server.scene_generation++;
+
+  if(!wlr_box_equal(&previous, &toplevel->current)) {
+    generation_toplevel_changed(toplevel);
+    ipc_broadcast_toplevel(IPC_TOPLEVEL_GEOMETRY, toplevel);
+  }
 
   if(toplevel->animation.should_animate) {
     if(toplevel->animation.running) {
@@ -686,6 +795,22 @@ toplevel_commit(struct mwc_toplevel *toplevel) {
   wlr_output_schedule_frame(toplevel->workspace->output->wlr_output);
 }
 
+void
+toplevel_set_suspended(struct mwc_toplevel *toplevel, bool suspended) {
+  if(toplevel->suspended == suspended) return;
+
+  toplevel->suspended = suspended;
+  wlr_xdg_toplevel_set_suspended(toplevel->xdg_toplevel, suspended);
+  server.scene_generation++;
+
+  /* toplevels on hidden workspaces or under a fullscreen one stay disabled */
+  struct mwc_workspace *workspace = toplevel->workspace;
+  bool shown = workspace == workspace->output->active_workspace
+    && (workspace->fullscreen_toplevel == NULL || workspace->fullscreen_toplevel == toplevel);
+
+  wlr_scene_node_set_enabled(&toplevel->scene_tree->node, !suspended && shown);
+}
+
 void
 toplevel_set_fullscreen(struct mwc_toplevel *toplevel) {
   if(!toplevel->xdg_toplevel->base->surface->mapped) return;
@@ -701,9 +826,11 @@ toplevel_set_fullscreen(struct mwc_toplevel *toplevel) {
                             output->wlr_output, &output_box);
 
   toplevel->prev_geometry = toplevel->current;
+  server.scene_generation++;
 
   workspace->fullscreen_toplevel = toplevel;
   toplevel->fullscreen = true;
+  toplevel_set_suspended(toplevel, false);
 
   wlr_xdg_toplevel_set_fullscreen(toplevel->xdg_toplevel, true);
   toplevel_set_pending_state(toplevel, output_box.x, output_box.y,
@@ -729,6 +856,10 @@ toplevel_set_fullscreen(struct mwc_toplevel *toplevel) {
   layers_under_fullscreen_set_enabled(workspace->output, false);
 
   wlr_foreign_toplevel_handle_v1_set_fullscreen(toplevel->foreign_toplevel_handle, true);
+  idle_update_inhibited();
+  generation_toplevel_changed(toplevel);
+  generation_workspace_changed(workspace);
+  ipc_broadcast_toplevel(IPC_TOPLEVEL_FULLSCREEN, toplevel);
 }
 
 void
@@ -736,9 +867,11 @@ toplevel_unset_fullscreen(struct mwc_toplevel *toplevel) {
   if(toplevel->workspace->fullscreen_toplevel != toplevel) return;
 
   struct mwc_workspace *workspace = toplevel->workspace;
+  server.scene_generation++;
 
   workspace->fullscreen_toplevel = NULL;
   toplevel->fullscreen = false;
+  idle_update_inhibited();
 
   wlr_xdg_toplevel_set_fullscreen(toplevel->xdg_toplevel, false);
 
@@ -755,11 +888,11 @@ toplevel_unset_fullscreen(struct mwc_toplevel *toplevel) {
   struct mwc_toplevel *t;
   wl_list_for_each(t, &workspace->masters, link) {
     if(t == toplevel) continue;
-    wlr_scene_node_set_enabled(&t->scene_tree->node, true);
+    wlr_scene_node_set_enabled(&t->scene_tree->node, !t->suspended);
   }
   wl_list_for_each(t, &workspace->slaves, link) {
     if(t == toplevel) continue;
-    wlr_scene_node_set_enabled(&t->scene_tree->node, true);
+    wlr_scene_node_set_enabled(&t->scene_tree->node, !t->suspended);
   }
   wl_list_for_each(t, &workspace->floating_toplevels, link) {
     if(t == toplevel) continue;
@@ -769,6 +902,9 @@ toplevel_unset_fullscreen(struct mwc_toplevel *toplevel) {
   layers_under_fullscreen_set_enabled(workspace->output, true);
   layout_set_pending_state(workspace);
   wlr_foreign_toplevel_handle_v1_set_fullscreen(toplevel->foreign_toplevel_handle, false);
+  generation_toplevel_changed(toplevel);
+  generation_workspace_changed(workspace);
+  ipc_broadcast_toplevel(IPC_TOPLEVEL_FULLSCREEN, toplevel);
 }
 
 void
@@ -850,6 +986,7 @@ unfocus_focused_toplevel(void) {
 
   ipc_broadcast_message(IPC_ACTIVE_TOPLEVEL);
   wlr_foreign_toplevel_handle_v1_set_activated(toplevel->foreign_toplevel_handle, false);
+  cursor_update_constraint();
 
   /* we schedule a frame in order for borders to be redrawn */
   wlr_output_schedule_frame(toplevel->workspace->output->wlr_output);
@@ -881,7 +1018,9 @@ focus_toplevel(struct mwc_toplevel *toplevel) {
   }
 
 	wlr_xdg_toplevel_set_activated(toplevel->xdg_toplevel, true);
+  /* it can cover what the pointer was over now */
   wlr_scene_node_raise_to_top(&toplevel->scene_tree->node);
+  server.scene_generation++;
 
   struct wlr_seat *seat = server.seat;
   struct wlr_keyboard *keyboard = wlr_seat_get_keyboard(seat);
@@ -893,6 +1032,7 @@ focus_toplevel(struct mwc_toplevel *toplevel) {
 
   ipc_broadcast_message(IPC_ACTIVE_TOPLEVEL);
   wlr_foreign_toplevel_handle_v1_set_activated(toplevel->foreign_toplevel_handle, true);
+  cursor_update_constraint();
 
   /* we schedule a frame in order for borders to be redrawn */
   wlr_output_schedule_frame(toplevel->workspace->output->wlr_output);
@@ -1027,34 +1167,18 @@ toplevel_tiled_insert_into_layout(struct mwc_toplevel *toplevel, uint32_t x, uin
   toplevel->workspace = workspace;
 
   struct mwc_toplevel *under_cursor = layout_toplevel_at(workspace, x, y);
-
   if(under_cursor == NULL) {
-    if(wl_list_length(&workspace->masters) < server.config->master_count) {
-      wl_list_insert(workspace->masters.prev, &toplevel->link);
-    } else {
-      wl_list_insert(workspace->slaves.prev, &toplevel->link);
-    }
-  } else {
-    bool on_left_side = x <= under_cursor->current.x + under_cursor->current.width / 2;
-    bool on_top_side = y <= under_cursor->current.y + under_cursor->current.height / 2;
-    bool under_cursor_is_master = toplevel_is_master(under_cursor);
-
-    /* we insert it before under_cursor if either:
-     *   - its last master and there are some slaves
-     *   - cursor is on left (top) */
-    if((under_cursor_is_master && &under_cursor->link == workspace->masters.prev
-       && wl_list_length(&workspace->slaves) > 0)
-       || (under_cursor_is_master && on_left_side)
-       || (!under_cursor_is_master && on_top_side)) {
-      wl_list_insert(under_cursor->link.prev, &toplevel->link);
-    } else {
-      wl_list_insert(&under_cursor->link, &toplevel->link);
-    }
-
-    if(wl_list_length(&workspace->masters) > server.config->master_count) {
-      struct mwc_toplevel *last = wl_container_of(workspace->masters.prev, last, link);
-      wl_list_remove(&last->link);
-      wl_list_insert(workspace->slaves.prev, &last->link);
-    }
+    layout_math_insert_tiled(&workspace->masters, &workspace->slaves, layout_master_count(workspace),
+                             &toplevel->link, NULL, NULL, x, y);
+    return;
   }
+
+  struct mwc_box box = {
+    .x = under_cursor->current.x,
+    .y = under_cursor->current.y,
+    .width = under_cursor->current.width,
+    .height = under_cursor->current.height,
+  };
+  layout_math_insert_tiled(&workspace->masters, &workspace->slaves, layout_master_count(workspace),
+                           &toplevel->link, &under_cursor->link, &box, x, y);
 }
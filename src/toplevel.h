@@ -14,6 +14,16 @@
 struct mwc_toplevel {
   struct wl_list link;
   struct wlr_xdg_toplevel *xdg_toplevel;
+  /* never reused, so ipc clients can tell toplevels apart */
+  uint64_t id;
+  /* see generation.h */
+  uint64_t generation;
+  /* the ipc map event was sent, changes are reported until it is unmapped */
+  bool ipc_mapped;
+  /* bitmask of enum ipc_event waiting to be sent, see ipc_send_pending() */
+  uint32_t ipc_pending;
+  uint64_t ipc_pending_usec;
+  struct wl_list ipc_pending_link;
   struct mwc_workspace *workspace;
 
   struct wlr_scene_tree *scene_tree;
@@ -27,10 +37,28 @@ struct mwc_toplevel {
   /* if a floating toplevel becomes fullscreen, we keep its previous state here */
   struct wlr_box prev_geometry;
 
+  /* state saved in the layout snapshot of the previous session, applied on map */
+  struct {
+    /* the toplevel was restored, position stays valid after map so toplevels restored
+     * later are still ordered around it */
+    bool valid;
+    /* box and fullscreen are not applied yet, cleared once it is mapped */
+    bool pending;
+    uint32_t position;
+    struct wlr_box box;
+    bool fullscreen;
+  } restore;
+
   bool resizing;
+  /* set when the toplevel is scrolled out of view in the scrolling layout;
+   * its scene node is disabled and the client is told it is suspended */
+  bool suspended;
 
   uint32_t configure_serial;
   bool dirty;
+  /* during interactive resize we keep at most one unacked configure per toplevel;
+   * newer sizes wait in pending and are sent on the next output frame after the ack */
+  bool configure_scheduled;
 
   double inactive_opacity;
   double active_opacity;
@@ -134,6 +162,13 @@ toplevel_set_pending_state(struct mwc_toplevel *toplevel, uint32_t x, uint32_t y
 void
 toplevel_commit(struct mwc_toplevel *toplevel);
 
+/* sends the size waiting in pending, if the client acked the previous configure or force is set */
+void
+toplevel_send_scheduled_configure(struct mwc_toplevel *toplevel, bool force);
+
+void
+toplevel_set_suspended(struct mwc_toplevel *toplevel, bool suspended);
+
 void
 toplevel_set_fullscreen(struct mwc_toplevel *toplevel);
 
@@ -7,6 +7,7 @@
 #include "ipc.h"
 #include "keybinds.h"
 #include "layer_surface.h"
+#include "pointer_constraint.h"
 #include "something.h"
 
 #include <assert.h>
@@ -25,6 +26,9 @@ workspace_create_for_output(struct mwc_output *output, struct workspace_config *
   workspace->output = output;
   workspace->index = config->index;
   workspace->config = config;
+  workspace->layout = config->layout;
+  workspace->master_count = server.config->master_count;
+  workspace->master_ratio = server.config->master_ratio;
 
   wl_list_insert(&output->workspaces, &workspace->link);
 
@@ -54,6 +58,14 @@ change_workspace(struct mwc_workspace *workspace, bool keep_focus) {
   /* if it is the same as global active workspace, do nothing */
   if(server.active_workspace == workspace) return;
 
+  /* a swipe in progress is cancelled, the workspaces go back where they were */
+  if(server.swipe.output != NULL) {
+    server.swipe.target = 0;
+    swipe_finish();
+  }
+
+  server.scene_generation++;
+
   /* if it is an already active on its output, just switch to it */
   if(workspace == workspace->output->active_workspace) {
     if(keep_focus) {
@@ -73,6 +85,7 @@ change_workspace(struct mwc_workspace *workspace, bool keep_focus) {
     server.active_workspace = workspace;
     cursor_jump_output(workspace->output);
     ipc_broadcast_message(IPC_ACTIVE_WORKSPACE);
+    cursor_update_constraint();
     return;
   }
 
@@ -96,11 +109,12 @@ change_workspace(struct mwc_workspace *workspace, bool keep_focus) {
     wl_list_for_each(t, &workspace->floating_toplevels, link) {
       wlr_scene_node_set_enabled(&t->scene_tree->node, true);
     }
+    /* culled columns of the scrolling layout stay hidden */
     wl_list_for_each(t, &workspace->masters, link) {
-      wlr_scene_node_set_enabled(&t->scene_tree->node, true);
+      wlr_scene_node_set_enabled(&t->scene_tree->node, !t->suspended);
     }
     wl_list_for_each(t, &workspace->slaves, link) {
-      wlr_scene_node_set_enabled(&t->scene_tree->node, true);
+      wlr_scene_node_set_enabled(&t->scene_tree->node, !t->suspended);
     }
 
     if(workspace->output->active_workspace->fullscreen_toplevel != NULL) {
@@ -112,8 +126,12 @@ change_workspace(struct mwc_workspace *workspace, bool keep_focus) {
     cursor_jump_output(workspace->output);
   }
 
+  generation_workspace_changed(workspace->output->active_workspace);
+  generation_workspace_changed(workspace);
+  generation_output_changed(workspace->output);
   server.active_workspace = workspace;
   workspace->output->active_workspace = workspace;
+  idle_update_inhibited();
   ipc_broadcast_message(IPC_ACTIVE_WORKSPACE);
 
   /* same as above */
@@ -132,6 +150,9 @@ change_workspace(struct mwc_workspace *workspace, bool keep_focus) {
   } else {
     unfocus_focused_toplevel();
   }
+
+  /* with keep_focus the focused toplevel may be hidden now */
+  cursor_update_constraint();
 }
 
 void
@@ -158,7 +179,7 @@ toplevel_move_to_workspace(struct mwc_toplevel *toplevel,
     }
 
     toplevel->workspace = workspace;
-    if(wl_list_length(&workspace->masters) < server.config->master_count) {
+    if(wl_list_length(&workspace->masters) < layout_master_count(workspace)) {
       wl_list_insert(workspace->masters.prev, &toplevel->link);
     } else {
       wl_list_insert(workspace->slaves.prev, &toplevel->link);
@@ -167,7 +188,7 @@ toplevel_move_to_workspace(struct mwc_toplevel *toplevel,
     wl_list_remove(&toplevel->link);
 
     toplevel->workspace = workspace;
-    if(wl_list_length(&workspace->masters) < server.config->master_count) {
+    if(wl_list_length(&workspace->masters) < layout_master_count(workspace)) {
       wl_list_insert(workspace->masters.prev, &toplevel->link);
     } else {
       wl_list_insert(workspace->slaves.prev, &toplevel->link);
@@ -178,6 +199,7 @@ toplevel_move_to_workspace(struct mwc_toplevel *toplevel,
   if(toplevel->fullscreen) {
     old_workspace->fullscreen_toplevel = NULL;
     workspace->fullscreen_toplevel = toplevel;
+    idle_update_inhibited();
 
     struct wlr_box output_box;
     wlr_output_layout_get_box(server.output_layout, workspace->output->wlr_output, &output_box);
@@ -237,10 +259,47 @@ toplevel_move_to_workspace(struct mwc_toplevel *toplevel,
     layout_set_pending_state(workspace);
   }
 
+  generation_toplevel_changed(toplevel);
+  generation_workspace_changed(old_workspace);
+  generation_workspace_changed(workspace);
+  ipc_broadcast_toplevel(IPC_TOPLEVEL_WORKSPACE, toplevel);
+
   /* change active workspace */
   change_workspace(workspace, true);
 }
 
+void
+workspace_set_toplevels_enabled(struct mwc_workspace *workspace, bool enabled) {
+  if(workspace->fullscreen_toplevel != NULL) {
+    wlr_scene_node_set_enabled(&workspace->fullscreen_toplevel->scene_tree->node, enabled);
+    return;
+  }
+
+  struct mwc_toplevel *t;
+  wl_list_for_each(t, &workspace->floating_toplevels, link) {
+    wlr_scene_node_set_enabled(&t->scene_tree->node, enabled);
+  }
+  wl_list_for_each(t, &workspace->masters, link) {
+    wlr_scene_node_set_enabled(&t->scene_tree->node, enabled && !t->suspended);
+  }
+  wl_list_for_each(t, &workspace->slaves, link) {
+    wlr_scene_node_set_enabled(&t->scene_tree->node, enabled && !t->suspended);
+  }
+}
+
+struct mwc_workspace *
+workspace_find_by_index(uint32_t index) {
+  struct mwc_output *o;
+  wl_list_for_each(o, &server.outputs, link) {
+    struct mwc_workspace *w;
+    wl_list_for_each(w, &o->workspaces, link) {
+      if(w->index == index) return w;
+    }
+  }
+
+  return NULL;
+}
+
 struct mwc_toplevel *
 workspace_find_closest_floating_toplevel(struct mwc_workspace *workspace,
                                          enum mwc_direction side) {
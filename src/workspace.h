@@ -16,6 +16,17 @@ struct mwc_workspace {
   struct mwc_output *output;
   uint32_t index;
   struct workspace_config *config;
+  /* see generation.h */
+  uint64_t generation;
+
+  enum mwc_layout_type layout;
+  /* start from the config, but can be changed at runtime for each workspace */
+  uint32_t master_count;
+  double master_ratio;
+  /* how far the scrolling layout strip is scrolled to the right */
+  int32_t scroll_offset;
+  /* horizontal offset of all the toplevels, used while swiping between workspaces */
+  int32_t offset_x;
 
   struct wl_list masters;
   struct wl_list slaves;
@@ -29,9 +40,16 @@ workspace_create_for_output(struct mwc_output *output, struct workspace_config *
 void
 change_workspace(struct mwc_workspace *workspace, bool keep_focus);
 
+/* shows or hides toplevels of a workspace without making it active */
+void
+workspace_set_toplevels_enabled(struct mwc_workspace *workspace, bool enabled);
+
 void
 toplevel_move_to_workspace(struct mwc_toplevel *toplevel, struct mwc_workspace *workspace);
 
+struct mwc_workspace *
+workspace_find_by_index(uint32_t index);
+
 struct mwc_toplevel *
 workspace_find_closest_floating_toplevel(struct mwc_workspace *workspace,
                                       enum mwc_direction side);
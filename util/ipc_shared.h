@@ -1,2 +1,167 @@
-#define SEPARATOR "\x1E"
+#pragma once
+
+#include <stdint.h>
+
 #define IPC_PATH "/tmp/mwc/ipc"
+/* if set, the socket is here instead, like for a compositor that is replaying */
+#define IPC_SOCKET_ENV "MWC_IPC_SOCKET"
+
+/* bumped on every incompatible change to the messages below. the layout of
+ * struct ipc_header itself never changes, so a mismatch can be reported */
+#define IPC_PROTOCOL_VERSION 1
+
+/* every message, in both directions, is a header followed by length bytes of
+ * payload. everything is in the byte order of the machine, since the socket is local.
+ *
+ * requests carry the command as text, like `master-count +1`. replies and events
+ * are encoded as asked for in the request (for events, the subscribe request):
+ *   reply: {"id": <id>, "result": <result>}
+ *   error: {"id": <id>, "error": {"code": <enum ipc_error>, "name": <string>, "message": <string>}}
+ *   event: {"time_usec": <when the change happened, CLOCK_MONOTONIC>, "event": <name>, ...}
+ *     for events that replace others, the time of the oldest change they cover
+ * replies and errors have the id of their request, events the id of the subscribe request */
+struct ipc_header {
+  uint32_t length;
+  uint32_t id;
+  uint8_t version;
+  uint8_t type;
+  uint8_t encoding;
+  /* enum ipc_message_flags */
+  uint8_t flags;
+};
+
+enum ipc_message_flags {
+  /* a file descriptor was sent (SCM_RIGHTS) with the first byte of this message. a
+   * single read can get bytes of earlier messages too, so this tells which one it is */
+  IPC_MESSAGE_HAS_FD = 1 << 0,
+  /* the event repeats the current state instead of reporting a change, like a
+   * toplevel-map for a toplevel that was mapped all along. these are sent right after
+   * subscribing, and in place of events that were coalesced away */
+  IPC_MESSAGE_STATE = 1 << 1,
+  /* the event is about something going away, or just something happening, so it is
+   * never coalesced away: the current state would not tell about it */
+  IPC_MESSAGE_NO_STATE = 1 << 2,
+};
+
+enum ipc_message_type {
+  IPC_MESSAGE_REQUEST,
+  IPC_MESSAGE_REPLY,
+  IPC_MESSAGE_ERROR,
+  IPC_MESSAGE_EVENT,
+};
+
+enum ipc_encoding {
+  IPC_ENCODING_JSON,
+  /* the same values as json, each being a enum ipc_binary_tag followed by its data */
+  IPC_ENCODING_BINARY,
+  IPC_ENCODING_COUNT,
+};
+
+enum ipc_binary_tag {
+  IPC_BINARY_NULL,
+  IPC_BINARY_FALSE,
+  IPC_BINARY_TRUE,
+  /* followed by an int64_t */
+  IPC_BINARY_INT,
+  /* followed by a double */
+  IPC_BINARY_DOUBLE,
+  /* followed by an uint32_t length and that many bytes, without a null */
+  IPC_BINARY_STRING,
+  /* followed by values until IPC_BINARY_END */
+  IPC_BINARY_ARRAY,
+  /* followed by string keys and values until IPC_BINARY_END */
+  IPC_BINARY_OBJECT,
+  IPC_BINARY_END,
+};
+
+enum ipc_error {
+  IPC_ERROR_INVALID_REQUEST = 1,
+  IPC_ERROR_INVALID_ARGUMENT,
+  IPC_ERROR_UNSUPPORTED_VERSION,
+  IPC_ERROR_UNSUPPORTED_ENCODING,
+  IPC_ERROR_TOO_LONG,
+  IPC_ERROR_INTERNAL,
+};
+
+/* payloads of requests longer than this are refused and the client is disconnected */
+#define IPC_MAX_REQUEST_LENGTH 4096
+
+/* the `shm` request is answered with a file descriptor attached (SCM_RIGHTS) to
+ * the first byte of the reply, see IPC_MESSAGE_HAS_FD. it is read only, and mmap-ed it is a struct
+ * ipc_shm_state that the compositor keeps up to date, so reading the state
+ * needs no requests or syscalls at all.
+ *
+ * it is a seqlock: sequence is odd while the compositor writes, and readers copy
+ * what they need and retry if the sequence was odd or changed in the meantime:
+ *   do {
+ *     seq = __atomic_load_n(&state->sequence, __ATOMIC_ACQUIRE);
+ *     copy what is needed
+ *     __atomic_thread_fence(__ATOMIC_ACQUIRE);
+ *   } while((seq & 1) || seq != __atomic_load_n(&state->sequence, __ATOMIC_RELAXED)); */
+#define IPC_SHM_VERSION 1
+#define IPC_SHM_MAX_OUTPUTS 16
+#define IPC_SHM_MAX_WORKSPACES 64
+#define IPC_SHM_MAX_TOPLEVELS 256
+#define IPC_SHM_NAME_LENGTH 32
+#define IPC_SHM_APP_ID_LENGTH 64
+#define IPC_SHM_TITLE_LENGTH 128
+
+enum ipc_shm_toplevel_flags {
+  IPC_SHM_FLOATING = 1 << 0,
+  IPC_SHM_FULLSCREEN = 1 << 1,
+  IPC_SHM_FOCUSED = 1 << 2,
+};
+
+struct ipc_shm_output {
+  char name[IPC_SHM_NAME_LENGTH];
+  int32_t x, y;
+  int32_t width, height;
+  double scale;
+  uint32_t active_workspace;
+  uint64_t generation;
+};
+
+struct ipc_shm_workspace {
+  uint32_t index;
+  /* index into outputs */
+  uint32_t output;
+  /* 0 for master, 1 for scrolling */
+  uint32_t layout;
+  uint32_t master_count;
+  double master_ratio;
+  /* 0 if there is none */
+  uint64_t fullscreen_toplevel;
+  uint64_t generation;
+};
+
+struct ipc_shm_toplevel {
+  uint64_t id;
+  uint64_t generation;
+  /* cut to fit, always null terminated */
+  char app_id[IPC_SHM_APP_ID_LENGTH];
+  char title[IPC_SHM_TITLE_LENGTH];
+  uint32_t workspace;
+  uint32_t flags;
+  int32_t x, y;
+  int32_t width, height;
+};
+
+struct ipc_shm_state {
+  uint32_t version;
+  uint32_t sequence;
+  /* see changed-since */
+  uint64_t generation;
+
+  uint32_t active_workspace;
+  /* 0 if nothing is focused */
+  uint64_t focused_toplevel;
+
+  /* set if there was more than fits */
+  uint32_t truncated;
+  uint32_t output_count;
+  uint32_t workspace_count;
+  uint32_t toplevel_count;
+  struct ipc_shm_output outputs[IPC_SHM_MAX_OUTPUTS];
+  struct ipc_shm_workspace workspaces[IPC_SHM_MAX_WORKSPACES];
+  struct ipc_shm_toplevel toplevels[IPC_SHM_MAX_TOPLEVELS];
+};